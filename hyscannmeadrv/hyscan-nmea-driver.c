@@ -47,6 +47,44 @@
  * автоматического поиска подключенных датчиков на всех доступных UART портах.
  * Для UDP осуществляется приём данных на всех IP адресах и порту номер 10000.
  *
+ * Подключение к датчику, поиск UART портов и контроль приёма данных
+ * выполняются в потоке #HyScanNmeaReactor. Драйвер не опрашивает своё
+ * состояние периодически, а проверяет его только в моменты истечения
+ * таймаутов приёма данных и при изменении состояния порта.
+ *
+ * Параметры подключения "/filter/mode" и "/filter/sentences" задают список
+ * разрешённых или запрещённых типов NMEA строк, например "GSV, GSA".
+ * Отфильтрованные строки отбрасываются сразу после приёма, см.
+ * #hyscan_nmea_receiver_set_filter.
+ *
+ * Параметр подключения "/decimation/sentences" задаёт прореживание частых
+ * NMEA строк, например "HPR@10, GSV/5": строки HPR пропускаются не чаще
+ * 10 раз в секунду, а из строк GSV пропускается каждая пятая. Правила
+ * применяются по порядку, действует первое подходящее правило, см.
+ * #hyscan_nmea_receiver_set_decimation.
+ *
+ * Параметр подключения "/urgent/sentences" задаёт типы срочных NMEA строк,
+ * например "HDT, THS, PASHR". Каждая такая строка отправляется сразу после
+ * приёма отдельным блоком, не дожидаясь завершения эпохи и отправки
+ * накопленных блоков, см. #hyscan_nmea_receiver_set_urgent. Срочный блок
+ * может опередить блоки с меньшей меткой времени, поэтому срочные строки
+ * отправляются через дополнительный датчик с названием, составленным из
+ * идентификатора датчика и суффикса %HYSCAN_NMEA_DRIVER_URGENT_SUFFIX. Метки
+ * времени данных каждого датчика при этом возрастают. Дополнительный датчик
+ * включается независимо от основного функцией #hyscan_sensor_set_enable.
+ *
+ * Если в параметрах подключения включен параметр "/delivery/fields", драйвер
+ * описывает дополнительный датчик с названием, составленным из
+ * идентификатора датчика и суффикса %HYSCAN_NMEA_DRIVER_FIELDS_SUFFIX. Для
+ * каждого блока NMEA строк через него отправляется двоичная запись
+ * #HyScanNmeaFields с типом данных %HYSCAN_DATA_BLOB и меткой времени блока.
+ * Значения в ней разобраны функцией #hyscan_nmea_fields_parse, поэтому
+ * потребителям не требуется повторно разбирать текст NMEA строк. Если блок
+ * не содержит ни одного из разбираемых значений, запись не отправляется.
+ * Записи передаются отдельно от NMEA строк, поэтому поток NMEA данных
+ * основного датчика не изменяется. Дополнительный датчик включается
+ * независимо от основного функцией #hyscan_sensor_set_enable.
+ *
  * Для создания класса предназначена функция #hyscan_nmea_driver_new.
  *
  * Описание параметров подключения можно получить с помощью функции
@@ -56,6 +94,8 @@
 #include "hyscan-nmea-driver.h"
 #include "hyscan-nmea-uart.h"
 #include "hyscan-nmea-udp.h"
+#include "hyscan-nmea-fields.h"
+#include "hyscan-nmea-parser.h"
 #include "hyscan-nmea-drv.h"
 
 #include <hyscan-param-controller.h>
@@ -73,10 +113,36 @@
 #define PARAM_UART_MODE            "/uart/mode"
 #define PARAM_UDP_ADDRESS          "/udp/address"
 #define PARAM_UDP_PORT             "/udp/port"
+#define PARAM_UDP_DATAGRAM         "/udp/datagram"
+#define PARAM_UDP_TIMEOUT          "/udp/timeout"
+#define PARAM_DELIVERY_INLINE      "/delivery/inline"
+#define PARAM_DELIVERY_PREDICT     "/delivery/predict"
+#define PARAM_DELIVERY_FIELDS      "/delivery/fields"
+#define PARAM_UNTIMED_WINDOW       "/untimed/window"
+#define PARAM_UNTIMED_COUNT        "/untimed/count"
+#define PARAM_FILTER_MODE          "/filter/mode"
+#define PARAM_FILTER_SENTENCES     "/filter/sentences"
+#define PARAM_DECIMATION_SENTENCES "/decimation/sentences"
+#define PARAM_URGENT_SENTENCES     "/urgent/sentences"
+#define PARAM_BUFFER_COUNT         "/buffer/count"
+#define PARAM_BUFFER_SIZE          "/buffer/size"
+#define PARAM_BUFFER_CAPACITY      "/buffer/capacity"
+#define PARAM_BUFFER_OVERFLOW      "/buffer/overflow"
+#define PARAM_BUFFER_TIMEOUT       "/buffer/timeout"
 
 #define DEFAULT_WARNING_TIMEOUT    5.0
 #define DEFAULT_ERROR_TIMEOUT      30.0
 #define DEFAULT_UDP_PORT           10000
+#define DEFAULT_UDP_TIMEOUT        0.0
+#define DEFAULT_BUFFER_COUNT       16
+#define DEFAULT_BUFFER_SIZE        4084
+#define DEFAULT_BUFFER_CAPACITY    32768
+#define DEFAULT_BUFFER_TIMEOUT     0.005
+
+#define RECONNECT_TIME             1000000
+#define SCAN_TIME                  25000000
+#define SCAN_CHECK_TIME            100000
+#define MAX_BATCH_SIZE             32
 
 #define NMEA_INFO_NAME(...)        hyscan_param_name_constructor (key_id, \
                                      (guint)sizeof (key_id), "info", __VA_ARGS__)
@@ -91,6 +157,14 @@ enum
   PROP_PARAMS
 };
 
+/* Режимы фильтрации NMEA строк. */
+enum
+{
+  FILTER_NONE,
+  FILTER_ALLOW,
+  FILTER_DENY
+};
+
 /* Параметры работы устройства. */
 typedef struct
 {
@@ -99,8 +173,24 @@ typedef struct
   gint64                  uart_mode;           /* Режим работы UART порта. */
   gint64                  udp_address;         /* Идентификатор IP адреса UDP порта. */
   gint64                  udp_port;            /* Номер UDP порта. */
+  gboolean                udp_datagram;        /* Отправка блока после каждой датаграммы. */
+  gdouble                 udp_timeout;         /* Таймаут отправки блока для UDP порта. */
   gdouble                 warning_timeout;     /* Таймаут приёма данных - предупреждение. */
   gdouble                 error_timeout;       /* Таймаут приёма данных - перезапуск порта. */
+  gboolean                inline_delivery;     /* Отправка данных из потока приёма. */
+  gboolean                predict_epoch;       /* Отправка блока по последней строке эпохи. */
+  gboolean                decode_fields;       /* Отправка разобранных значений полей. */
+  gdouble                 untimed_window;      /* Интервал группировки строк без времени. */
+  gint64                  untimed_count;       /* Число строк без времени в блоке. */
+  gint64                  filter_mode;         /* Режим фильтрации NMEA строк. */
+  gchar                  *filter;              /* Шаблоны типов NMEA строк. */
+  gchar                  *decimation;          /* Правила прореживания NMEA строк. */
+  gchar                  *urgent;              /* Шаблоны срочных NMEA строк. */
+  gint64                  n_buffers;           /* Число блоков в буфере сообщений. */
+  gint64                  message_size;        /* Максимальный размер блока данных. */
+  gint64                  capacity;            /* Размер буфера сообщений. */
+  gint64                  overflow;            /* Политика обработки переполнения буфера. */
+  gdouble                 overflow_timeout;    /* Время ожидания места в буфере. */
 } HyScanNmeaDriverParams;
 
 struct _HyScanNmeaDriverPrivate
@@ -110,20 +200,34 @@ struct _HyScanNmeaDriverPrivate
 
   HyScanDataSchema       *schema;              /* Схема датчика. */
   gboolean                enable;              /* Признак активности датчика. */
+  gchar                  *fields_id;           /* Название датчика разобранных значений полей. */
+  gboolean                fields_enable;       /* Признак активности датчика разобранных значений. */
+  gchar                  *urgent_id;           /* Название датчика срочных NMEA строк. */
+  gboolean                urgent_enable;       /* Признак активности датчика срочных строк. */
+
+  HyScanNmeaReactor      *reactor;             /* Поток обработки событий. */
+  GMainContext           *context;             /* Контекст потока обработки событий. */
+  GSource                *watchdog;            /* Таймер подключения и проверки приёма данных. */
 
-  gboolean                shutdown;            /* Признак завершения работы. */
-  GThread                *starter;             /* Поток подключения к NMEA датчикам. */
-  GThread                *scanner;             /* Поток поиска NMEA UART датчиков. */
+  gboolean                scan;                /* Признак автоматического поиска UART датчиков. */
+  GList                  *uarts;               /* Список UART портов при поиске датчиков. */
+  gint64                  scan_time;           /* Время завершения поиска. */
 
   GObject                *transport;           /* Класс приёма данных от датчика. */
   gboolean                io_error;            /* Признак ошибки ввода вывода. */
   HyScanBuffer           *buffer;              /* Буфер данных. */
+  HyScanBuffer           *fields_buffer;       /* Буфер разобранных значений полей. */
 
   gint                    status;              /* Статус датчика. */
   gint                    prev_status;         /* Предыдущий статус датчика. */
   gchar                  *status_name;         /* Название параметра статуса. */
 
+  guint                   n_dropped;           /* Число отброшенных блоков данных. */
+  guint                   dropped_base;        /* Число блоков, отброшенных закрытыми портами. */
+  gchar                  *dropped_name;        /* Название параметра числа отброшенных блоков. */
+
   GTimer                 *data_timer;          /* Таймер приёма данных. */
+  guint                   n_sentences;         /* Число принятых портом NMEA строк. */
 };
 
 static void      hyscan_nmea_driver_param_interface_init   (HyScanParamInterface    *iface);
@@ -141,30 +245,34 @@ static void      hyscan_nmea_driver_parse_connect_params   (HyScanParamList
                                                             HyScanNmeaDriverParams  *params);
 
 static HyScanDataSchema *
-                 hyscan_nmea_driver_create_schema          (const gchar             *dev_id);
+                 hyscan_nmea_driver_create_schema          (const gchar             *dev_id,
+                                                            const gchar             *fields_id,
+                                                            const gchar             *urgent_id);
 
 static void      hyscan_nmea_driver_disconnect             (HyScanNmeaDriverPrivate *priv);
 
-static gpointer  hyscan_nmea_driver_starter                (gpointer                 user_data);
+static gboolean  hyscan_nmea_driver_stop                   (gpointer                 user_data);
+
+static gpointer  hyscan_nmea_driver_new_receiver           (HyScanNmeaDriver        *driver,
+                                                            GType                    type);
+
+static gboolean  hyscan_nmea_driver_connect                (HyScanNmeaDriver        *driver);
 
-static gpointer  hyscan_nmea_driver_scanner                (gpointer                 user_data);
+static GList *   hyscan_nmea_driver_scan                   (HyScanNmeaDriver        *driver);
 
-static void      hyscan_nmea_driver_check_data             (HyScanNmeaDriver        *driver);
+static gboolean  hyscan_nmea_driver_watchdog               (gpointer                 user_data);
+
+static gint64    hyscan_nmea_driver_check_data             (HyScanNmeaDriver        *driver);
 
 static void      hyscan_nmea_driver_io_error               (HyScanNmeaReceiver      *receiver,
                                                             HyScanNmeaDriver        *driver);
 
-static void      hyscan_nmea_driver_tester                 (HyScanNmeaReceiver      *receiver,
-                                                            gint64                   time,
-                                                            const gchar             *data,
-                                                            guint                    size,
-                                                            HyScanNmeaDriver        *driver);
+static void      hyscan_nmea_driver_find                   (HyScanNmeaDriver        *driver);
 
-static void      hyscan_nmea_driver_emmiter                (HyScanNmeaReceiver      *receiver,
-                                                            gint64                   time,
-                                                            const gchar             *data,
-                                                            guint                    size,
-                                                            HyScanNmeaDriver        *driver);
+static void      hyscan_nmea_driver_emmiter                (HyScanNmeaReceiver            *receiver,
+                                                            const HyScanNmeaReceiverBlock *blocks,
+                                                            guint                          n_blocks,
+                                                            gpointer                       user_data);
 
 G_DEFINE_TYPE_WITH_CODE (HyScanNmeaDriver, hyscan_nmea_driver, G_TYPE_OBJECT,
                          G_ADD_PRIVATE (HyScanNmeaDriver)
@@ -201,10 +309,21 @@ hyscan_nmea_driver_init (HyScanNmeaDriver *driver)
    * UART порта и номер UDP порта в 10000. */
   params->uart_mode = HYSCAN_NMEA_UART_MODE_AUTO;
   params->udp_port = DEFAULT_UDP_PORT;
+  params->udp_timeout = DEFAULT_UDP_TIMEOUT;
 
   /* Таймауты по умолчанию. */
   params->warning_timeout = DEFAULT_WARNING_TIMEOUT;
   params->error_timeout = DEFAULT_ERROR_TIMEOUT;
+
+  /* Досрочная отправка блоков по умолчанию выключена. */
+  params->predict_epoch = FALSE;
+
+  /* Буфер сообщений по умолчанию. */
+  params->n_buffers = DEFAULT_BUFFER_COUNT;
+  params->message_size = DEFAULT_BUFFER_SIZE;
+  params->capacity = DEFAULT_BUFFER_CAPACITY;
+  params->overflow = HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST;
+  params->overflow_timeout = DEFAULT_BUFFER_TIMEOUT;
 }
 
 static void
@@ -252,27 +371,40 @@ hyscan_nmea_driver_object_constructed (GObject *object)
   /* Таймер данных. */
   priv->data_timer = g_timer_new ();
 
-  /* Буфер данных. */
+  /* Буферы данных. */
   priv->buffer = hyscan_buffer_new ();
+  priv->fields_buffer = hyscan_buffer_new ();
 
   /* Автоматический выбор UART порта и режима работы. */
   if ((g_ascii_strcasecmp (priv->uri, HYSCAN_NMEA_DRIVER_UART_URI) == 0) &&
       (priv->params.uart_port == 0))
     {
-      priv->scanner = g_thread_new ("uart-scanner", hyscan_nmea_driver_scanner, driver);
-    }
-
-  /* Конкретный UART или UDP порт. */
-  else
-    {
-      priv->starter = g_thread_new ("uart-starter", hyscan_nmea_driver_starter, driver);
+      priv->scan = TRUE;
     }
 
   /* Название параметра статуса. */
   priv->status_name = g_strdup_printf ("/state/%s/status", priv->params.dev_id);
+  priv->dropped_name = g_strdup_printf ("/state/%s/dropped", priv->params.dev_id);
+
+  /* Датчик разобранных значений полей. */
+  if (priv->params.decode_fields)
+    priv->fields_id = g_strconcat (priv->params.dev_id, HYSCAN_NMEA_DRIVER_FIELDS_SUFFIX, NULL);
+
+  /* Датчик срочных NMEA строк. */
+  if (priv->params.urgent != NULL)
+    priv->urgent_id = g_strconcat (priv->params.dev_id, HYSCAN_NMEA_DRIVER_URGENT_SUFFIX, NULL);
 
   /* Схема датчика. */
-  priv->schema = hyscan_nmea_driver_create_schema (priv->params.dev_id);
+  priv->schema = hyscan_nmea_driver_create_schema (priv->params.dev_id, priv->fields_id, priv->urgent_id);
+
+  /* Запускаем подключение к датчику. */
+  priv->reactor = hyscan_nmea_reactor_get_default ();
+  priv->context = hyscan_nmea_reactor_get_context (priv->reactor);
+
+  priv->watchdog = hyscan_nmea_reactor_timer_new ();
+  g_source_set_callback (priv->watchdog, hyscan_nmea_driver_watchdog, driver, NULL);
+  g_source_set_ready_time (priv->watchdog, 0);
+  g_source_attach (priv->watchdog, priv->context);
 }
 
 static void
@@ -284,9 +416,16 @@ hyscan_nmea_driver_object_finalize (GObject *object)
   hyscan_nmea_driver_disconnect (priv);
   g_clear_pointer (&priv->data_timer, g_timer_destroy);
   g_clear_object (&priv->buffer);
+  g_clear_object (&priv->fields_buffer);
   g_clear_object (&priv->schema);
   g_free (priv->status_name);
+  g_free (priv->dropped_name);
+  g_free (priv->fields_id);
+  g_free (priv->urgent_id);
   g_free (priv->params.dev_id);
+  g_free (priv->params.filter);
+  g_free (priv->params.decimation);
+  g_free (priv->params.urgent);
   g_free (priv->uri);
 
   G_OBJECT_CLASS (hyscan_nmea_driver_parent_class)->finalize (object);
@@ -300,36 +439,130 @@ hyscan_nmea_driver_parse_connect_params (HyScanParamList        *list,
   HyScanParamController *controller;
   HyScanDataSchema *schema;
   GString *dev_id;
+  GString *filter;
+  GString *decimation;
+  GString *urgent;
 
   if ((list == NULL) || (hyscan_param_list_params (list) == NULL))
     return;
 
   dev_id = g_string_new (NULL);
+  filter = g_string_new (NULL);
+  decimation = g_string_new (NULL);
+  urgent = g_string_new (NULL);
   controller = hyscan_param_controller_new (NULL);
 
   schema = hyscan_nmea_driver_get_connect_schema (NULL, TRUE);
   hyscan_param_controller_set_schema (controller, schema);
 
-  hyscan_param_controller_add_string (controller, PARAM_DEVICE_ID, dev_id);
-  hyscan_param_controller_add_double (controller, PARAM_TIMEOUT_WARNING, &params->warning_timeout);
-  hyscan_param_controller_add_double (controller, PARAM_TIMEOUT_ERROR, &params->error_timeout);
-  hyscan_param_controller_add_enum   (controller, PARAM_UART_PORT, &params->uart_port);
-  hyscan_param_controller_add_enum   (controller, PARAM_UART_MODE, &params->uart_mode);
-  hyscan_param_controller_add_enum   (controller, PARAM_UDP_ADDRESS, &params->udp_address);
-  hyscan_param_controller_add_enum   (controller, PARAM_UDP_PORT, &params->udp_port);
+  hyscan_param_controller_add_string  (controller, PARAM_DEVICE_ID, dev_id);
+  hyscan_param_controller_add_double  (controller, PARAM_TIMEOUT_WARNING, &params->warning_timeout);
+  hyscan_param_controller_add_double  (controller, PARAM_TIMEOUT_ERROR, &params->error_timeout);
+  hyscan_param_controller_add_enum    (controller, PARAM_UART_PORT, &params->uart_port);
+  hyscan_param_controller_add_enum    (controller, PARAM_UART_MODE, &params->uart_mode);
+  hyscan_param_controller_add_enum    (controller, PARAM_UDP_ADDRESS, &params->udp_address);
+  hyscan_param_controller_add_enum    (controller, PARAM_UDP_PORT, &params->udp_port);
+  hyscan_param_controller_add_boolean (controller, PARAM_UDP_DATAGRAM, &params->udp_datagram);
+  hyscan_param_controller_add_double  (controller, PARAM_UDP_TIMEOUT, &params->udp_timeout);
+  hyscan_param_controller_add_boolean (controller, PARAM_DELIVERY_INLINE, &params->inline_delivery);
+  hyscan_param_controller_add_boolean (controller, PARAM_DELIVERY_PREDICT, &params->predict_epoch);
+  hyscan_param_controller_add_boolean (controller, PARAM_DELIVERY_FIELDS, &params->decode_fields);
+  hyscan_param_controller_add_double  (controller, PARAM_UNTIMED_WINDOW, &params->untimed_window);
+  hyscan_param_controller_add_integer (controller, PARAM_UNTIMED_COUNT, &params->untimed_count);
+  hyscan_param_controller_add_enum    (controller, PARAM_FILTER_MODE, &params->filter_mode);
+  hyscan_param_controller_add_string  (controller, PARAM_FILTER_SENTENCES, filter);
+  hyscan_param_controller_add_string  (controller, PARAM_DECIMATION_SENTENCES, decimation);
+  hyscan_param_controller_add_string  (controller, PARAM_URGENT_SENTENCES, urgent);
+  hyscan_param_controller_add_integer (controller, PARAM_BUFFER_COUNT, &params->n_buffers);
+  hyscan_param_controller_add_integer (controller, PARAM_BUFFER_SIZE, &params->message_size);
+  hyscan_param_controller_add_integer (controller, PARAM_BUFFER_CAPACITY, &params->capacity);
+  hyscan_param_controller_add_enum    (controller, PARAM_BUFFER_OVERFLOW, &params->overflow);
+  hyscan_param_controller_add_double  (controller, PARAM_BUFFER_TIMEOUT, &params->overflow_timeout);
 
   if (!hyscan_param_set (HYSCAN_PARAM (controller), list))
     g_warning ("HyScanNmeaDriver: error in connect params");
 
   params->dev_id = g_string_free (dev_id, (dev_id->len == 0));
+  params->filter = g_string_free (filter, (filter->len == 0));
+  params->decimation = g_string_free (decimation, (decimation->len == 0));
+  params->urgent = g_string_free (urgent, (urgent->len == 0));
 
   g_object_unref (controller);
   g_object_unref (schema);
 }
 
-/* Функция создаёт схему датчика. */
+/* Функция разбивает список шаблонов или правил для NMEA строк. Элементы
+ * списка разделяются пробелами, запятыми или точками с запятой. */
+static gchar **
+hyscan_nmea_driver_split_list (const gchar *list)
+{
+  if (list == NULL)
+    return NULL;
+
+  return g_strsplit_set (list, " ,;", -1);
+}
+
+/* Функция разбирает правила прореживания NMEA строк вида "HPR@10" (не
+ * чаще 10 Гц), "GSV/5" (каждая пятая строка) или "GSV/5@1". Шаблоны
+ * правил указывают на строки массива rules. */
+static gboolean
+hyscan_nmea_driver_parse_rates (gchar                **rules,
+                                HyScanNmeaParserRate  *rates,
+                                guint                 *n_rates)
+{
+  guint i;
+
+  *n_rates = 0;
+
+  for (i = 0; (rules != NULL) && (rules[i] != NULL); i++)
+    {
+      HyScanNmeaParserRate *rate = &rates[*n_rates];
+      gchar *value;
+      gchar *end;
+
+      if (rules[i][0] == 0)
+        continue;
+
+      if (*n_rates == HYSCAN_NMEA_PARSER_MAX_RATES)
+        return FALSE;
+
+      rate->pattern = rules[i];
+      rate->every = 0;
+      rate->max_rate = 0.0;
+
+      /* Максимальная частота строк. */
+      value = strchr (rules[i], '@');
+      if (value != NULL)
+        {
+          *value++ = 0;
+          rate->max_rate = g_ascii_strtod (value, &end);
+          if ((end == value) || (*end != 0))
+            return FALSE;
+        }
+
+      /* Каждая N-я строка. */
+      value = strchr (rules[i], '/');
+      if (value != NULL)
+        {
+          *value++ = 0;
+          rate->every = g_ascii_strtoull (value, &end, 10);
+          if ((end == value) || (*end != 0))
+            return FALSE;
+        }
+
+      *n_rates += 1;
+    }
+
+  return TRUE;
+}
+
+/* Функция создаёт схему датчика. Если fields_id или urgent_id не равны
+ * NULL, в схему добавляются датчики разобранных значений полей и срочных
+ * NMEA строк. */
 static HyScanDataSchema *
-hyscan_nmea_driver_create_schema (const gchar *dev_id)
+hyscan_nmea_driver_create_schema (const gchar *dev_id,
+                                  const gchar *fields_id,
+                                  const gchar *urgent_id)
 {
   HyScanDataSchemaBuilder *builder;
   HyScanDeviceSchema *device;
@@ -343,6 +576,10 @@ hyscan_nmea_driver_create_schema (const gchar *dev_id)
 
   /* Описание датчика. */
   hyscan_sensor_schema_add_sensor (sensor, dev_id, dev_id, _("NMEA sensor"));
+  if (fields_id != NULL)
+    hyscan_sensor_schema_add_sensor (sensor, fields_id, dev_id, _("Decoded NMEA fields"));
+  if (urgent_id != NULL)
+    hyscan_sensor_schema_add_sensor (sensor, urgent_id, dev_id, _("Urgent NMEA sentences"));
 
   /* Информация о датчике. */
 
@@ -384,6 +621,11 @@ hyscan_nmea_driver_create_schema (const gchar *dev_id)
                                               HYSCAN_DEVICE_STATUS_ENUM, HYSCAN_DEVICE_STATUS_ERROR);
   hyscan_data_schema_builder_key_set_access (builder, key_id, HYSCAN_DATA_SCHEMA_ACCESS_READ);
 
+  /* Число блоков данных, отброшенных при переполнении буфера. */
+  NMEA_STATE_NAME (dev_id, "dropped", NULL);
+  hyscan_data_schema_builder_key_integer_create (builder, key_id, "Dropped", NULL, 0);
+  hyscan_data_schema_builder_key_set_access (builder, key_id, HYSCAN_DATA_SCHEMA_ACCESS_READ);
+
   schema = hyscan_data_schema_builder_get_schema (builder);
 
   g_object_unref (sensor);
@@ -396,229 +638,334 @@ hyscan_nmea_driver_create_schema (const gchar *dev_id)
 static void
 hyscan_nmea_driver_disconnect (HyScanNmeaDriverPrivate *priv)
 {
-  g_atomic_int_set (&priv->shutdown, TRUE);
-  g_clear_pointer (&priv->starter, g_thread_join);
-  g_clear_pointer (&priv->scanner, g_thread_join);
+  if (priv->watchdog == NULL)
+    return;
+
+  hyscan_nmea_reactor_invoke (priv->context, hyscan_nmea_driver_stop, priv);
+
+  /* Таймер освобождается только после удаления всех портов, так как
+   * их потоки отправки данных могут обращаться к нему. */
+  g_clear_pointer (&priv->watchdog, g_source_unref);
+  g_clear_pointer (&priv->context, g_main_context_unref);
+  g_clear_object (&priv->reactor);
+}
+
+/* Функция останавливает работу с устройством. Выполняется в потоке
+ * обработки событий. */
+static gboolean
+hyscan_nmea_driver_stop (gpointer user_data)
+{
+  HyScanNmeaDriverPrivate *priv = user_data;
+
+  g_source_destroy (priv->watchdog);
+
+  g_list_free_full (priv->uarts, g_object_unref);
+  priv->uarts = NULL;
 
   g_clear_object (&priv->transport);
+
+  return G_SOURCE_REMOVE;
 }
 
-/* Поток подключения к NMEA датчикам. */
+/* Функция создаёт объект приёма данных указанного типа с параметрами
+ * буфера сообщений из параметров подключения. */
 static gpointer
-hyscan_nmea_driver_starter (gpointer user_data)
+hyscan_nmea_driver_new_receiver (HyScanNmeaDriver *driver,
+                                 GType             type)
 {
-  HyScanNmeaDriver *driver = user_data;
-  HyScanNmeaDriverPrivate *priv = driver->priv;
-  HyScanNmeaDriverParams *params = &priv->params;
-
-  while (!g_atomic_int_get (&priv->shutdown))
+  HyScanNmeaDriverParams *params = &driver->priv->params;
+  HyScanNmeaReceiver *receiver;
+
+  receiver = g_object_new (type,
+                           "inline", params->inline_delivery,
+                           "n-buffers", (guint)params->n_buffers,
+                           "message-size", (guint)params->message_size,
+                           "buffer-size", (guint)params->capacity,
+                           NULL);
+
+  hyscan_nmea_receiver_set_overflow (receiver, params->overflow, params->overflow_timeout);
+  hyscan_nmea_receiver_set_predict_epoch (receiver, params->predict_epoch);
+  hyscan_nmea_receiver_group_untimed (receiver, params->untimed_window, params->untimed_count);
+
+  /* Фильтр NMEA строк. Шаблоны проверяются при проверке параметров
+   * подключения, некорректный фильтр не устанавливается. */
+  if (params->filter_mode != FILTER_NONE)
     {
-      /* Подключение установлено - проверяем приём данных. */
-      if (g_atomic_pointer_get (&priv->transport) != NULL)
+      gchar **patterns = hyscan_nmea_driver_split_list (params->filter);
+
+      if (!hyscan_nmea_receiver_set_filter (receiver, (const gchar * const *)patterns,
+                                            params->filter_mode == FILTER_ALLOW))
         {
-          hyscan_nmea_driver_check_data (driver);
+          g_warning ("HyScanNmeaDriver: error in sentence filter '%s'", params->filter);
         }
 
-      /* Определённый UART порт. */
-      else if (g_ascii_strcasecmp (priv->uri, HYSCAN_NMEA_DRIVER_UART_URI) == 0)
+      g_strfreev (patterns);
+    }
+
+  /* Правила прореживания NMEA строк. */
+  if (params->decimation != NULL)
+    {
+      HyScanNmeaParserRate rates[HYSCAN_NMEA_PARSER_MAX_RATES];
+      gchar **rules = hyscan_nmea_driver_split_list (params->decimation);
+      guint n_rates;
+
+      if (!hyscan_nmea_driver_parse_rates (rules, rates, &n_rates) ||
+          !hyscan_nmea_receiver_set_decimation (receiver, rates, n_rates))
         {
-          HyScanNmeaUART *uart;
-          gchar *uart_path = NULL;
-          GList *devices, *device;
+          g_warning ("HyScanNmeaDriver: error in sentence decimation '%s'", params->decimation);
+        }
 
-          /* Ищем путь к устройству по идентификатору UART порта. */
-          device = devices = hyscan_nmea_uart_list_devices ();
-          while (device != NULL)
-            {
-              HyScanNmeaUARTDevice *info = device->data;
-              guint port_id = g_str_hash (info->path);
+      g_strfreev (rules);
+    }
+
+  /* Срочные NMEA строки. */
+  if (params->urgent != NULL)
+    {
+      gchar **patterns = hyscan_nmea_driver_split_list (params->urgent);
 
-              if (port_id == params->uart_port)
-                {
-                  uart_path = g_strdup (info->path);
-                  break;
-                }
+      if (!hyscan_nmea_receiver_set_urgent (receiver, (const gchar * const *)patterns))
+        g_warning ("HyScanNmeaDriver: error in urgent sentences '%s'", params->urgent);
 
-              device = g_list_next (device);
-            }
-          g_list_free_full (devices, (GDestroyNotify)hyscan_nmea_uart_device_free);
+      g_strfreev (patterns);
+    }
 
-          /* Открываем порт. */
-          if (uart_path != NULL)
+  return receiver;
+}
+
+/* Функция подключается к определённому UART или UDP порту. */
+static gboolean
+hyscan_nmea_driver_connect (HyScanNmeaDriver *driver)
+{
+  HyScanNmeaDriverPrivate *priv = driver->priv;
+  HyScanNmeaDriverParams *params = &priv->params;
+  HyScanNmeaReceiver *receiver = NULL;
+
+  /* Определённый UART порт. */
+  if (g_ascii_strcasecmp (priv->uri, HYSCAN_NMEA_DRIVER_UART_URI) == 0)
+    {
+      HyScanNmeaUART *uart;
+      gchar *uart_path = NULL;
+      GList *devices, *device;
+
+      /* Ищем путь к устройству по идентификатору UART порта. */
+      device = devices = hyscan_nmea_uart_list_devices ();
+      while (device != NULL)
+        {
+          HyScanNmeaUARTDevice *info = device->data;
+          guint port_id = g_str_hash (info->path);
+
+          if (port_id == params->uart_port)
             {
-              uart = hyscan_nmea_uart_new ();
-
-              if (!hyscan_nmea_uart_set_device (uart, uart_path, params->uart_mode))
-                {
-                  g_clear_object (&uart);
-                }
-              else
-                {
-                  priv->transport = G_OBJECT (uart);
-
-                  g_signal_connect (priv->transport, "nmea-data",
-                                    G_CALLBACK (hyscan_nmea_driver_emmiter), driver);
-                  g_signal_connect (priv->transport, "nmea-io-error",
-                                    G_CALLBACK (hyscan_nmea_driver_io_error), driver);
-                }
-
-              g_free (uart_path);
+              uart_path = g_strdup (info->path);
+              break;
             }
+
+          device = g_list_next (device);
         }
+      g_list_free_full (devices, (GDestroyNotify)hyscan_nmea_uart_device_free);
 
-      /* Определённый UDP порт. */
-      else if (g_ascii_strcasecmp (priv->uri, HYSCAN_NMEA_DRIVER_UDP_URI) == 0)
+      /* Открываем порт. */
+      if (uart_path != NULL)
         {
-          HyScanNmeaUDP *udp;
-          gchar *address = NULL;
+          uart = hyscan_nmea_driver_new_receiver (driver, HYSCAN_TYPE_NMEA_UART);
 
-          /* Выбраны все адреса. */
-          if (params->udp_address == 0)
-            {
-              address = g_strdup ("any");
-            }
+          if (!hyscan_nmea_uart_set_device (uart, uart_path, params->uart_mode))
+            g_clear_object (&uart);
 
-          /* Loopback адрес. */
-          else if (params->udp_address == 1)
-            {
-              address = g_strdup ("loopback");
-            }
+          receiver = HYSCAN_NMEA_RECEIVER (uart);
 
-          /* Ищем выбранный адрес по его идентификатору. */
-          else
-            {
-              gchar **addresses = hyscan_nmea_udp_list_addresses ();
-              guint i;
+          g_free (uart_path);
+        }
+    }
+
+  /* Определённый UDP порт. */
+  else if (g_ascii_strcasecmp (priv->uri, HYSCAN_NMEA_DRIVER_UDP_URI) == 0)
+    {
+      HyScanNmeaUDP *udp;
+      gchar *address = NULL;
 
-              for (i = 0; (addresses != NULL) && (addresses[i] != NULL); i++)
-                {
-                  guint address_id = g_str_hash (addresses[i]);
+      /* Выбраны все адреса. */
+      if (params->udp_address == 0)
+        {
+          address = g_strdup ("any");
+        }
 
-                  if (address_id == params->udp_address)
-                    address = g_strdup (addresses [i]);
-                }
+      /* Loopback адрес. */
+      else if (params->udp_address == 1)
+        {
+          address = g_strdup ("loopback");
+        }
 
-              g_strfreev (addresses);
-            }
+      /* Ищем выбранный адрес по его идентификатору. */
+      else
+        {
+          gchar **addresses = hyscan_nmea_udp_list_addresses ();
+          guint i;
 
-          if (address != NULL)
+          for (i = 0; (addresses != NULL) && (addresses[i] != NULL); i++)
             {
-              udp = hyscan_nmea_udp_new ();
-
-              if (!hyscan_nmea_udp_set_address (udp, address, params->udp_port))
-                {
-                  g_clear_object (&udp);
-                }
-              else
-                {
-                  priv->transport = G_OBJECT (udp);
-
-                  g_signal_connect (priv->transport, "nmea-data",
-                                    G_CALLBACK (hyscan_nmea_driver_emmiter), driver);
-                  g_signal_connect (priv->transport, "nmea-io-error",
-                                    G_CALLBACK (hyscan_nmea_driver_io_error), driver);
-                }
-
-              g_free (address);
+              guint address_id = g_str_hash (addresses[i]);
+
+              if (address_id == params->udp_address)
+                address = g_strdup (addresses [i]);
             }
+
+          g_strfreev (addresses);
         }
 
-      g_usleep (100000);
+      if (address != NULL)
+        {
+          udp = hyscan_nmea_driver_new_receiver (driver, HYSCAN_TYPE_NMEA_UDP);
+          hyscan_nmea_udp_set_flush (udp, params->udp_datagram, params->udp_timeout);
+
+          if (!hyscan_nmea_udp_set_address (udp, address, params->udp_port))
+            g_clear_object (&udp);
+
+          receiver = HYSCAN_NMEA_RECEIVER (udp);
+
+          g_free (address);
+        }
     }
 
-  return NULL;
+  if (receiver == NULL)
+    return FALSE;
+
+  hyscan_nmea_receiver_set_batch_func (receiver, hyscan_nmea_driver_emmiter, MAX_BATCH_SIZE, driver);
+  g_signal_connect (receiver, "nmea-io-error",
+                    G_CALLBACK (hyscan_nmea_driver_io_error), driver);
+
+  priv->n_sentences = 0;
+  g_atomic_pointer_set (&priv->transport, G_OBJECT (receiver));
+
+  return TRUE;
 }
 
-/* Поток автоматического поиска подключенных NMEA UART датчиков. */
-static gpointer
-hyscan_nmea_driver_scanner (gpointer user_data)
+/* Функция запускает поиск данных на всех UART портах. */
+static GList *
+hyscan_nmea_driver_scan (HyScanNmeaDriver *driver)
 {
-  HyScanNmeaDriver *driver = user_data;
-  HyScanNmeaDriverPrivate *priv = driver->priv;
-
-  GTimer *timer = g_timer_new ();
   GList *uarts = NULL;
+  GList *devices, *device;
 
-  while (!g_atomic_int_get (&priv->shutdown))
+  device = devices = hyscan_nmea_uart_list_devices ();
+  while (device != NULL)
     {
-      /* Порт с данным найден. */
-      if (g_atomic_pointer_get (&priv->transport) != NULL)
-        {
-          /* Останавливаем поиск. */
-          if (uarts != NULL)
-            {
-              g_list_free_full (uarts, g_object_unref);
-              uarts = NULL;
-            }
+      HyScanNmeaUART *uart = hyscan_nmea_driver_new_receiver (driver, HYSCAN_TYPE_NMEA_UART);
+      HyScanNmeaUARTDevice *info = device->data;
 
-          /* Проверка приёма данных. */
-          hyscan_nmea_driver_check_data (driver);
-        }
+      if (hyscan_nmea_uart_set_device (uart, info->path, HYSCAN_NMEA_UART_MODE_AUTO))
+        uarts = g_list_prepend (uarts, uart);
+      else
+        g_clear_object (&uart);
 
-      /* Запускаем поиск данных на всех портах и смотрим где появятся данные. */
-      else if (uarts == NULL)
-        {
-          GList *devices, *device;
+      device = g_list_next (device);
+    }
+  g_list_free_full (devices, (GDestroyNotify)hyscan_nmea_uart_device_free);
 
-          device = devices = hyscan_nmea_uart_list_devices ();
-          while (device != NULL)
-            {
-              HyScanNmeaUART *uart = hyscan_nmea_uart_new ();
-              HyScanNmeaUARTDevice *info = device->data;
+  return uarts;
+}
 
-              if (hyscan_nmea_uart_set_device (uart, info->path, HYSCAN_NMEA_UART_MODE_AUTO))
-                uarts = g_list_prepend (uarts, uart);
-              else
-                g_clear_object (&uart);
+/* Таймер подключения к NMEA датчикам. Таймер срабатывает при
+ * необходимости повторного подключения, по истечении таймаутов
+ * приёма данных, а также при изменении состояния порта. */
+static gboolean
+hyscan_nmea_driver_watchdog (gpointer user_data)
+{
+  HyScanNmeaDriver *driver = user_data;
+  HyScanNmeaDriverPrivate *priv = driver->priv;
+  gint64 cur_time = g_get_monotonic_time ();
+  gint64 next_time = -1;
 
-              if (uart != NULL)
-                g_signal_connect (uart, "nmea-data", G_CALLBACK (hyscan_nmea_driver_tester), driver);
+  /* Подключаемся к определённому UART или UDP порту. */
+  if ((g_atomic_pointer_get (&priv->transport) == NULL) && !priv->scan)
+    {
+      if (!hyscan_nmea_driver_connect (driver))
+        next_time = cur_time + RECONNECT_TIME;
+    }
 
-              device = g_list_next (device);
-            }
-          g_list_free_full (devices, (GDestroyNotify)hyscan_nmea_uart_device_free);
+  /* Запускаем поиск данных на всех портах и смотрим где появятся данные.
+   * За 25 секунд дважды изменяются все возможные скорости работы порта,
+   * поэтому поиск перезапускается с обновлённым списком портов. Порты
+   * проверяются каждые SCAN_CHECK_TIME мкс. */
+  else if (g_atomic_pointer_get (&priv->transport) == NULL)
+    {
+      hyscan_nmea_driver_find (driver);
 
-          g_timer_start (timer);
+      if ((priv->uarts != NULL) && (cur_time >= priv->scan_time))
+        {
+          g_list_free_full (priv->uarts, g_object_unref);
+          priv->uarts = NULL;
         }
 
-      /* За 25 секунд дважды изменяются все возможные скорости работы порта,
-       * поэтому останавливаем поиск. Позже он будет запущен вновь с
-       * обновлённым списоком портов. */
-      else if (g_timer_elapsed (timer, NULL) > 25.0)
+      if ((priv->uarts == NULL) && (g_atomic_pointer_get (&priv->transport) == NULL))
         {
-          if (uarts != NULL)
-            {
-              g_list_free_full (uarts, g_object_unref);
-              uarts = NULL;
-            }
+          priv->uarts = hyscan_nmea_driver_scan (driver);
+          priv->scan_time = cur_time + SCAN_TIME;
         }
 
-      g_usleep (100000);
+      if (priv->uarts != NULL)
+        next_time = MIN (priv->scan_time, cur_time + SCAN_CHECK_TIME);
+      else
+        next_time = cur_time + RECONNECT_TIME;
     }
 
-  g_list_free_full (uarts, g_object_unref);
-  g_timer_destroy (timer);
+  /* Подключение установлено - проверяем приём данных. */
+  if (g_atomic_pointer_get (&priv->transport) != NULL)
+    {
+      /* Порт с данными найден, останавливаем поиск. */
+      if (priv->uarts != NULL)
+        {
+          g_list_free_full (priv->uarts, g_object_unref);
+          priv->uarts = NULL;
+        }
 
-  return NULL;
+      next_time = hyscan_nmea_driver_check_data (driver);
+    }
+
+  g_source_set_ready_time (priv->watchdog, next_time);
+
+  return G_SOURCE_CONTINUE;
 }
 
-/* Функция проверяет приём данных и перезапускает порт при необходимости. */
-static void
+/* Функция проверяет приём данных и перезапускает порт при необходимости.
+ * Функция возвращает время следующей проверки. */
+static gint64
 hyscan_nmea_driver_check_data (HyScanNmeaDriver *driver)
 {
   HyScanNmeaDriverPrivate *priv = driver->priv;
   HyScanNmeaDriverParams *params = &priv->params;
 
-  gdouble data_timeout = g_timer_elapsed (priv->data_timer, NULL);
-  gint cur_status = g_atomic_int_get (&priv->status);
+  gdouble data_timeout;
+  gint cur_status;
   gboolean io_error = FALSE;
+  gdouble next_timeout;
+  guint n_sentences;
+
+  /* Приём NMEA строк определяется по их числу, а не по отправленным
+   * блокам, так как все строки могут отбрасываться фильтром. */
+  n_sentences = hyscan_nmea_receiver_get_n_sentences (HYSCAN_NMEA_RECEIVER (priv->transport));
+  if (n_sentences != priv->n_sentences)
+    {
+      priv->n_sentences = n_sentences;
+      g_timer_start (priv->data_timer);
+      g_atomic_int_set (&priv->status, HYSCAN_DEVICE_STATUS_OK);
+    }
+
+  data_timeout = g_timer_elapsed (priv->data_timer, NULL);
+  cur_status = g_atomic_int_get (&priv->status);
 
   /* Ошибка ввода/вывода - перезапускаем порт. */
   if (g_atomic_int_get (&priv->io_error))
     {
+      priv->dropped_base += hyscan_nmea_receiver_get_dropped (HYSCAN_NMEA_RECEIVER (priv->transport));
+
       g_object_unref (priv->transport);
       g_atomic_pointer_set (&priv->transport, NULL);
 
+      /* Поток отправки данных порта уже завершён, учитываем
+       * отброшенные им блоки. */
+      g_atomic_int_set (&priv->n_dropped, priv->dropped_base);
+
       g_atomic_int_set (&priv->status, HYSCAN_DEVICE_STATUS_ERROR);
       g_atomic_int_set (&priv->io_error, FALSE);
 
@@ -675,6 +1022,24 @@ hyscan_nmea_driver_check_data (HyScanNmeaDriver *driver)
 
       g_atomic_int_set (&priv->prev_status, cur_status);
     }
+
+  /* Порт необходимо открыть повторно. */
+  if (io_error)
+    return 0;
+
+  /* Следующая проверка - в момент истечения очередного таймаута. Если
+   * данных нет, порт проверяется периодически, так как отфильтрованные
+   * строки не вызывают отправку блоков и проверку приёма данных. */
+  if (cur_status == HYSCAN_DEVICE_STATUS_OK)
+    next_timeout = MIN (params->warning_timeout, params->error_timeout);
+  else if (cur_status == HYSCAN_DEVICE_STATUS_WARNING)
+    next_timeout = params->error_timeout;
+  else
+    return g_get_monotonic_time () + RECONNECT_TIME;
+
+  next_timeout = MAX (next_timeout - data_timeout, 0.0);
+
+  return g_get_monotonic_time () + G_USEC_PER_SEC * next_timeout + 1000;
 }
 
 /* Функция регистрирует сигнал ошибки чтения данных от устройства. */
@@ -682,56 +1047,117 @@ static void
 hyscan_nmea_driver_io_error (HyScanNmeaReceiver *receiver,
                              HyScanNmeaDriver   *driver)
 {
-  g_atomic_int_set (&driver->priv->io_error, TRUE);
+  HyScanNmeaDriverPrivate *priv = driver->priv;
+
+  g_atomic_int_set (&priv->io_error, TRUE);
+  g_source_set_ready_time (priv->watchdog, 0);
 }
 
-/* Функция проверяет приём данных от UART датчика. */
+/* Функция выбирает UART порт, на котором при поиске приняты NMEA строки.
+ * Строки учитываются до фильтрации, поэтому порт находится, даже если все
+ * его строки отбрасываются фильтром. */
 static void
-hyscan_nmea_driver_tester (HyScanNmeaReceiver *receiver,
-                           gint64              time,
-                           const gchar        *data,
-                           guint               size,
-                           HyScanNmeaDriver   *driver)
+hyscan_nmea_driver_find (HyScanNmeaDriver *driver)
 {
   HyScanNmeaDriverPrivate *priv = driver->priv;
+  GList *uart;
 
-  if (g_atomic_pointer_compare_and_exchange (&priv->transport, NULL, receiver))
+  for (uart = priv->uarts; uart != NULL; uart = g_list_next (uart))
     {
-      g_signal_handlers_disconnect_by_func (receiver, hyscan_nmea_driver_tester, driver);
+      HyScanNmeaReceiver *receiver = uart->data;
 
-      g_signal_connect (receiver, "nmea-data",
-                        G_CALLBACK (hyscan_nmea_driver_emmiter), driver);
+      if (hyscan_nmea_receiver_get_n_sentences (receiver) == 0)
+        continue;
+
+      hyscan_nmea_receiver_set_batch_func (receiver, hyscan_nmea_driver_emmiter, MAX_BATCH_SIZE, driver);
       g_signal_connect (receiver, "nmea-io-error",
                         G_CALLBACK (hyscan_nmea_driver_io_error), driver);
 
-      g_object_ref (receiver);
+      priv->n_sentences = 0;
+      g_atomic_pointer_set (&priv->transport, g_object_ref (receiver));
+
+      return;
     }
 }
 
-/* Функция отправки данных. */
+/* Функция отправки данных. Состояние датчика обновляется один раз
+ * для всего пакета блоков данных. */
 static void
-hyscan_nmea_driver_emmiter (HyScanNmeaReceiver *receiver,
-                            gint64              time,
-                            const gchar        *data,
-                            guint               size,
-                            HyScanNmeaDriver   *driver)
+hyscan_nmea_driver_emmiter (HyScanNmeaReceiver            *receiver,
+                            const HyScanNmeaReceiverBlock *blocks,
+                            guint                          n_blocks,
+                            gpointer                       user_data)
 {
+  HyScanNmeaDriver *driver = user_data;
   HyScanNmeaDriverPrivate *priv = driver->priv;
+  gboolean enable;
+  gboolean fields_enable;
+  gboolean urgent_enable;
+  guint i;
 
   /* Сбрасываем таймер таймаута данных. */
   g_timer_start (priv->data_timer);
 
-  /* Сигнализируем о приёме данных. */
-  g_atomic_int_set (&priv->status, HYSCAN_DEVICE_STATUS_OK);
+  /* Число отброшенных блоков данных. */
+  g_atomic_int_set (&priv->n_dropped,
+                    priv->dropped_base + hyscan_nmea_receiver_get_dropped (receiver));
+
+  /* Сигнализируем о приёме данных. При изменении статуса
+   * информируем об этом таймер проверки приёма данных. */
+  if (g_atomic_int_get (&priv->status) != HYSCAN_DEVICE_STATUS_OK)
+    {
+      g_atomic_int_set (&priv->status, HYSCAN_DEVICE_STATUS_OK);
+      g_source_set_ready_time (priv->watchdog, 0);
+    }
+
+  enable = g_atomic_int_get (&priv->enable);
+  fields_enable = g_atomic_int_get (&priv->fields_enable);
+  urgent_enable = g_atomic_int_get (&priv->urgent_enable);
 
   /* Приём данных отключен. */
-  if (!g_atomic_int_get (&priv->enable))
+  if (!enable && !fields_enable && !urgent_enable)
     return;
 
-  /* Отправка всех NMEA данных. */
-  hyscan_buffer_wrap (priv->buffer, HYSCAN_DATA_STRING, (gpointer)data, size);
-  hyscan_sensor_driver_send_data (driver, priv->params.dev_id,
-                                  HYSCAN_SOURCE_NMEA, time, priv->buffer);
+  /* Отправка всех NMEA данных. Каждый блок имеет собственную метку
+   * времени, поэтому блоки отправляются по отдельности. */
+  for (i = 0; i < n_blocks; i++)
+    {
+      HyScanNmeaFields fields;
+
+      /* Срочные строки отправляются через отдельный датчик, так как
+       * они могут опередить блоки с меньшей меткой времени. Значения
+       * полей разбираются только из обычных блоков. */
+      if (blocks[i].urgent)
+        {
+          if (urgent_enable)
+            {
+              hyscan_buffer_wrap (priv->buffer, HYSCAN_DATA_STRING, (gpointer)blocks[i].data, blocks[i].size);
+              hyscan_sensor_driver_send_data (driver, priv->urgent_id,
+                                              HYSCAN_SOURCE_NMEA, blocks[i].time, priv->buffer);
+            }
+
+          continue;
+        }
+
+      if (enable)
+        {
+          hyscan_buffer_wrap (priv->buffer, HYSCAN_DATA_STRING, (gpointer)blocks[i].data, blocks[i].size);
+          hyscan_sensor_driver_send_data (driver, priv->params.dev_id,
+                                          HYSCAN_SOURCE_NMEA, blocks[i].time, priv->buffer);
+        }
+
+      /* Разобранные значения полей отправляются через отдельный
+       * датчик с той же меткой времени. */
+      if (!fields_enable)
+        continue;
+
+      if (!hyscan_nmea_fields_parse (&fields, blocks[i].data, blocks[i].size))
+        continue;
+
+      hyscan_buffer_wrap (priv->fields_buffer, HYSCAN_DATA_BLOB, &fields, sizeof (fields));
+      hyscan_sensor_driver_send_data (driver, priv->fields_id,
+                                      HYSCAN_SOURCE_NMEA, blocks[i].time, priv->fields_buffer);
+    }
 }
 
 static HyScanDataSchema *
@@ -750,12 +1176,21 @@ hyscan_nmea_driver_param_get (HyScanParam      *param,
   HyScanNmeaDriver *driver = HYSCAN_NMEA_DRIVER (param);
   HyScanNmeaDriverPrivate *priv = driver->priv;
   const gchar * const *params;
+  guint i;
 
   params = hyscan_param_list_params (list);
-  if ((params == NULL) || (g_strcmp0 (params[0], priv->status_name) != 0))
+  if (params == NULL)
     return FALSE;
 
-  hyscan_param_list_set_enum (list, priv->status_name, g_atomic_int_get (&priv->status));
+  for (i = 0; params[i] != NULL; i++)
+    {
+      if (g_strcmp0 (params[i], priv->status_name) == 0)
+        hyscan_param_list_set_enum (list, params[i], g_atomic_int_get (&priv->status));
+      else if (g_strcmp0 (params[i], priv->dropped_name) == 0)
+        hyscan_param_list_set_integer (list, params[i], (guint)g_atomic_int_get (&priv->n_dropped));
+      else
+        return FALSE;
+    }
 
   return TRUE;
 }
@@ -768,11 +1203,15 @@ hyscan_nmea_driver_sensor_set_enable (HyScanSensor *sensor,
   HyScanNmeaDriver *driver = HYSCAN_NMEA_DRIVER (sensor);
   HyScanNmeaDriverPrivate *priv = driver->priv;
 
-  if (g_strcmp0 (priv->params.dev_id, name) != 0)
+  if (g_strcmp0 (priv->params.dev_id, name) == 0)
+    g_atomic_int_set (&priv->enable, enable);
+  else if ((priv->fields_id != NULL) && (g_strcmp0 (priv->fields_id, name) == 0))
+    g_atomic_int_set (&priv->fields_enable, enable);
+  else if ((priv->urgent_id != NULL) && (g_strcmp0 (priv->urgent_id, name) == 0))
+    g_atomic_int_set (&priv->urgent_enable, enable);
+  else
     return FALSE;
 
-  g_atomic_int_set (&priv->enable, enable);
-
   return TRUE;
 }
 
@@ -852,6 +1291,130 @@ hyscan_nmea_driver_get_connect_schema (const gchar *uri,
   hyscan_data_schema_builder_key_double_range  (builder, PARAM_TIMEOUT_ERROR,
                                                 30.0, 60.0, 1.0);
 
+  /* Отправка данных из потока приёма, без промежуточного потока. */
+  hyscan_data_schema_builder_key_boolean_create (builder, PARAM_DELIVERY_INLINE,
+                                                 _("Inline delivery"),
+                                                 _("Deliver data from the receiving thread "
+                                                   "for minimum latency"),
+                                                 FALSE);
+
+  /* Отправка блока после строки, которой обычно завершается эпоха. */
+  hyscan_data_schema_builder_key_boolean_create (builder, PARAM_DELIVERY_PREDICT,
+                                                 _("Predict epoch end"),
+                                                 _("Deliver block as soon as the sentence "
+                                                   "that usually ends an epoch is received"),
+                                                 FALSE);
+
+  /* Отправка разобранных значений полей. */
+  hyscan_data_schema_builder_key_boolean_create (builder, PARAM_DELIVERY_FIELDS,
+                                                 _("Decoded fields"),
+                                                 _("Deliver time, position, speed, track and "
+                                                   "heading decoded from every block as a binary "
+                                                   "record through a separate sensor"),
+                                                 FALSE);
+
+  /* Группировка строк без времени. */
+  hyscan_data_schema_builder_key_double_create (builder, PARAM_UNTIMED_WINDOW,
+                                                _("Untimed grouping window"),
+                                                _("Group sentences without time received within "
+                                                  "this interval, zero disables grouping"),
+                                                0.0);
+  hyscan_data_schema_builder_key_double_range  (builder, PARAM_UNTIMED_WINDOW,
+                                                0.0, 10.0, 0.01);
+
+  hyscan_data_schema_builder_key_integer_create (builder, PARAM_UNTIMED_COUNT,
+                                                 _("Untimed grouping count"),
+                                                 _("Maximum number of sentences without time "
+                                                   "in a block, zero means no limit"),
+                                                 0);
+  hyscan_data_schema_builder_key_integer_range  (builder, PARAM_UNTIMED_COUNT,
+                                                 0, 1024, 1);
+
+  /* Фильтр NMEA строк. */
+  hyscan_data_schema_builder_enum_create (builder, "filter-mode");
+
+  hyscan_data_schema_builder_enum_value_create (builder, "filter-mode",
+                                                FILTER_NONE, "none",
+                                                _("Receive all sentences"), NULL);
+  hyscan_data_schema_builder_enum_value_create (builder, "filter-mode",
+                                                FILTER_ALLOW, "allow",
+                                                _("Receive listed sentences only"), NULL);
+  hyscan_data_schema_builder_enum_value_create (builder, "filter-mode",
+                                                FILTER_DENY, "deny",
+                                                _("Drop listed sentences"), NULL);
+
+  hyscan_data_schema_builder_key_enum_create (builder, PARAM_FILTER_MODE,
+                                              _("Sentence filter"), NULL,
+                                              "filter-mode", FILTER_NONE);
+
+  hyscan_data_schema_builder_key_string_create (builder, PARAM_FILTER_SENTENCES,
+                                                _("Filtered sentences"),
+                                                _("Comma separated talker and sentence types, "
+                                                  "for example GSV, GPGSA, ??VTG or P*"),
+                                                "");
+
+  /* Прореживание NMEA строк. */
+  hyscan_data_schema_builder_key_string_create (builder, PARAM_DECIMATION_SENTENCES,
+                                                _("Sentence decimation"),
+                                                _("Comma separated rules: HPR@10 passes at most "
+                                                  "10 sentences per second, GSV/5 passes every "
+                                                  "fifth sentence"),
+                                                "");
+
+  /* Срочные NMEA строки. */
+  hyscan_data_schema_builder_key_string_create (builder, PARAM_URGENT_SENTENCES,
+                                                _("Urgent sentences"),
+                                                _("Comma separated sentence types delivered "
+                                                  "immediately, for example HDT, THS or PASHR"),
+                                                "");
+
+  /* Буфер сообщений. */
+  hyscan_data_schema_builder_key_integer_create (builder, PARAM_BUFFER_COUNT,
+                                                 _("Number of buffers"), NULL,
+                                                 DEFAULT_BUFFER_COUNT);
+  hyscan_data_schema_builder_key_integer_range  (builder, PARAM_BUFFER_COUNT,
+                                                 2, 4096, 1);
+
+  hyscan_data_schema_builder_key_integer_create (builder, PARAM_BUFFER_SIZE,
+                                                 _("Maximum block size"), NULL,
+                                                 DEFAULT_BUFFER_SIZE);
+  hyscan_data_schema_builder_key_integer_range  (builder, PARAM_BUFFER_SIZE,
+                                                 256, 1048576, 1);
+
+  hyscan_data_schema_builder_key_integer_create (builder, PARAM_BUFFER_CAPACITY,
+                                                 _("Buffer capacity"),
+                                                 _("Memory for buffered blocks, blocks take "
+                                                   "only as much space as their data"),
+                                                 DEFAULT_BUFFER_CAPACITY);
+  hyscan_data_schema_builder_key_integer_range  (builder, PARAM_BUFFER_CAPACITY,
+                                                 4096, 67108864, 1);
+
+  hyscan_data_schema_builder_enum_create (builder, "buffer-overflow");
+
+  hyscan_data_schema_builder_enum_value_create (builder, "buffer-overflow",
+                                                HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST, "drop-newest",
+                                                _("Drop newest"), NULL);
+  hyscan_data_schema_builder_enum_value_create (builder, "buffer-overflow",
+                                                HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_OLDEST, "drop-oldest",
+                                                _("Drop oldest"), NULL);
+  hyscan_data_schema_builder_enum_value_create (builder, "buffer-overflow",
+                                                HYSCAN_NMEA_RECEIVER_OVERFLOW_BLOCK, "block",
+                                                _("Wait for free space"),
+                                                _("Stalls every device served by the receiving thread, "
+                                                  "the wait is limited to 5 ms"));
+
+  hyscan_data_schema_builder_key_enum_create (builder, PARAM_BUFFER_OVERFLOW,
+                                              _("Overflow policy"), NULL,
+                                              "buffer-overflow", HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST);
+
+  hyscan_data_schema_builder_key_double_create (builder, PARAM_BUFFER_TIMEOUT,
+                                                _("Maximum wait for free space"),
+                                                _("The receiving thread is shared by all devices, "
+                                                  "so the wait is limited to 5 ms"),
+                                                DEFAULT_BUFFER_TIMEOUT);
+  hyscan_data_schema_builder_key_double_range  (builder, PARAM_BUFFER_TIMEOUT,
+                                                0.0, 0.005, 0.001);
+
   /* Параметры UART порта. */
   if (full || (g_ascii_strcasecmp (uri, HYSCAN_NMEA_DRIVER_UART_URI) == 0))
     {
@@ -945,6 +1508,20 @@ hyscan_nmea_driver_get_connect_schema (const gchar *uri,
                                                      _("UDP port"), NULL, DEFAULT_UDP_PORT);
       hyscan_data_schema_builder_key_integer_range  (builder, PARAM_UDP_PORT,
                                                      1024, 65535, 1);
+
+      /* Отправка блоков данных. */
+      hyscan_data_schema_builder_key_boolean_create (builder, PARAM_UDP_DATAGRAM,
+                                                     _("Datagram is a block"),
+                                                     _("Deliver block at the end of every datagram"),
+                                                     FALSE);
+
+      hyscan_data_schema_builder_key_double_create (builder, PARAM_UDP_TIMEOUT,
+                                                    _("Block timeout"),
+                                                    _("Deliver block if no datagrams were received "
+                                                      "during this time, zero disables timeout"),
+                                                    DEFAULT_UDP_TIMEOUT);
+      hyscan_data_schema_builder_key_double_range  (builder, PARAM_UDP_TIMEOUT,
+                                                    0.0, 10.0, 0.01);
     }
 
   schema = hyscan_data_schema_builder_get_schema (builder);
@@ -991,6 +1568,48 @@ hyscan_nmea_driver_check_connect (const gchar     *uri,
       GVariant *value = hyscan_param_list_get (params, names[i]);
       if (!hyscan_data_schema_key_check (schema, names[i], value))
         status = FALSE;
+
+      /* Шаблоны фильтра NMEA строк. */
+      else if (g_strcmp0 (names[i], PARAM_FILTER_SENTENCES) == 0)
+        {
+          HyScanNmeaParserFilter filter;
+          gchar **patterns;
+
+          patterns = hyscan_nmea_driver_split_list (g_variant_get_string (value, NULL));
+          if (!hyscan_nmea_parser_filter_compile (&filter, (const gchar * const *)patterns, TRUE))
+            status = FALSE;
+          g_strfreev (patterns);
+        }
+
+      /* Правила прореживания NMEA строк. */
+      else if (g_strcmp0 (names[i], PARAM_DECIMATION_SENTENCES) == 0)
+        {
+          HyScanNmeaParserRate rates[HYSCAN_NMEA_PARSER_MAX_RATES];
+          HyScanNmeaParserDecimation decimation;
+          gchar **rules;
+          guint n_rates;
+
+          rules = hyscan_nmea_driver_split_list (g_variant_get_string (value, NULL));
+          if (!hyscan_nmea_driver_parse_rates (rules, rates, &n_rates) ||
+              !hyscan_nmea_parser_decimation_compile (&decimation, rates, n_rates))
+            {
+              status = FALSE;
+            }
+          g_strfreev (rules);
+        }
+
+      /* Шаблоны срочных NMEA строк. */
+      else if (g_strcmp0 (names[i], PARAM_URGENT_SENTENCES) == 0)
+        {
+          HyScanNmeaParserFilter urgent;
+          gchar **patterns;
+
+          patterns = hyscan_nmea_driver_split_list (g_variant_get_string (value, NULL));
+          if (!hyscan_nmea_parser_filter_compile (&urgent, (const gchar * const *)patterns, TRUE))
+            status = FALSE;
+          g_strfreev (patterns);
+        }
+
       g_variant_unref (value);
     }
 
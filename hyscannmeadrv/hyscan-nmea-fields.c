@@ -0,0 +1,373 @@
+/* hyscan-nmea-fields.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/**
+ * SECTION: hyscan-nmea-fields
+ * @Short_description: разбор значений полей NMEA строк
+ * @Title: HyScanNmeaFields
+ *
+ * Функции разбирают значения наиболее часто используемых полей NMEA строк:
+ * время, координаты, высоту, признак качества решения, скорость и курс
+ * движения, истинный курс и снижение точности HDOP. Значения помещаются в
+ * структуру #HyScanNmeaFields, которая может передаваться потребителям
+ * данных вместо повторного разбора текста NMEA строк.
+ *
+ * Разбираются строки GGA, RMC, GNS, GLL, VTG, HDT и THS от любого
+ * источника. Строки с ошибкой контрольной суммы и значения, отмеченные в
+ * строке как недостоверные, не учитываются. Координаты разбираются функцией
+ * #hyscan_nmea_sentence_parse_coord, остальные числа - функцией
+ * #hyscan_nmea_sentence_parse_decimal.
+ *
+ * Функция #hyscan_nmea_fields_parse_sentence разбирает одну NMEA строку и
+ * дополняет уже разобранные значения. Функция #hyscan_nmea_fields_parse
+ * разбирает все строки блока NMEA данных, например одной эпохи. Если одно
+ * и то же значение присутствует в нескольких строках блока, используется
+ * значение из последней строки.
+ *
+ * Функции не выделяют память и могут вызываться из любого потока.
+ */
+
+#include "hyscan-nmea-fields.h"
+#include "hyscan-nmea-sentence.h"
+
+#include <string.h>
+
+/* Максимальное число полей NMEA строки, используемых при разборе. */
+#define HYSCAN_NMEA_FIELDS_MAX_FIELDS  12
+
+/* Минимальный размер NMEA строки с полями: "$GPHDT,*XX". */
+#define HYSCAN_NMEA_FIELDS_MIN_SIZE    10
+
+/* Скорость 1 узел в м/с. */
+#define HYSCAN_NMEA_FIELDS_KNOT        (1852.0 / 3600.0)
+
+/* Функция разбивает NMEA строку на поля. Поле с номером 0 - идентификатор
+ * строки. Каждое поле завершается символом ',' или '*'. Отсутствующие в
+ * строке поля указывают на символ '*' и считаются пустыми. */
+static void
+hyscan_nmea_fields_split (const gchar  *sentence,
+                          gsize         size,
+                          const gchar **fields)
+{
+  const gchar *end = sentence + size - 3;
+  const gchar *field = sentence;
+  guint i;
+
+  fields[0] = sentence;
+  for (i = 1; i < HYSCAN_NMEA_FIELDS_MAX_FIELDS; i++)
+    {
+      if (field != end)
+        {
+          field = memchr (field, ',', end - field);
+          field = (field != NULL) ? field + 1 : end;
+        }
+
+      fields[i] = field;
+    }
+}
+
+/* Функция разбирает поле времени вида "hhmmss" или "hhmmss.ssssss" и
+ * возвращает время от начала суток в микросекундах. */
+static gboolean
+hyscan_nmea_fields_parse_time (const gchar *field,
+                               gint64      *time)
+{
+  gint64 seconds;
+  gint64 usecs = 0;
+  guint n_digits = 0;
+  guint i;
+
+  for (i = 0; i < 6; i++)
+    if (!g_ascii_isdigit (field[i]))
+      return FALSE;
+
+  seconds = 3600 * (10 * (field[0] - '0') + (field[1] - '0')) +
+              60 * (10 * (field[2] - '0') + (field[3] - '0')) +
+                   (10 * (field[4] - '0') + (field[5] - '0'));
+
+  /* Доли секунды, учитываются первые 6 цифр. */
+  if (field[6] == '.')
+    {
+      for (field += 7; g_ascii_isdigit (*field); field++)
+        {
+          if (n_digits < 6)
+            {
+              usecs = 10 * usecs + (*field - '0');
+              n_digits += 1;
+            }
+        }
+    }
+
+  for (; n_digits < 6; n_digits++)
+    usecs *= 10;
+
+  *time = G_USEC_PER_SEC * seconds + usecs;
+
+  return TRUE;
+}
+
+/* Функция разбирает четыре поля координат: широта, N/S, долгота, E/W. */
+static gboolean
+hyscan_nmea_fields_parse_position (const gchar      **fields,
+                                   HyScanNmeaFields  *values)
+{
+  gdouble latitude;
+  gdouble longitude;
+
+  if ((hyscan_nmea_sentence_parse_coord (fields[0], &latitude) == NULL) ||
+      (hyscan_nmea_sentence_parse_coord (fields[2], &longitude) == NULL))
+    {
+      return FALSE;
+    }
+
+  if (fields[1][0] == 'S')
+    latitude = -latitude;
+  else if (fields[1][0] != 'N')
+    return FALSE;
+
+  if (fields[3][0] == 'W')
+    longitude = -longitude;
+  else if (fields[3][0] != 'E')
+    return FALSE;
+
+  values->latitude = latitude;
+  values->longitude = longitude;
+  values->mask |= HYSCAN_NMEA_FIELDS_POSITION;
+
+  return TRUE;
+}
+
+/* Функция разбирает десятичное поле и устанавливает признак значения. */
+static void
+hyscan_nmea_fields_parse_value (const gchar          *field,
+                                gdouble              *value,
+                                HyScanNmeaFieldsMask  flag,
+                                HyScanNmeaFields     *values)
+{
+  if (hyscan_nmea_sentence_parse_decimal (field, value) != NULL)
+    values->mask |= flag;
+}
+
+/* Функция разбирает поле времени и устанавливает признак значения. */
+static void
+hyscan_nmea_fields_parse_fix_time (const gchar      *field,
+                                   HyScanNmeaFields *values)
+{
+  if (hyscan_nmea_fields_parse_time (field, &values->time))
+    values->mask |= HYSCAN_NMEA_FIELDS_TIME;
+}
+
+/* Функция разбирает скорость в узлах и курс движения. */
+static void
+hyscan_nmea_fields_parse_motion (const gchar      *speed,
+                                 const gchar      *track,
+                                 HyScanNmeaFields *values)
+{
+  gdouble knots;
+
+  if (hyscan_nmea_sentence_parse_decimal (speed, &knots) != NULL)
+    {
+      values->speed = knots * HYSCAN_NMEA_FIELDS_KNOT;
+      values->mask |= HYSCAN_NMEA_FIELDS_SPEED;
+    }
+
+  hyscan_nmea_fields_parse_value (track, &values->track, HYSCAN_NMEA_FIELDS_TRACK, values);
+}
+
+/* Функция проверяет поле режима работы строки GNS. Решение отсутствует,
+ * если для всех навигационных систем указан режим 'N'. */
+static gboolean
+hyscan_nmea_fields_gns_valid (const gchar *mode)
+{
+  gboolean valid = FALSE;
+
+  for (; (*mode != ',') && (*mode != '*'); mode++)
+    valid |= (*mode != 'N');
+
+  return valid;
+}
+
+/**
+ * hyscan_nmea_fields_parse_sentence:
+ * @fields: указатель на #HyScanNmeaFields
+ * @sentence: указатель на NMEA строку
+ * @size: размер строки без символов "\r\n"
+ *
+ * Функция разбирает NMEA строку и дополняет значения в @fields. Значения,
+ * отсутствующие в строке, не изменяются. Перед разбором проверяется
+ * контрольная сумма строки.
+ *
+ * Returns: %TRUE если из строки разобрано хотя бы одно значение, в том
+ * числе уже присутствующее в @fields, иначе %FALSE.
+ */
+gboolean
+hyscan_nmea_fields_parse_sentence (HyScanNmeaFields *fields,
+                                   const gchar      *sentence,
+                                   gsize             size)
+{
+  const gchar *field[HYSCAN_NMEA_FIELDS_MAX_FIELDS];
+  guint32 prev_mask = fields->mask;
+  guint32 parsed_mask;
+  gint quality;
+
+  if ((size < HYSCAN_NMEA_FIELDS_MIN_SIZE) || (sentence[0] != '$') || (sentence[6] != ','))
+    return FALSE;
+
+  if (!hyscan_nmea_sentence_check (sentence, size))
+    return FALSE;
+
+  hyscan_nmea_fields_split (sentence, size, field);
+
+  /* Значения, разобранные из этой строки, отмечаются в пустой маске и
+   * затем добавляются к ранее разобранным. */
+  fields->mask = 0;
+
+  switch (hyscan_nmea_sentence_get_formatter (sentence))
+    {
+    /* GGA: время, координаты, качество, число спутников, HDOP, высота. */
+    case HYSCAN_NMEA_SENTENCE_KEY ('G', 'G', 'A'):
+      hyscan_nmea_fields_parse_fix_time (field[1], fields);
+
+      if (hyscan_nmea_sentence_parse_int (field[6], 1, &quality) == NULL)
+        break;
+
+      fields->quality = quality;
+      fields->mask |= HYSCAN_NMEA_FIELDS_QUALITY;
+
+      /* Решение отсутствует. */
+      if (quality == 0)
+        break;
+
+      hyscan_nmea_fields_parse_position (field + 2, fields);
+      hyscan_nmea_fields_parse_value (field[8], &fields->hdop, HYSCAN_NMEA_FIELDS_HDOP, fields);
+      hyscan_nmea_fields_parse_value (field[9], &fields->altitude, HYSCAN_NMEA_FIELDS_ALTITUDE, fields);
+      break;
+
+    /* RMC: время, статус, координаты, скорость в узлах, курс. */
+    case HYSCAN_NMEA_SENTENCE_KEY ('R', 'M', 'C'):
+      hyscan_nmea_fields_parse_fix_time (field[1], fields);
+
+      if (field[2][0] != 'A')
+        break;
+
+      hyscan_nmea_fields_parse_position (field + 3, fields);
+      hyscan_nmea_fields_parse_motion (field[7], field[8], fields);
+      break;
+
+    /* GNS: время, координаты, режим, число спутников, HDOP, высота. */
+    case HYSCAN_NMEA_SENTENCE_KEY ('G', 'N', 'S'):
+      hyscan_nmea_fields_parse_fix_time (field[1], fields);
+
+      if (!hyscan_nmea_fields_gns_valid (field[6]))
+        break;
+
+      hyscan_nmea_fields_parse_position (field + 2, fields);
+      hyscan_nmea_fields_parse_value (field[8], &fields->hdop, HYSCAN_NMEA_FIELDS_HDOP, fields);
+      hyscan_nmea_fields_parse_value (field[9], &fields->altitude, HYSCAN_NMEA_FIELDS_ALTITUDE, fields);
+      break;
+
+    /* GLL: координаты, время, статус. */
+    case HYSCAN_NMEA_SENTENCE_KEY ('G', 'L', 'L'):
+      hyscan_nmea_fields_parse_fix_time (field[5], fields);
+
+      if (field[6][0] == 'A')
+        hyscan_nmea_fields_parse_position (field + 1, fields);
+      break;
+
+    /* VTG: истинный курс, T, магнитный курс, M, скорость в узлах, N,
+     * скорость в км/ч, K, режим. */
+    case HYSCAN_NMEA_SENTENCE_KEY ('V', 'T', 'G'):
+      if (field[9][0] != 'N')
+        hyscan_nmea_fields_parse_motion (field[5], field[1], fields);
+      break;
+
+    /* HDT: истинный курс, T. */
+    case HYSCAN_NMEA_SENTENCE_KEY ('H', 'D', 'T'):
+      hyscan_nmea_fields_parse_value (field[1], &fields->heading, HYSCAN_NMEA_FIELDS_HEADING, fields);
+      break;
+
+    /* THS: истинный курс, режим. */
+    case HYSCAN_NMEA_SENTENCE_KEY ('T', 'H', 'S'):
+      if (field[2][0] != 'V')
+        hyscan_nmea_fields_parse_value (field[1], &fields->heading, HYSCAN_NMEA_FIELDS_HEADING, fields);
+      break;
+
+    default:
+      break;
+    }
+
+  parsed_mask = fields->mask;
+  fields->mask |= prev_mask;
+
+  return parsed_mask != 0;
+}
+
+/**
+ * hyscan_nmea_fields_parse:
+ * @fields: указатель на #HyScanNmeaFields
+ * @data: блок NMEA данных
+ * @size: размер данных
+ *
+ * Функция разбирает все NMEA строки блока данных. Строки в блоке разделяются
+ * символами "\r\n", данные могут завершаться нулевым символом. Перед
+ * разбором все значения в @fields обнуляются.
+ *
+ * Returns: %TRUE если разобрано хотя бы одно значение, иначе %FALSE.
+ */
+gboolean
+hyscan_nmea_fields_parse (HyScanNmeaFields *fields,
+                          const gchar      *data,
+                          gsize             size)
+{
+  const gchar *end = data + size;
+
+  memset (fields, 0, sizeof (HyScanNmeaFields));
+
+  while (data < end)
+    {
+      const gchar *lf = memchr (data, '\n', end - data);
+      const gchar *next = (lf != NULL) ? lf + 1 : end;
+      gsize line_size = (lf != NULL) ? (gsize)(lf - data) : (gsize)(end - data);
+
+      /* Символ '\r' и нулевой символ в конце строки. */
+      while ((line_size > 0) && ((data[line_size - 1] == '\r') || (data[line_size - 1] == 0)))
+        line_size -= 1;
+
+      hyscan_nmea_fields_parse_sentence (fields, data, line_size);
+
+      data = next;
+    }
+
+  return fields->mask != 0;
+}
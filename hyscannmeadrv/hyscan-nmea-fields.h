@@ -0,0 +1,112 @@
+/* hyscan-nmea-fields.h
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+#ifndef __HYSCAN_NMEA_FIELDS_H__
+#define __HYSCAN_NMEA_FIELDS_H__
+
+#include <hyscan-types.h>
+
+G_BEGIN_DECLS
+
+/**
+ * HyScanNmeaFieldsMask:
+ * @HYSCAN_NMEA_FIELDS_TIME: Время определения координат.
+ * @HYSCAN_NMEA_FIELDS_POSITION: Широта и долгота.
+ * @HYSCAN_NMEA_FIELDS_ALTITUDE: Высота над уровнем моря.
+ * @HYSCAN_NMEA_FIELDS_QUALITY: Признак качества решения.
+ * @HYSCAN_NMEA_FIELDS_SPEED: Скорость движения.
+ * @HYSCAN_NMEA_FIELDS_TRACK: Курс движения.
+ * @HYSCAN_NMEA_FIELDS_HEADING: Истинный курс.
+ * @HYSCAN_NMEA_FIELDS_HDOP: Снижение точности в горизонтальной плоскости.
+ *
+ * Признаки разобранных полей в структуре #HyScanNmeaFields.
+ */
+typedef enum
+{
+  HYSCAN_NMEA_FIELDS_TIME      = (1 << 0),
+  HYSCAN_NMEA_FIELDS_POSITION  = (1 << 1),
+  HYSCAN_NMEA_FIELDS_ALTITUDE  = (1 << 2),
+  HYSCAN_NMEA_FIELDS_QUALITY   = (1 << 3),
+  HYSCAN_NMEA_FIELDS_SPEED     = (1 << 4),
+  HYSCAN_NMEA_FIELDS_TRACK     = (1 << 5),
+  HYSCAN_NMEA_FIELDS_HEADING   = (1 << 6),
+  HYSCAN_NMEA_FIELDS_HDOP      = (1 << 7)
+} HyScanNmeaFieldsMask;
+
+/**
+ * HyScanNmeaFields:
+ * @mask: признаки разобранных полей #HyScanNmeaFieldsMask
+ * @quality: признак качества решения из строки GGA
+ * @time: время определения координат от начала суток UTC, мкс
+ * @latitude: широта, градусы, к северу положительная
+ * @longitude: долгота, градусы, к востоку положительная
+ * @altitude: высота над уровнем моря, м
+ * @speed: скорость движения, м/с
+ * @track: курс движения относительно истинного севера, градусы
+ * @heading: истинный курс, градусы
+ * @hdop: снижение точности в горизонтальной плоскости
+ *
+ * Значения полей, разобранных из одной эпохи NMEA данных. Значения полей,
+ * признаки которых в @mask не установлены, равны нулю. Структура не
+ * содержит указателей и выравнивания между полями, поэтому может
+ * передаваться как двоичная запись. Порядок байт соответствует порядку
+ * байт компьютера, на котором работает драйвер.
+ */
+typedef struct
+{
+  guint32                      mask;
+  gint32                       quality;
+  gint64                       time;
+  gdouble                      latitude;
+  gdouble                      longitude;
+  gdouble                      altitude;
+  gdouble                      speed;
+  gdouble                      track;
+  gdouble                      heading;
+  gdouble                      hdop;
+} HyScanNmeaFields;
+
+HYSCAN_API
+gboolean               hyscan_nmea_fields_parse_sentence       (HyScanNmeaFields      *fields,
+                                                                const gchar           *sentence,
+                                                                gsize                  size);
+
+HYSCAN_API
+gboolean               hyscan_nmea_fields_parse                (HyScanNmeaFields      *fields,
+                                                                const gchar           *data,
+                                                                gsize                  size);
+
+G_END_DECLS
+
+#endif /* __HYSCAN_NMEA_FIELDS_H__ */
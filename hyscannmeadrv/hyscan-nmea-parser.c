@@ -0,0 +1,1059 @@
+/* hyscan-nmea-parser.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/**
+ * SECTION: hyscan-nmea-parser
+ * @Short_description: разборщик потока NMEA данных
+ * @Title: HyScanNmeaParser
+ *
+ * Разборщик выделяет NMEA строки из потока символов, проверяет их
+ * контрольную сумму и группирует строки в блоки по NMEA времени, так же
+ * как это делает #HyScanNmeaReceiver. Разборщик не создаёт потоков, не
+ * использует блокировок и не выделяет память, поэтому его можно
+ * использовать в собственных циклах обработки данных, например при
+ * записи или последующей обработке NMEA данных. Структура
+ * #HyScanNmeaParser может размещаться на стеке или внутри других
+ * структур. Один разборщик нельзя использовать из нескольких потоков
+ * одновременно.
+ *
+ * Разборщик инициализируется функцией #hyscan_nmea_parser_init. Блоки
+ * собираются в буфере пользователя размером не менее
+ * HYSCAN_NMEA_PARSER_BUFFER_SIZE(max_size) байт. Если необходимо время
+ * приёма каждой строки блока, дополнительно передаётся таблица размером
+ * HYSCAN_NMEA_PARSER_MAX_LINES(max_size) элементов.
+ *
+ * Данные передаются разборщику функцией #hyscan_nmea_parser_push. Она
+ * обрабатывает данные до тех пор, пока не будет готов очередной блок, и
+ * возвращает число обработанных символов. Готовый блок забирается
+ * функцией #hyscan_nmea_parser_pull, после чего необходимо вызвать
+ * функцию #hyscan_nmea_parser_next. Она переносит начатую NMEA строку в
+ * новый буфер, если он указан, или в начало текущего буфера. Данные
+ * блока остаются действительными до записи в буфер новых данных.
+ *
+ * Типичный цикл обработки данных выглядит следующим образом:
+ *
+ * |[<!-- language="C" -->
+ * while (TRUE)
+ *   {
+ *     if (hyscan_nmea_parser_pull (&parser, &block))
+ *       {
+ *         process_block (&block);
+ *         hyscan_nmea_parser_next (&parser, NULL);
+ *         continue;
+ *       }
+ *
+ *     if (size == 0)
+ *       break;
+ *
+ *     n_chars = hyscan_nmea_parser_push (&parser, time, 0, data, size);
+ *     data += n_chars;
+ *     size -= n_chars;
+ *   }
+ * ]|
+ *
+ * Функция #hyscan_nmea_parser_flush позволяет забрать текущий блок, не
+ * дожидаясь строк следующей эпохи. Если блок обработан, необходимо также
+ * вызвать #hyscan_nmea_parser_next, иначе блок продолжит собираться.
+ * Если блок забирается по отсутствию новых данных, момент отправки
+ * следует согласовать с #hyscan_nmea_parser_get_flush_time.
+ *
+ * Ненужные NMEA строки можно отбросить сразу после их выделения из потока
+ * и проверки контрольной суммы, до копирования в блок. Для этого список
+ * шаблонов типов строк преобразуется в фильтр функцией
+ * #hyscan_nmea_parser_filter_compile, который устанавливается функцией
+ * #hyscan_nmea_parser_set_filter. Шаблон сравнивается с первыми пятью
+ * символами после '$' - идентификатором источника и типом строки,
+ * например "GPGSV". Символ '?' в шаблоне соответствует любому символу,
+ * а символ '*' в конце шаблона - любым оставшимся символам. Шаблон из трёх
+ * символов задаёт тип строки от любого источника: "GSV" равнозначен
+ * "??GSV". Строки производителей оборудования задаются целиком, например
+ * "PGRMZ" или "P*".
+ *
+ * Частые NMEA строки, например от датчиков ориентации, можно проредить.
+ * Правила прореживания #HyScanNmeaParserRate задают для шаблона типа строк
+ * пропуск каждой N-й строки и (или) максимальную частоту строк. Правила
+ * преобразуются функцией #hyscan_nmea_parser_decimation_compile и
+ * устанавливаются функцией #hyscan_nmea_parser_set_decimation. Строка
+ * проверяется первым подходящим правилом, поэтому правило без ограничений
+ * позволяет исключить строки из следующих, более общих правил. Прореживание
+ * выполняется до группировки строк в блоки.
+ *
+ * Строки, которые нужны пользователю без задержки, например курс и
+ * ориентация (HDT, THS, PASHR), можно объявить срочными с помощью функции
+ * #hyscan_nmea_parser_set_urgent. Срочная строка не участвует в группировке
+ * по эпохам: сразу после приёма она возвращается отдельным блоком из одной
+ * строки с признаком urgent, а собираемый блок при этом не изменяется.
+ */
+
+#include "hyscan-nmea-parser.h"
+#include "hyscan-nmea-sentence.h"
+
+#include <string.h>
+
+#define MIN_STRING_SIZE 10
+#define EPOCH_LEARN 3
+#define ADDRESS_SIZE 5
+
+/* Состояние разборщика. */
+typedef enum
+{
+  HYSCAN_NMEA_PARSER_STATE_COLLECT,                    /* Сбор блока. */
+  HYSCAN_NMEA_PARSER_STATE_APPEND,                     /* Собранная строка добавляется в новый блок. */
+  HYSCAN_NMEA_PARSER_STATE_SEND,                       /* Блок готов, собранная строка - в следующем блоке. */
+  HYSCAN_NMEA_PARSER_STATE_CLOSE,                      /* Блок готов. */
+  HYSCAN_NMEA_PARSER_STATE_URGENT                      /* Срочная строка готова, блок собирается дальше. */
+} HyScanNmeaParserState;
+
+/* Функция учитывает время приёма символов data[from] - data[to - 1].
+ * Время начала строки определяется по последнему символу '$' участка,
+ * время начала блока - по первому символу, принятому после отправки
+ * предыдущего блока. */
+static void
+hyscan_nmea_parser_mark (HyScanNmeaParser *parser,
+                         const gchar      *data,
+                         guint32           from,
+                         guint32           to,
+                         gint64            time,
+                         gint64            char_time,
+                         guint32           size)
+{
+  const gchar *start;
+
+  /* Фиксируем время начала приёма блока. */
+  for (; (from < to) && (parser->message_time == 0); from++)
+    {
+      if (data[from] == '$')
+        parser->rx_time = time - (size - 1 - from) * char_time;
+
+      parser->message_time = parser->rx_time;
+    }
+
+  /* Время приёма начала строки. */
+  while ((from < to) && ((start = memchr (data + from, '$', to - from)) != NULL))
+    {
+      from = start - data;
+      parser->rx_time = time - (size - 1 - from) * char_time;
+      from += 1;
+    }
+}
+
+/* Функция упаковывает первые пять символов после '$' в целое число. */
+static inline guint64
+hyscan_nmea_parser_address (const gchar *string)
+{
+  return  (guint64)(guchar)string[1]        | ((guint64)(guchar)string[2] << 8) |
+         ((guint64)(guchar)string[3] << 16) | ((guint64)(guchar)string[4] << 24) |
+         ((guint64)(guchar)string[5] << 32);
+}
+
+/* Функция преобразует шаблон типа NMEA строки в символы, с которыми
+ * сравнивается упакованный идентификатор строки, и маску сравниваемых
+ * символов. */
+static gboolean
+hyscan_nmea_parser_pattern (const gchar *pattern,
+                            guint64     *key,
+                            guint64     *mask)
+{
+  gsize length = strlen (pattern);
+  gboolean any_tail = FALSE;
+  guint offset = 0;
+  guint i;
+
+  *key = 0;
+  *mask = 0;
+
+  /* Тип строки от любого источника. */
+  if ((length == 3) && (pattern[2] != '*'))
+    offset = 2;
+
+  for (i = 0; i < length; i++)
+    {
+      guint shift = 8 * (offset + i);
+
+      if (pattern[i] == '*')
+        {
+          if (i + 1 != length)
+            return FALSE;
+
+          any_tail = TRUE;
+          break;
+        }
+
+      if (offset + i >= ADDRESS_SIZE)
+        return FALSE;
+
+      if (pattern[i] == '?')
+        continue;
+
+      if (!g_ascii_isalnum (pattern[i]))
+        return FALSE;
+
+      *key |= (guint64)(guchar)g_ascii_toupper (pattern[i]) << shift;
+      *mask |= (guint64)0xFF << shift;
+    }
+
+  return any_tail || (offset + length == ADDRESS_SIZE);
+}
+
+/* Функция проверяет, проходит ли NMEA строка через фильтр. Строка
+ * должна содержать не менее шести символов. */
+static gboolean
+hyscan_nmea_parser_accept (const HyScanNmeaParserFilter *filter,
+                           const gchar                  *string)
+{
+  guint64 address;
+  guint i;
+
+  if (filter->n_patterns == 0)
+    return TRUE;
+
+  address = hyscan_nmea_parser_address (string);
+  for (i = 0; i < filter->n_patterns; i++)
+    {
+      if ((address & filter->masks[i]) == filter->keys[i])
+        return filter->allow;
+    }
+
+  return !filter->allow;
+}
+
+/* Функция проверяет, проходит ли NMEA строка через правила прореживания.
+ * Строка должна содержать не менее шести символов. */
+static gboolean
+hyscan_nmea_parser_decimate (HyScanNmeaParser *parser,
+                             const gchar      *string)
+{
+  const HyScanNmeaParserDecimation *decimation = &parser->decimation;
+  guint64 address;
+  guint i;
+
+  if (decimation->n_rules == 0)
+    return TRUE;
+
+  address = hyscan_nmea_parser_address (string);
+  for (i = 0; i < decimation->n_rules; i++)
+    {
+      if ((address & decimation->masks[i]) != decimation->keys[i])
+        continue;
+
+      /* Каждая N-я строка, начиная с первой. */
+      if (decimation->every[i] > 1)
+        {
+          guint counter = parser->rate_counters[i];
+
+          parser->rate_counters[i] = (counter + 1 < decimation->every[i]) ? counter + 1 : 0;
+          if (counter != 0)
+            return FALSE;
+        }
+
+      /* Не чаще заданной частоты. Строки пропускаются по сетке с шагом
+       * в период, поэтому дрожание времени приёма не снижает среднюю
+       * частоту. Если строки долго не приходили, сетка сдвигается. */
+      if (decimation->periods[i] > 0)
+        {
+          gint64 period = decimation->periods[i];
+          gint64 next_time = parser->rate_times[i];
+
+          if (parser->rx_time < next_time)
+            return FALSE;
+
+          if (parser->rx_time - next_time < period)
+            parser->rate_times[i] = next_time + period;
+          else
+            parser->rate_times[i] = parser->rx_time + period;
+        }
+
+      return TRUE;
+    }
+
+  return TRUE;
+}
+
+/* Функция отмечает текущий блок как готовый. */
+static void
+hyscan_nmea_parser_ready (HyScanNmeaParser      *parser,
+                          HyScanNmeaParserState  state,
+                          gint64                 time)
+{
+  parser->state = state;
+  parser->block_time = time;
+  parser->block_size = parser->message_size;
+}
+
+/* Функция добавляет собранную строку в блок. Строка уже находится на
+ * своём месте, сразу после блока. */
+static void
+hyscan_nmea_parser_append (HyScanNmeaParser *parser)
+{
+  gboolean close_block = FALSE;
+
+  /* Учитываем строки блока и время их приёма относительно начала блока.
+   * Если строка перенесена из предыдущего блока, время начала блока
+   * ещё не зафиксировано и будет равно времени приёма этой строки. */
+  if (parser->message_size == 0)
+    {
+      parser->untimed_block = (parser->nmea_time == 0);
+      parser->n_lines = 0;
+    }
+
+  if (parser->max_lines > 0)
+    {
+      gint64 offset = (parser->message_time > 0) ? parser->rx_time - parser->message_time : 0;
+
+      parser->times[parser->n_lines] = CLAMP (offset, 0, G_MAXUINT32);
+    }
+  parser->n_lines += 1;
+
+  parser->message_size += parser->string_size;
+  parser->message [parser->message_size++] = '\r';
+  parser->message [parser->message_size++] = '\n';
+  parser->message [parser->message_size] = 0;
+
+  parser->string_size = 0;
+
+  /* Если несколько эпох подряд завершались строкой этого типа с тем же
+   * номером в эпохе, отправляем блок не дожидаясь строк следующей эпохи.
+   * Номер строки различает повторяющиеся строки одного типа, например
+   * части GSV, поэтому блок не закрывается на первой из них. */
+  if ((parser->sentence_key == parser->epoch_key) &&
+      (parser->sentence_index == parser->epoch_size) &&
+      (parser->epoch_hits >= EPOCH_LEARN) &&
+      (parser->nmea_time > 0) &&
+      parser->predict_epoch)
+    {
+      close_block = TRUE;
+    }
+
+  /* В блоке без времени набрано заданное число строк. */
+  if (parser->untimed_block && (parser->untimed_count > 0) && (parser->n_lines >= parser->untimed_count))
+    close_block = TRUE;
+
+  if (close_block)
+    hyscan_nmea_parser_ready (parser, HYSCAN_NMEA_PARSER_STATE_CLOSE, parser->message_time);
+}
+
+/* Функция добавляет в блок строку, перенесённую из предыдущего блока. */
+static void
+hyscan_nmea_parser_complete (HyScanNmeaParser *parser)
+{
+  if (parser->state != HYSCAN_NMEA_PARSER_STATE_APPEND)
+    return;
+
+  parser->state = HYSCAN_NMEA_PARSER_STATE_COLLECT;
+  hyscan_nmea_parser_append (parser);
+}
+
+/* Функция заполняет описание блока. */
+static void
+hyscan_nmea_parser_fill (HyScanNmeaParser      *parser,
+                         HyScanNmeaParserBlock *block,
+                         gint64                 time,
+                         guint32                size)
+{
+  /* Срочная строка расположена сразу после собираемого блока, а время
+   * её приёма - в таблице сразу после времени строк этого блока. */
+  if (parser->state == HYSCAN_NMEA_PARSER_STATE_URGENT)
+    {
+      block->time = time;
+      block->data = parser->message + parser->message_size;
+      block->size = size;
+      block->line_times = (parser->max_lines > 0) ? parser->times + parser->n_lines : NULL;
+      block->n_lines = 1;
+      block->urgent = TRUE;
+
+      return;
+    }
+
+  block->time = time;
+  block->data = parser->message;
+  block->size = size;
+  block->line_times = (parser->max_lines > 0) ? parser->times : NULL;
+  block->n_lines = parser->n_lines;
+  block->urgent = FALSE;
+}
+
+/**
+ * hyscan_nmea_parser_init:
+ * @parser: указатель на #HyScanNmeaParser
+ * @buffer: буфер для сбора блоков
+ * @max_size: максимальный размер блока
+ * @line_times: (nullable): таблица времени приёма строк блока
+ *
+ * Функция инициализирует разборщик NMEA данных. Размер буфера @buffer
+ * должен быть не меньше HYSCAN_NMEA_PARSER_BUFFER_SIZE(@max_size), размер
+ * таблицы @line_times - не меньше HYSCAN_NMEA_PARSER_MAX_LINES(@max_size)
+ * элементов. Если время приёма строк не нужно, @line_times может быть
+ * равен NULL. Разборщик не освобождает переданную ему память.
+ *
+ * По умолчанию битые NMEA строки не пропускаются, досрочная отправка
+ * блоков выключена, а строки без времени не группируются.
+ */
+void
+hyscan_nmea_parser_init (HyScanNmeaParser *parser,
+                         gchar            *buffer,
+                         guint             max_size,
+                         guint32          *line_times)
+{
+  memset (parser, 0, sizeof (HyScanNmeaParser));
+
+  parser->message = buffer;
+  parser->max_size = max_size;
+  parser->times = line_times;
+  parser->max_lines = (line_times != NULL) ? HYSCAN_NMEA_PARSER_MAX_LINES (max_size) : 0;
+}
+
+/**
+ * hyscan_nmea_parser_skip_broken:
+ * @parser: указатель на #HyScanNmeaParser
+ * @skip: признак пропуска некорректных NMEA строк
+ *
+ * Функция задаёт поведение при приёме NMEA строк с неверной контрольной
+ * суммой. Аналогична #hyscan_nmea_receiver_skip_broken.
+ */
+void
+hyscan_nmea_parser_skip_broken (HyScanNmeaParser *parser,
+                                gboolean          skip)
+{
+  parser->skip_broken = skip;
+}
+
+/**
+ * hyscan_nmea_parser_set_predict_epoch:
+ * @parser: указатель на #HyScanNmeaParser
+ * @predict: признак отправки блока по последней строке эпохи
+ *
+ * Функция включает или отключает досрочную отправку блоков данных.
+ * Аналогична #hyscan_nmea_receiver_set_predict_epoch.
+ */
+void
+hyscan_nmea_parser_set_predict_epoch (HyScanNmeaParser *parser,
+                                      gboolean          predict)
+{
+  parser->predict_epoch = predict;
+}
+
+/**
+ * hyscan_nmea_parser_group_untimed:
+ * @parser: указатель на #HyScanNmeaParser
+ * @window: интервал группировки строк, мкс
+ * @n_sentences: максимальное число строк в блоке
+ *
+ * Функция задаёт группировку NMEA строк, из которых невозможно определить
+ * время. Аналогична #hyscan_nmea_receiver_group_untimed, но интервал
+ * задаётся в микросекундах.
+ */
+void
+hyscan_nmea_parser_group_untimed (HyScanNmeaParser *parser,
+                                  gint64            window,
+                                  guint             n_sentences)
+{
+  parser->untimed_window = MAX (window, 0);
+  parser->untimed_count = n_sentences;
+}
+
+/**
+ * hyscan_nmea_parser_filter_compile:
+ * @filter: (out): фильтр NMEA строк
+ * @patterns: (nullable) (array zero-terminated=1): шаблоны типов NMEA строк
+ * @allow: %TRUE - список разрешённых строк, %FALSE - запрещённых
+ *
+ * Функция преобразует список шаблонов типов NMEA строк в фильтр. Если
+ * @allow равен %TRUE, через фильтр проходят только строки, совпадающие
+ * с одним из шаблонов, иначе - только строки, не совпадающие ни с одним
+ * из них. Пустые шаблоны пропускаются. Фильтр без шаблонов пропускает
+ * все строки. Шаблоны не зависят от регистра символов.
+ *
+ * Returns: %TRUE если все шаблоны корректны и их не больше
+ * %HYSCAN_NMEA_PARSER_MAX_PATTERNS, иначе %FALSE. В случае ошибки
+ * фильтр пропускает все строки.
+ */
+gboolean
+hyscan_nmea_parser_filter_compile (HyScanNmeaParserFilter *filter,
+                                   const gchar * const    *patterns,
+                                   gboolean                allow)
+{
+  guint i;
+
+  memset (filter, 0, sizeof (HyScanNmeaParserFilter));
+  filter->allow = allow;
+
+  for (i = 0; (patterns != NULL) && (patterns[i] != NULL); i++)
+    {
+      guint n = filter->n_patterns;
+
+      if (patterns[i][0] == 0)
+        continue;
+
+      if ((n == HYSCAN_NMEA_PARSER_MAX_PATTERNS) ||
+          !hyscan_nmea_parser_pattern (patterns[i], &filter->keys[n], &filter->masks[n]))
+        {
+          filter->n_patterns = 0;
+          return FALSE;
+        }
+
+      filter->n_patterns += 1;
+    }
+
+  return TRUE;
+}
+
+/**
+ * hyscan_nmea_parser_set_filter:
+ * @parser: указатель на #HyScanNmeaParser
+ * @filter: (nullable): фильтр NMEA строк
+ *
+ * Функция устанавливает фильтр NMEA строк. Строки, не прошедшие через
+ * фильтр, отбрасываются сразу после выделения из потока данных, но
+ * учитываются в числе принятых строк. Фильтр копируется в разборщик.
+ * Если @filter равен NULL, фильтрация отключается.
+ */
+void
+hyscan_nmea_parser_set_filter (HyScanNmeaParser             *parser,
+                               const HyScanNmeaParserFilter *filter)
+{
+  if (filter != NULL)
+    parser->filter = *filter;
+  else
+    memset (&parser->filter, 0, sizeof (HyScanNmeaParserFilter));
+}
+
+/**
+ * hyscan_nmea_parser_set_urgent:
+ * @parser: указатель на #HyScanNmeaParser
+ * @urgent: (nullable): шаблоны срочных NMEA строк
+ *
+ * Функция задаёт типы срочных NMEA строк. Шаблоны преобразуются функцией
+ * #hyscan_nmea_parser_filter_compile. Срочные строки, прошедшие фильтр и
+ * прореживание, сразу возвращаются отдельными блоками с признаком urgent
+ * и временем приёма строки. Такие строки не участвуют в определении эпох
+ * и не попадают в собираемый блок. Если @urgent равен NULL или не содержит
+ * шаблонов, срочных строк нет.
+ */
+void
+hyscan_nmea_parser_set_urgent (HyScanNmeaParser             *parser,
+                               const HyScanNmeaParserFilter *urgent)
+{
+  if (urgent != NULL)
+    parser->urgent = *urgent;
+  else
+    memset (&parser->urgent, 0, sizeof (HyScanNmeaParserFilter));
+}
+
+/**
+ * hyscan_nmea_parser_decimation_compile:
+ * @decimation: (out): правила прореживания NMEA строк
+ * @rates: (array length=n_rates) (nullable): описания правил
+ * @n_rates: число правил
+ *
+ * Функция преобразует описания правил прореживания NMEA строк. Строка,
+ * подходящая под шаблон правила, пропускается, если она является каждой
+ * @every-й строкой этого типа и с момента предыдущей пропущенной строки
+ * прошло не менее 1 / @max_rate секунд. Пропускается самая свежая строка,
+ * принятая к этому моменту, строки не задерживаются. Время определяется
+ * по времени приёма символа '$'.
+ *
+ * Returns: %TRUE если все правила корректны и их не больше
+ * %HYSCAN_NMEA_PARSER_MAX_RATES, иначе %FALSE. В случае ошибки правила
+ * не ограничивают строки.
+ */
+gboolean
+hyscan_nmea_parser_decimation_compile (HyScanNmeaParserDecimation *decimation,
+                                       const HyScanNmeaParserRate *rates,
+                                       guint                       n_rates)
+{
+  guint i;
+
+  memset (decimation, 0, sizeof (HyScanNmeaParserDecimation));
+
+  if (n_rates > HYSCAN_NMEA_PARSER_MAX_RATES)
+    return FALSE;
+
+  for (i = 0; i < n_rates; i++)
+    {
+      if ((rates[i].pattern == NULL) || !(rates[i].max_rate >= 0.0) ||
+          !hyscan_nmea_parser_pattern (rates[i].pattern, &decimation->keys[i], &decimation->masks[i]))
+        {
+          memset (decimation, 0, sizeof (HyScanNmeaParserDecimation));
+          return FALSE;
+        }
+
+      decimation->every[i] = rates[i].every;
+      if (rates[i].max_rate > 0.0)
+        decimation->periods[i] = MAX (G_USEC_PER_SEC / rates[i].max_rate, 1);
+    }
+
+  decimation->n_rules = n_rates;
+
+  return TRUE;
+}
+
+/**
+ * hyscan_nmea_parser_set_decimation:
+ * @parser: указатель на #HyScanNmeaParser
+ * @decimation: (nullable): правила прореживания NMEA строк
+ *
+ * Функция устанавливает правила прореживания NMEA строк. Строки,
+ * отброшенные при прореживании, учитываются в числе принятых строк, но
+ * не попадают в блоки и не влияют на определение эпох. Правила
+ * копируются в разборщик, счётчики строк сбрасываются. Если @decimation
+ * равен NULL, прореживание отключается.
+ */
+void
+hyscan_nmea_parser_set_decimation (HyScanNmeaParser                 *parser,
+                                   const HyScanNmeaParserDecimation *decimation)
+{
+  if (decimation != NULL)
+    parser->decimation = *decimation;
+  else
+    memset (&parser->decimation, 0, sizeof (HyScanNmeaParserDecimation));
+
+  memset (parser->rate_counters, 0, sizeof (parser->rate_counters));
+  memset (parser->rate_times, 0, sizeof (parser->rate_times));
+}
+
+/**
+ * hyscan_nmea_parser_push:
+ * @parser: указатель на #HyScanNmeaParser
+ * @time: метка времени приёма последнего символа, мкс
+ * @char_time: время передачи одного символа, мкс
+ * @data: принятые данные
+ * @size: размер данных
+ *
+ * Функция обрабатывает блок последовательно принятых символов. Время
+ * приёма каждого символа определяется как @time - (@size - 1 - i) * @char_time,
+ * где i - индекс символа в блоке. Обработка прекращается, как только
+ * будет готов очередной блок NMEA данных. Оставшиеся данные необходимо
+ * передать повторно, после вызова #hyscan_nmea_parser_next, с тем же
+ * значением @time. Пока готовый блок не обработан, функция не
+ * обрабатывает данные.
+ *
+ * Returns: число обработанных символов.
+ */
+guint32
+hyscan_nmea_parser_push (HyScanNmeaParser *parser,
+                         gint64            time,
+                         gint64            char_time,
+                         const gchar      *data,
+                         guint32           size)
+{
+  guint32 rxi;
+
+  hyscan_nmea_parser_complete (parser);
+  if (parser->state != HYSCAN_NMEA_PARSER_STATE_COLLECT)
+    return 0;
+
+  /* Обрабатываем данные участками между символами '$' и '\r'. */
+  rxi = 0;
+  while (rxi < size)
+    {
+      gchar *string = parser->message + parser->message_size;
+      const gchar *cr;
+      guint32 n_chars;
+      guint32 n_free;
+
+      /* Текущая обрабатываемая строка пустая, пропускаем данные до её начала. */
+      if (parser->string_size == 0)
+        {
+          const gchar *start = memchr (data + rxi, '$', size - rxi);
+          guint32 end = (start != NULL) ? (guint32)(start - data) : size;
+
+          hyscan_nmea_parser_mark (parser, data, rxi, end, time, char_time, size);
+          rxi = end;
+
+          if (start == NULL)
+            break;
+        }
+
+      /* Собираем строку до тех пор пока не встретится символ '\r'. */
+      cr = memchr (data + rxi, '\r', size - rxi);
+      n_chars = ((cr != NULL) ? (guint32)(cr - data) : size) - rxi;
+      n_free = HYSCAN_NMEA_PARSER_MAX_STRING + 1 - parser->string_size;
+
+      /* Если строка слишком длинная, пропускаем её. Символ,
+       * не поместившийся в строку, отбрасывается. */
+      if (n_chars > n_free)
+        {
+          hyscan_nmea_parser_mark (parser, data, rxi, rxi + n_free + 1, time, char_time, size);
+          rxi += n_free + 1;
+          parser->string_size = 0;
+          continue;
+        }
+
+      /* Сохраняем принятые символы. */
+      hyscan_nmea_parser_mark (parser, data, rxi, rxi + n_chars, time, char_time, size);
+      memcpy (string + parser->string_size, data + rxi, n_chars);
+      parser->string_size += n_chars;
+      string [parser->string_size] = 0;
+      rxi += n_chars;
+
+      if (cr == NULL)
+        break;
+
+      hyscan_nmea_parser_mark (parser, data, rxi, rxi + 1, time, char_time, size);
+      rxi += 1;
+
+      /* Строка собрана. */
+      {
+        gboolean send_block = FALSE;
+        gboolean bad_crc;
+        guint32 sentence_key;
+        gint nmea_time = -1;
+
+        /* NMEA строка не может быть короче 10 символов. */
+        if (parser->string_size < MIN_STRING_SIZE)
+          {
+            parser->string_size = 0;
+            continue;
+          }
+
+        /* Проверяем контрольную сумму NMEA строки. Если контрольная
+         * сумма не совпадает, не используем время из это строки. */
+        string[parser->string_size] = 0;
+        bad_crc = !hyscan_nmea_sentence_check (string, parser->string_size);
+
+        /* Пропускаем "плохие" NMEA строки. */
+        if (parser->skip_broken && bad_crc)
+          {
+            parser->string_size = 0;
+            continue;
+          }
+
+        /* Число корректных NMEA строк. Строки учитываются до фильтрации,
+         * чтобы по ним можно было судить о приёме данных, даже если все
+         * они отбрасываются. */
+        parser->n_sentences += 1;
+
+        /* Отбрасываем строки, не прошедшие через фильтр, и прореживаем
+         * частые NMEA строки. */
+        if (!hyscan_nmea_parser_accept (&parser->filter, string) ||
+            !hyscan_nmea_parser_decimate (parser, string))
+          {
+            parser->string_size = 0;
+            continue;
+          }
+
+        /* Срочная строка отправляется сразу, минуя группировку по эпохам.
+         * В буфере после строки всегда есть место для символов "\r\n". */
+        if ((parser->urgent.n_patterns > 0) && hyscan_nmea_parser_accept (&parser->urgent, string))
+          {
+            string[parser->string_size++] = '\r';
+            string[parser->string_size++] = '\n';
+
+            parser->state = HYSCAN_NMEA_PARSER_STATE_URGENT;
+            parser->block_time = parser->rx_time;
+            parser->block_size = parser->string_size;
+
+            /* Время приёма строки относительно срочного блока записывается
+             * в таблицу после строк собираемого блока. Меткой времени блока
+             * является время приёма символа '$' этой строки, поэтому смещение
+             * нулевое. Место в таблице есть, так как собираемый блок не может
+             * быть полностью заполнен строками минимального размера. */
+            if (parser->max_lines > 0)
+              parser->times[parser->n_lines] = 0;
+
+            return rxi;
+          }
+
+        /* Тип NMEA строки. */
+        sentence_key = hyscan_nmea_sentence_get_formatter (string);
+
+        /* Вытаскиваем время из NMEA строк, тип строки определяется по таблице. */
+        if (!bad_crc)
+          nmea_time = hyscan_nmea_sentence_get_time (string);
+
+        /* Если текущее время и время блока различаются, отправляем блок данных. */
+        if (nmea_time >= 0)
+          {
+            if ((parser->nmea_time > 0) && (parser->nmea_time != nmea_time))
+              {
+                send_block = TRUE;
+
+                /* Запоминаем тип строки, завершившей предыдущую эпоху,
+                 * и число строк в ней. */
+                if ((parser->sentence_key != parser->epoch_key) ||
+                    (parser->sentence_index != parser->epoch_size))
+                  {
+                    parser->epoch_key = parser->sentence_key;
+                    parser->epoch_size = parser->sentence_index;
+                    parser->epoch_hits = 1;
+                  }
+                else if (parser->epoch_hits < EPOCH_LEARN)
+                  {
+                    parser->epoch_hits += 1;
+                  }
+
+                parser->sentence_index = 0;
+              }
+
+            parser->nmea_time = nmea_time;
+          }
+
+        parser->sentence_key = sentence_key;
+        parser->sentence_index += 1;
+
+        /* Если в блоке больше нет места, отправляем блок. */
+        if ((parser->message_size + parser->string_size + 3) > parser->max_size)
+          send_block = TRUE;
+
+        /* Строки без времени объединяются в блоки по времени приёма
+         * или по числу строк. Блок из строк со временем отправляется. */
+        if ((parser->nmea_time == 0) && (parser->untimed_window > 0 || parser->untimed_count > 1))
+          {
+            if ((parser->message_size > 0) && !parser->untimed_block)
+              send_block = TRUE;
+
+            if ((parser->message_size > 0) && (parser->untimed_window > 0) &&
+                (parser->rx_time - parser->message_time >= parser->untimed_window))
+              {
+                send_block = TRUE;
+              }
+          }
+
+        /* Если нет возможности определить время из строки,
+         * отправляем строку без объединения в блок. */
+        else if (parser->nmea_time == 0)
+          {
+            /* Собранный блок отбрасывается. */
+            if (parser->message_size > 0)
+              {
+                memmove (parser->message, string, parser->string_size);
+                parser->message_size = 0;
+              }
+
+            parser->message_size = parser->string_size;
+            parser->message[parser->message_size++] = '\r';
+            parser->message[parser->message_size++] = '\n';
+            parser->string_size = 0;
+
+            if (parser->max_lines > 0)
+              parser->times[0] = 0;
+            parser->n_lines = 1;
+            parser->sentence_key = 0;
+
+            hyscan_nmea_parser_ready (parser, HYSCAN_NMEA_PARSER_STATE_CLOSE, parser->rx_time);
+
+            return rxi;
+          }
+
+        /* Отправляем блок данных. Текущая строка переносится в следующий блок. */
+        if (send_block && (parser->message_size > 0))
+          {
+            hyscan_nmea_parser_ready (parser, HYSCAN_NMEA_PARSER_STATE_SEND, parser->message_time);
+
+            return rxi;
+          }
+
+        /* Сохраняем строку в блоке. */
+        hyscan_nmea_parser_append (parser);
+
+        if (parser->state != HYSCAN_NMEA_PARSER_STATE_COLLECT)
+          return rxi;
+      }
+    }
+
+  return size;
+}
+
+/**
+ * hyscan_nmea_parser_pull:
+ * @parser: указатель на #HyScanNmeaParser
+ * @block: (out): готовый блок NMEA данных
+ *
+ * Функция возвращает готовый блок NMEA данных. После обработки блока
+ * необходимо вызвать функцию #hyscan_nmea_parser_next. До этого функция
+ * возвращает один и тот же блок.
+ *
+ * Returns: %TRUE если блок готов, иначе %FALSE.
+ */
+gboolean
+hyscan_nmea_parser_pull (HyScanNmeaParser      *parser,
+                         HyScanNmeaParserBlock *block)
+{
+  hyscan_nmea_parser_complete (parser);
+
+  if ((parser->state != HYSCAN_NMEA_PARSER_STATE_SEND) &&
+      (parser->state != HYSCAN_NMEA_PARSER_STATE_CLOSE) &&
+      (parser->state != HYSCAN_NMEA_PARSER_STATE_URGENT))
+    {
+      return FALSE;
+    }
+
+  hyscan_nmea_parser_fill (parser, block, parser->block_time, parser->block_size);
+
+  return TRUE;
+}
+
+/**
+ * hyscan_nmea_parser_flush:
+ * @parser: указатель на #HyScanNmeaParser
+ * @block: (out): текущий блок NMEA данных
+ *
+ * Функция возвращает готовый блок NMEA данных или, если его нет, текущий
+ * собираемый блок. Собираемый блок считается отправленным только после
+ * вызова #hyscan_nmea_parser_next. Если эта функция не вызвана, в блок
+ * продолжают добавляться новые строки.
+ *
+ * Returns: %TRUE если блок не пустой, иначе %FALSE.
+ */
+gboolean
+hyscan_nmea_parser_flush (HyScanNmeaParser      *parser,
+                          HyScanNmeaParserBlock *block)
+{
+  if (hyscan_nmea_parser_pull (parser, block))
+    return TRUE;
+
+  if (parser->message_size == 0)
+    return FALSE;
+
+  hyscan_nmea_parser_fill (parser, block, parser->message_time, parser->message_size);
+
+  return TRUE;
+}
+
+/**
+ * hyscan_nmea_parser_get_flush_time:
+ * @parser: указатель на #HyScanNmeaParser
+ *
+ * Функция возвращает время, начиная с которого текущий блок можно забрать
+ * функцией #hyscan_nmea_parser_flush при отсутствии новых данных, не
+ * нарушая группировку строк без времени. Блок из строк без времени,
+ * собираемый по интервалу группировки, можно забрать по окончании этого
+ * интервала. Блок, собираемый только по числу строк, отправляется после
+ * приёма всех его строк и не забирается по отсутствию данных.
+ *
+ * Returns: Время в единицах меток времени строк, 0 - если блок можно
+ * забрать сразу, -1 - если блок пустой или его не нужно забирать.
+ */
+gint64
+hyscan_nmea_parser_get_flush_time (HyScanNmeaParser *parser)
+{
+  hyscan_nmea_parser_complete (parser);
+
+  if (parser->state != HYSCAN_NMEA_PARSER_STATE_COLLECT)
+    return 0;
+
+  if (parser->message_size == 0)
+    return -1;
+
+  if (!parser->untimed_block || ((parser->untimed_window == 0) && (parser->untimed_count <= 1)))
+    return 0;
+
+  if (parser->untimed_window > 0)
+    return parser->message_time + parser->untimed_window;
+
+  return -1;
+}
+
+/**
+ * hyscan_nmea_parser_next:
+ * @parser: указатель на #HyScanNmeaParser
+ * @buffer: (nullable): буфер для следующего блока
+ *
+ * Функция завершает блок, полученный функциями #hyscan_nmea_parser_pull
+ * или #hyscan_nmea_parser_flush, и начинает сбор следующего блока в буфере
+ * @buffer. Начатая NMEA строка переносится в новый буфер. Если @buffer
+ * равен NULL, используется текущий буфер. Размер нового буфера должен быть
+ * не меньше размера, указанного при инициализации. Буфер может
+ * располагаться в памяти сразу после данных завершённого блока.
+ *
+ * Таблица времени приёма строк завершённого блока остаётся неизменной
+ * до следующего вызова функций разборщика.
+ *
+ * Если завершается срочный блок, @buffer не используется: собираемый
+ * блок остаётся на своём месте.
+ */
+void
+hyscan_nmea_parser_next (HyScanNmeaParser *parser,
+                         gchar            *buffer)
+{
+  gboolean append = (parser->state == HYSCAN_NMEA_PARSER_STATE_SEND);
+
+  /* Срочная строка отправлена, продолжаем собирать текущий блок. Если
+   * блок пустой, его время определится по следующей строке. */
+  if (parser->state == HYSCAN_NMEA_PARSER_STATE_URGENT)
+    {
+      parser->string_size = 0;
+      if (parser->message_size == 0)
+        parser->message_time = 0;
+
+      parser->state = HYSCAN_NMEA_PARSER_STATE_COLLECT;
+
+      return;
+    }
+
+  if (buffer == NULL)
+    buffer = parser->message;
+
+  if (parser->string_size > 0)
+    memmove (buffer, parser->message + parser->message_size, parser->string_size);
+
+  parser->message = buffer;
+  parser->message_time = 0;
+  parser->message_size = 0;
+
+  parser->state = append ? HYSCAN_NMEA_PARSER_STATE_APPEND : HYSCAN_NMEA_PARSER_STATE_COLLECT;
+}
+
+/**
+ * hyscan_nmea_parser_reset:
+ * @parser: указатель на #HyScanNmeaParser
+ *
+ * Функция отбрасывает собираемый блок и начатую NMEA строку. Её можно
+ * использовать, например, если данные долго не поступали.
+ */
+void
+hyscan_nmea_parser_reset (HyScanNmeaParser *parser)
+{
+  parser->message_time = 0;
+  parser->message_size = 0;
+  parser->string_size = 0;
+  parser->state = HYSCAN_NMEA_PARSER_STATE_COLLECT;
+}
+
+/**
+ * hyscan_nmea_parser_get_n_sentences:
+ * @parser: указатель на #HyScanNmeaParser
+ *
+ * Функция возвращает число принятых NMEA строк. Строки с неверной
+ * контрольной суммой учитываются, только если они не пропускаются.
+ * Строки, отброшенные фильтром или прореживанием, учитываются, поэтому
+ * по числу строк можно судить о приёме данных.
+ *
+ * Returns: Число принятых NMEA строк.
+ */
+guint
+hyscan_nmea_parser_get_n_sentences (HyScanNmeaParser *parser)
+{
+  return parser->n_sentences;
+}
@@ -0,0 +1,246 @@
+/* hyscan-nmea-parser.h
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+#ifndef __HYSCAN_NMEA_PARSER_H__
+#define __HYSCAN_NMEA_PARSER_H__
+
+#include <hyscan-types.h>
+
+G_BEGIN_DECLS
+
+/* Максимальный размер NMEA строки без символов "\r\n". */
+#define HYSCAN_NMEA_PARSER_MAX_STRING      253
+
+/* Размер буфера для блоков размером не более max_size. */
+#define HYSCAN_NMEA_PARSER_BUFFER_SIZE(max_size) ((max_size) + HYSCAN_NMEA_PARSER_MAX_STRING + 3)
+
+/* Максимальное число строк в блоке размером не более max_size. */
+#define HYSCAN_NMEA_PARSER_MAX_LINES(max_size)   ((max_size) / 12 + 1)
+
+/* Максимальное число шаблонов в фильтре NMEA строк. */
+#define HYSCAN_NMEA_PARSER_MAX_PATTERNS    16
+
+/* Максимальное число правил прореживания NMEA строк. */
+#define HYSCAN_NMEA_PARSER_MAX_RATES       8
+
+/**
+ * HyScanNmeaParserBlock:
+ * @time: метка времени приёма блока, мкс
+ * @data: NMEA данные
+ * @size: размер NMEA данных без нулевого символа
+ * @line_times: (nullable): время приёма каждой NMEA строки относительно @time, мкс
+ * @n_lines: число NMEA строк в блоке
+ * @urgent: признак срочной NMEA строки
+ *
+ * Блок NMEA данных. Данные блока не завершаются нулевым символом.
+ */
+typedef struct
+{
+  gint64                       time;
+  const gchar                 *data;
+  guint32                      size;
+  const guint32               *line_times;
+  guint                        n_lines;
+  gboolean                     urgent;
+} HyScanNmeaParserBlock;
+
+/**
+ * HyScanNmeaParserFilter:
+ *
+ * Фильтр NMEA строк по типу, подготовленный функцией
+ * #hyscan_nmea_parser_filter_compile. Структура может копироваться,
+ * её поля не предназначены для использования напрямую.
+ */
+typedef struct
+{
+  /*< private >*/
+  guint64                      keys[HYSCAN_NMEA_PARSER_MAX_PATTERNS];  /* Символы шаблонов. */
+  guint64                      masks[HYSCAN_NMEA_PARSER_MAX_PATTERNS]; /* Маски сравниваемых символов. */
+  guint                        n_patterns;                             /* Число шаблонов. */
+  gboolean                     allow;                                  /* Признак списка разрешённых строк. */
+} HyScanNmeaParserFilter;
+
+/**
+ * HyScanNmeaParserRate:
+ * @pattern: шаблон типа NMEA строк
+ * @every: пропускать каждую @every-ю строку, 0 или 1 - все строки
+ * @max_rate: максимальная частота строк, Гц, 0 - без ограничения
+ *
+ * Правило прореживания NMEA строк. Формат шаблона аналогичен шаблонам
+ * #hyscan_nmea_parser_filter_compile.
+ */
+typedef struct
+{
+  const gchar                 *pattern;
+  guint                        every;
+  gdouble                      max_rate;
+} HyScanNmeaParserRate;
+
+/**
+ * HyScanNmeaParserDecimation:
+ *
+ * Правила прореживания NMEA строк, подготовленные функцией
+ * #hyscan_nmea_parser_decimation_compile. Структура может копироваться,
+ * её поля не предназначены для использования напрямую.
+ */
+typedef struct
+{
+  /*< private >*/
+  guint64                      keys[HYSCAN_NMEA_PARSER_MAX_RATES];     /* Символы шаблонов. */
+  guint64                      masks[HYSCAN_NMEA_PARSER_MAX_RATES];    /* Маски сравниваемых символов. */
+  guint                        every[HYSCAN_NMEA_PARSER_MAX_RATES];    /* Пропускается каждая every-я строка. */
+  gint64                       periods[HYSCAN_NMEA_PARSER_MAX_RATES];  /* Минимальный период строк, мкс. */
+  guint                        n_rules;                                /* Число правил. */
+} HyScanNmeaParserDecimation;
+
+/**
+ * HyScanNmeaParser:
+ *
+ * Состояние разборщика NMEA данных. Структура может размещаться на стеке
+ * или внутри других структур, её поля не предназначены для использования
+ * напрямую.
+ */
+typedef struct
+{
+  /*< private >*/
+  gchar                       *message;        /* Собираемый блок. */
+  guint32                      message_size;   /* Размер блока. */
+  guint                        string_size;    /* Размер NMEA строки, собираемой после блока. */
+  guint                        max_size;       /* Максимальный размер блока. */
+
+  guint32                     *times;          /* Время приёма строк блока. */
+  guint                        max_lines;      /* Максимальное число строк в таблице. */
+  guint                        n_lines;        /* Число строк в блоке. */
+
+  gint64                       rx_time;        /* Метка времени приёма начала строки. */
+  gint64                       message_time;   /* Метка времени блока. */
+  gint                         nmea_time;      /* NMEA время блока. */
+
+  gboolean                     skip_broken;    /* Признак пропуска битых NMEA строк. */
+  gboolean                     predict_epoch;  /* Признак отправки блока по последней строке эпохи. */
+  guint32                      sentence_key;   /* Тип последней NMEA строки в блоке. */
+  guint                        sentence_index; /* Номер последней NMEA строки в эпохе. */
+  guint32                      epoch_key;      /* Тип NMEA строки, завершающей эпоху. */
+  guint                        epoch_size;     /* Число NMEA строк в эпохе. */
+  guint                        epoch_hits;     /* Число эпох подряд с такими же epoch_key и epoch_size. */
+
+  gint64                       untimed_window; /* Интервал группировки строк без времени, мкс. */
+  guint                        untimed_count;  /* Максимальное число строк без времени в блоке. */
+  gboolean                     untimed_block;  /* Признак блока из строк без времени. */
+
+  HyScanNmeaParserFilter       filter;         /* Фильтр NMEA строк. */
+  HyScanNmeaParserDecimation   decimation;     /* Правила прореживания NMEA строк. */
+  guint                        rate_counters[HYSCAN_NMEA_PARSER_MAX_RATES]; /* Счётчики строк правил. */
+  gint64                       rate_times[HYSCAN_NMEA_PARSER_MAX_RATES];    /* Время следующей строки правил. */
+  HyScanNmeaParserFilter       urgent;         /* Шаблоны срочных NMEA строк. */
+
+  gint                         state;          /* Состояние готового блока. */
+  gint64                       block_time;     /* Метка времени готового блока. */
+  guint32                      block_size;     /* Размер готового блока. */
+
+  guint                        n_sentences;    /* Число принятых NMEA строк. */
+} HyScanNmeaParser;
+
+HYSCAN_API
+void                   hyscan_nmea_parser_init                 (HyScanNmeaParser      *parser,
+                                                                gchar                 *buffer,
+                                                                guint                  max_size,
+                                                                guint32               *line_times);
+
+HYSCAN_API
+void                   hyscan_nmea_parser_skip_broken          (HyScanNmeaParser      *parser,
+                                                                gboolean               skip);
+
+HYSCAN_API
+void                   hyscan_nmea_parser_set_predict_epoch    (HyScanNmeaParser      *parser,
+                                                                gboolean               predict);
+
+HYSCAN_API
+void                   hyscan_nmea_parser_group_untimed        (HyScanNmeaParser      *parser,
+                                                                gint64                 window,
+                                                                guint                  n_sentences);
+
+HYSCAN_API
+gboolean               hyscan_nmea_parser_filter_compile       (HyScanNmeaParserFilter *filter,
+                                                                const gchar * const   *patterns,
+                                                                gboolean               allow);
+
+HYSCAN_API
+void                   hyscan_nmea_parser_set_filter           (HyScanNmeaParser      *parser,
+                                                                const HyScanNmeaParserFilter *filter);
+
+HYSCAN_API
+void                   hyscan_nmea_parser_set_urgent           (HyScanNmeaParser      *parser,
+                                                                const HyScanNmeaParserFilter *urgent);
+
+HYSCAN_API
+gboolean               hyscan_nmea_parser_decimation_compile   (HyScanNmeaParserDecimation *decimation,
+                                                                const HyScanNmeaParserRate *rates,
+                                                                guint                  n_rates);
+
+HYSCAN_API
+void                   hyscan_nmea_parser_set_decimation       (HyScanNmeaParser      *parser,
+                                                                const HyScanNmeaParserDecimation *decimation);
+
+HYSCAN_API
+guint32                hyscan_nmea_parser_push                 (HyScanNmeaParser      *parser,
+                                                                gint64                 time,
+                                                                gint64                 char_time,
+                                                                const gchar           *data,
+                                                                guint32                size);
+
+HYSCAN_API
+gboolean               hyscan_nmea_parser_pull                 (HyScanNmeaParser      *parser,
+                                                                HyScanNmeaParserBlock *block);
+
+HYSCAN_API
+gboolean               hyscan_nmea_parser_flush                (HyScanNmeaParser      *parser,
+                                                                HyScanNmeaParserBlock *block);
+
+HYSCAN_API
+gint64                 hyscan_nmea_parser_get_flush_time       (HyScanNmeaParser      *parser);
+
+HYSCAN_API
+void                   hyscan_nmea_parser_next                 (HyScanNmeaParser      *parser,
+                                                                gchar                 *buffer);
+
+HYSCAN_API
+void                   hyscan_nmea_parser_reset                (HyScanNmeaParser      *parser);
+
+HYSCAN_API
+guint                  hyscan_nmea_parser_get_n_sentences      (HyScanNmeaParser      *parser);
+
+G_END_DECLS
+
+#endif /* __HYSCAN_NMEA_PARSER_H__ */
@@ -0,0 +1,433 @@
+/* hyscan-nmea-reactor.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/**
+ * SECTION: hyscan-nmea-reactor
+ * @Short_description: общий цикл обработки событий ввода/вывода
+ * @Title: HyScanNmeaReactor
+ *
+ * Класс реализует общий для всех транспортов цикл обработки событий
+ * ввода/вывода. Вместо отдельного потока для каждого UART или UDP порта
+ * все дескрипторы портов, сокеты и таймеры (отправка блоков по таймауту,
+ * контроль приёма данных, переподключение) обслуживаются одним или
+ * несколькими потоками #HyScanNmeaReactor. Каждый поток работает со своим
+ * #GMainContext, пользователи распределяются по потокам по очереди.
+ *
+ * Объект HyScanNmeaReactor создаётся функцией #hyscan_nmea_reactor_new.
+ * Общий для всех объектов экземпляр можно получить с помощью функции
+ * #hyscan_nmea_reactor_get_default.
+ *
+ * Функция #hyscan_nmea_reactor_get_context возвращает контекст одного из
+ * потоков, к которому пользователь должен подключать свои источники событий.
+ * Все источники одного пользователя должны подключаться к одному контексту,
+ * в этом случае их обработчики никогда не вызываются параллельно.
+ *
+ * Функция #hyscan_nmea_reactor_invoke синхронно выполняет функцию в потоке
+ * контекста. Она используется для изменения состояния, с которым работают
+ * обработчики событий, без дополнительных блокировок. Функция может
+ * вызываться из любого потока, кроме потоков обработки событий других
+ * контекстов: два таких потока, ожидающих друг друга, заблокировались бы
+ * навсегда.
+ *
+ * Функция #hyscan_nmea_reactor_timer_new создаёт источник событий таймера,
+ * срабатывающего в заданный момент времени (#g_source_set_ready_time).
+ * Такой таймер не требует периодических пробуждений потока.
+ */
+
+#include "hyscan-nmea-reactor.h"
+
+#define DEFAULT_N_THREADS      1
+#define MAX_N_THREADS          64
+
+enum
+{
+  PROP_O,
+  PROP_N_THREADS
+};
+
+/* Поток обработки событий. */
+typedef struct
+{
+  GThread             *thread;         /* Поток обработки событий. */
+  GMainContext        *context;        /* Контекст потока. */
+  GMainLoop           *loop;           /* Цикл обработки событий. */
+} HyScanNmeaReactorShard;
+
+/* Синхронный вызов функции в потоке контекста. */
+typedef struct
+{
+  GSourceFunc          func;           /* Вызываемая функция. */
+  gpointer             data;           /* Данные для функции. */
+  GMutex               lock;           /* Блокировка. */
+  GCond                cond;           /* Сигнализатор завершения вызова. */
+  gboolean             done;           /* Признак завершения вызова. */
+} HyScanNmeaReactorCall;
+
+struct _HyScanNmeaReactorPrivate
+{
+  guint                   n_threads;   /* Число потоков обработки событий. */
+  HyScanNmeaReactorShard *shards;      /* Потоки обработки событий. */
+  guint                   next_shard;  /* Индекс следующего потока для пользователя. */
+};
+
+static void        hyscan_nmea_reactor_set_property        (GObject               *object,
+                                                            guint                  prop_id,
+                                                            const GValue          *value,
+                                                            GParamSpec            *pspec);
+static void        hyscan_nmea_reactor_object_constructed  (GObject               *object);
+static void        hyscan_nmea_reactor_object_finalize     (GObject               *object);
+
+static gpointer    hyscan_nmea_reactor_thread              (gpointer               user_data);
+
+static gboolean    hyscan_nmea_reactor_quit                (gpointer               user_data);
+
+static GPrivate    hyscan_nmea_reactor_current;
+static GWeakRef    hyscan_nmea_reactor_default;
+G_LOCK_DEFINE_STATIC (hyscan_nmea_reactor_default);
+
+G_DEFINE_TYPE_WITH_PRIVATE (HyScanNmeaReactor, hyscan_nmea_reactor, G_TYPE_OBJECT)
+
+static void
+hyscan_nmea_reactor_class_init (HyScanNmeaReactorClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->set_property = hyscan_nmea_reactor_set_property;
+
+  object_class->constructed = hyscan_nmea_reactor_object_constructed;
+  object_class->finalize = hyscan_nmea_reactor_object_finalize;
+
+  g_object_class_install_property (object_class, PROP_N_THREADS,
+    g_param_spec_uint ("n-threads", "NThreads", "Number of threads",
+                       1, MAX_N_THREADS, DEFAULT_N_THREADS,
+                       G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+}
+
+static void
+hyscan_nmea_reactor_init (HyScanNmeaReactor *reactor)
+{
+  reactor->priv = hyscan_nmea_reactor_get_instance_private (reactor);
+}
+
+static void
+hyscan_nmea_reactor_set_property (GObject      *object,
+                                  guint         prop_id,
+                                  const GValue *value,
+                                  GParamSpec   *pspec)
+{
+  HyScanNmeaReactor *reactor = HYSCAN_NMEA_REACTOR (object);
+  HyScanNmeaReactorPrivate *priv = reactor->priv;
+
+  switch (prop_id)
+    {
+    case PROP_N_THREADS:
+      priv->n_threads = g_value_get_uint (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+hyscan_nmea_reactor_object_constructed (GObject *object)
+{
+  HyScanNmeaReactor *reactor = HYSCAN_NMEA_REACTOR (object);
+  HyScanNmeaReactorPrivate *priv = reactor->priv;
+  guint i;
+
+  priv->shards = g_new0 (HyScanNmeaReactorShard, priv->n_threads);
+  for (i = 0; i < priv->n_threads; i++)
+    {
+      HyScanNmeaReactorShard *shard = &priv->shards[i];
+
+      shard->context = g_main_context_new ();
+      shard->loop = g_main_loop_new (shard->context, FALSE);
+      shard->thread = g_thread_new ("nmea-reactor", hyscan_nmea_reactor_thread, shard);
+    }
+}
+
+static void
+hyscan_nmea_reactor_object_finalize (GObject *object)
+{
+  HyScanNmeaReactor *reactor = HYSCAN_NMEA_REACTOR (object);
+  HyScanNmeaReactorPrivate *priv = reactor->priv;
+  guint i;
+
+  for (i = 0; i < priv->n_threads; i++)
+    {
+      HyScanNmeaReactorShard *shard = &priv->shards[i];
+      GSource *source;
+
+      /* Завершаем цикл обработки событий из его потока, на случай
+       * если поток ещё не успел запустить цикл. */
+      source = g_idle_source_new ();
+      g_source_set_priority (source, G_PRIORITY_HIGH);
+      g_source_set_callback (source, hyscan_nmea_reactor_quit, shard->loop, NULL);
+      g_source_attach (source, shard->context);
+      g_source_unref (source);
+
+      /* Последняя ссылка может быть освобождена в потоке обработки событий. */
+      if (shard->thread == g_thread_self ())
+        g_thread_unref (shard->thread);
+      else
+        g_thread_join (shard->thread);
+
+      g_main_loop_unref (shard->loop);
+      g_main_context_unref (shard->context);
+    }
+
+  g_free (priv->shards);
+
+  G_OBJECT_CLASS (hyscan_nmea_reactor_parent_class)->finalize (object);
+}
+
+/* Поток обработки событий. */
+static gpointer
+hyscan_nmea_reactor_thread (gpointer user_data)
+{
+  HyScanNmeaReactorShard *shard = user_data;
+  GMainContext *context = g_main_context_ref (shard->context);
+  GMainLoop *loop = g_main_loop_ref (shard->loop);
+
+  g_private_set (&hyscan_nmea_reactor_current, context);
+
+  g_main_context_push_thread_default (context);
+  g_main_loop_run (loop);
+  g_main_context_pop_thread_default (context);
+
+  g_private_set (&hyscan_nmea_reactor_current, NULL);
+
+  g_main_loop_unref (loop);
+  g_main_context_unref (context);
+
+  return NULL;
+}
+
+/* Функция завершает цикл обработки событий. */
+static gboolean
+hyscan_nmea_reactor_quit (gpointer user_data)
+{
+  g_main_loop_quit (user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Функция выполняет синхронный вызов в потоке контекста. */
+static gboolean
+hyscan_nmea_reactor_call (gpointer user_data)
+{
+  HyScanNmeaReactorCall *call = user_data;
+
+  call->func (call->data);
+
+  g_mutex_lock (&call->lock);
+  call->done = TRUE;
+  g_cond_signal (&call->cond);
+  g_mutex_unlock (&call->lock);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Обработчик событий таймера. */
+static gboolean
+hyscan_nmea_reactor_timer_dispatch (GSource     *source,
+                                    GSourceFunc  callback,
+                                    gpointer     user_data)
+{
+  /* Таймер однократный, обработчик может перезапустить его. */
+  g_source_set_ready_time (source, -1);
+
+  if (callback == NULL)
+    return G_SOURCE_CONTINUE;
+
+  return callback (user_data);
+}
+
+static GSourceFuncs hyscan_nmea_reactor_timer_funcs =
+{
+  NULL,
+  NULL,
+  hyscan_nmea_reactor_timer_dispatch,
+  NULL
+};
+
+/**
+ * hyscan_nmea_reactor_new:
+ * @n_threads: число потоков обработки событий
+ *
+ * Функция создаёт новый объект #HyScanNmeaReactor с указанным числом
+ * потоков обработки событий.
+ *
+ * Returns: #HyScanNmeaReactor. Для удаления #g_object_unref.
+ */
+HyScanNmeaReactor *
+hyscan_nmea_reactor_new (guint n_threads)
+{
+  n_threads = CLAMP (n_threads, 1, MAX_N_THREADS);
+
+  return g_object_new (HYSCAN_TYPE_NMEA_REACTOR,
+                       "n-threads", n_threads,
+                       NULL);
+}
+
+/**
+ * hyscan_nmea_reactor_get_default:
+ *
+ * Функция возвращает общий экземпляр #HyScanNmeaReactor с одним потоком
+ * обработки событий. Объект создаётся при первом обращении и удаляется
+ * после освобождения последней ссылки на него.
+ *
+ * Returns: (transfer full): #HyScanNmeaReactor. Для удаления #g_object_unref.
+ */
+HyScanNmeaReactor *
+hyscan_nmea_reactor_get_default (void)
+{
+  HyScanNmeaReactor *reactor;
+
+  G_LOCK (hyscan_nmea_reactor_default);
+
+  reactor = g_weak_ref_get (&hyscan_nmea_reactor_default);
+  if (reactor == NULL)
+    {
+      reactor = hyscan_nmea_reactor_new (DEFAULT_N_THREADS);
+      g_weak_ref_set (&hyscan_nmea_reactor_default, reactor);
+    }
+
+  G_UNLOCK (hyscan_nmea_reactor_default);
+
+  return reactor;
+}
+
+/**
+ * hyscan_nmea_reactor_get_context:
+ * @reactor: указатель на #HyScanNmeaReactor
+ *
+ * Функция возвращает контекст одного из потоков обработки событий. Потоки
+ * назначаются пользователям по очереди. Пользователь должен удерживать
+ * ссылку на @reactor всё время использования контекста.
+ *
+ * Returns: (transfer full): #GMainContext. Для удаления #g_main_context_unref.
+ */
+GMainContext *
+hyscan_nmea_reactor_get_context (HyScanNmeaReactor *reactor)
+{
+  HyScanNmeaReactorPrivate *priv;
+  guint index;
+
+  g_return_val_if_fail (HYSCAN_IS_NMEA_REACTOR (reactor), NULL);
+
+  priv = reactor->priv;
+
+  index = (guint)g_atomic_int_add (&priv->next_shard, 1) % priv->n_threads;
+
+  return g_main_context_ref (priv->shards[index].context);
+}
+
+/**
+ * hyscan_nmea_reactor_invoke:
+ * @context: контекст потока обработки событий
+ * @func: вызываемая функция
+ * @data: данные для функции
+ *
+ * Функция выполняет @func в потоке контекста и дожидается её завершения.
+ * Если функция вызывается из потока контекста, @func выполняется сразу.
+ * Значение, возвращаемое @func, игнорируется.
+ *
+ * Функцию нельзя вызывать из потока обработки событий другого контекста.
+ * Такой вызов мог бы привести к взаимной блокировке потоков, поэтому он
+ * отклоняется с сообщением об ошибке, а @func не выполняется.
+ */
+void
+hyscan_nmea_reactor_invoke (GMainContext *context,
+                            GSourceFunc   func,
+                            gpointer      data)
+{
+  HyScanNmeaReactorCall call;
+  GSource *source;
+
+  g_return_if_fail (context != NULL);
+
+  if (g_main_context_is_owner (context))
+    {
+      func (data);
+      return;
+    }
+
+  /* Поток обработки событий не должен ожидать другой такой поток. */
+  g_return_if_fail (g_private_get (&hyscan_nmea_reactor_current) == NULL);
+
+  call.func = func;
+  call.data = data;
+  call.done = FALSE;
+  g_mutex_init (&call.lock);
+  g_cond_init (&call.cond);
+
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_HIGH);
+  g_source_set_callback (source, hyscan_nmea_reactor_call, &call, NULL);
+  g_source_attach (source, context);
+  g_source_unref (source);
+
+  g_mutex_lock (&call.lock);
+  while (!call.done)
+    g_cond_wait (&call.cond, &call.lock);
+  g_mutex_unlock (&call.lock);
+
+  g_mutex_clear (&call.lock);
+  g_cond_clear (&call.cond);
+}
+
+/**
+ * hyscan_nmea_reactor_timer_new:
+ *
+ * Функция создаёт источник событий однократного таймера. Момент
+ * срабатывания таймера задаётся функцией #g_source_set_ready_time в
+ * единицах #g_get_monotonic_time. Перед вызовом обработчика таймер
+ * отключается, обработчик может установить новый момент срабатывания.
+ * Функция #g_source_set_ready_time может вызываться из любого потока.
+ *
+ * Returns: (transfer full): #GSource. Для удаления #g_source_unref.
+ */
+GSource *
+hyscan_nmea_reactor_timer_new (void)
+{
+  GSource *source;
+
+  source = g_source_new (&hyscan_nmea_reactor_timer_funcs, sizeof (GSource));
+  g_source_set_ready_time (source, -1);
+
+  return source;
+}
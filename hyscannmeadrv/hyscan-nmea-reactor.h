@@ -0,0 +1,87 @@
+/* hyscan-nmea-reactor.h
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+#ifndef __HYSCAN_NMEA_REACTOR_H__
+#define __HYSCAN_NMEA_REACTOR_H__
+
+#include <hyscan-types.h>
+
+G_BEGIN_DECLS
+
+#define HYSCAN_TYPE_NMEA_REACTOR             (hyscan_nmea_reactor_get_type ())
+#define HYSCAN_NMEA_REACTOR(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), HYSCAN_TYPE_NMEA_REACTOR, HyScanNmeaReactor))
+#define HYSCAN_IS_NMEA_REACTOR(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HYSCAN_TYPE_NMEA_REACTOR))
+#define HYSCAN_NMEA_REACTOR_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), HYSCAN_TYPE_NMEA_REACTOR, HyScanNmeaReactorClass))
+#define HYSCAN_IS_NMEA_REACTOR_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE ((klass), HYSCAN_TYPE_NMEA_REACTOR))
+#define HYSCAN_NMEA_REACTOR_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS ((obj), HYSCAN_TYPE_NMEA_REACTOR, HyScanNmeaReactorClass))
+
+typedef struct _HyScanNmeaReactor HyScanNmeaReactor;
+typedef struct _HyScanNmeaReactorPrivate HyScanNmeaReactorPrivate;
+typedef struct _HyScanNmeaReactorClass HyScanNmeaReactorClass;
+
+struct _HyScanNmeaReactor
+{
+  GObject parent_instance;
+
+  HyScanNmeaReactorPrivate *priv;
+};
+
+struct _HyScanNmeaReactorClass
+{
+  GObjectClass parent_class;
+};
+
+HYSCAN_API
+GType                  hyscan_nmea_reactor_get_type            (void);
+
+HYSCAN_API
+HyScanNmeaReactor *    hyscan_nmea_reactor_new                 (guint                    n_threads);
+
+HYSCAN_API
+HyScanNmeaReactor *    hyscan_nmea_reactor_get_default         (void);
+
+HYSCAN_API
+GMainContext *         hyscan_nmea_reactor_get_context         (HyScanNmeaReactor       *reactor);
+
+HYSCAN_API
+void                   hyscan_nmea_reactor_invoke              (GMainContext            *context,
+                                                                GSourceFunc              func,
+                                                                gpointer                 data);
+
+HYSCAN_API
+GSource *              hyscan_nmea_reactor_timer_new           (void);
+
+G_END_DECLS
+
+#endif /* __HYSCAN_NMEA_REACTOR_H__ */
@@ -40,8 +40,9 @@
  * Класс предназначен для приёма NMEA данных. Во время приёма данных
  * производится автоматическая группировка NMEA строк в блоки, по времени
  * принятия решения навигационной ситсемой. Для этих целей используются
- * строки GGA, RMC, GLL, BWC и ZDA. Одновременно с этим производится фиксация
- * момента времени прихода первого символа первой строки блока.
+ * строки GGA, RMC, GLL, GNS, GST, GBS, GRS, BWC, BWR, ZDA, ZFO и ZTG, а также
+ * строки HyScan/Hydra ACP, PTF и PTQ. Одновременно с этим производится
+ * фиксация момента времени прихода первого символа первой строки блока.
  *
  * Объект HyScanNmeaReceiver создаётся с помощью функции
  * #hyscan_nmea_receiver_new.
@@ -52,35 +53,136 @@
  * Приём данных от GPS устройства или других источников должен быть реализован
  * сторонними классами. HyScanNmeaReceiver обрабатывает уже принятые данные.
  * Для передачи данных предназначена функция #hyscan_nmea_receiver_add_data.
+ * Если данные принимаются последовательно блоками по несколько символов,
+ * например из UART порта, можно использовать функцию
+ * #hyscan_nmea_receiver_add_chars. В этом случае время приёма каждого
+ * символа восстанавливается по времени передачи одного символа.
  *
  * Блок данных отправляется пользователю в момент изменения времени в любой
  * из NMEA строк. В обычной ситуации это приводит к задержке отправки данных
  * пользователю на один цикл приёма (на определение времени приёма это не
- * влияет). Если пользователю необходимо получать данные более оперативно, он
- * может использовать функцию #hyscan_nmea_receiver_flush для отправки текущего
- * блока данных, если в течение времени timeout не было новых данных.
+ * влияет). Чтобы избежать этой задержки, объект может запоминать тип и
+ * номер строки, которой завершается эпоха, и отправлять блок сразу после
+ * её приёма, если порядок строк не меняется. Это поведение управляется функцией
+ * #hyscan_nmea_receiver_set_predict_epoch. Если пользователю необходимо
+ * получать данные более оперативно, он может использовать функцию
+ * #hyscan_nmea_receiver_flush для отправки текущего блока данных, если в
+ * течение времени timeout не было новых данных.
  * Отправка готовых блоков данных пользователю осуществляется через сигнал
- * #HyScanNmeaReceiver::nmea-data.
+ * #HyScanNmeaReceiver::nmea-data. Кроме этого, можно зарегистрировать
+ * функцию обработки данных с помощью #hyscan_nmea_receiver_set_data_func.
+ * Она вызывается напрямую, без упаковки параметров в GValue, и перед
+ * отправкой сигнала. При большом потоке данных удобнее использовать
+ * функцию пакетной обработки #hyscan_nmea_receiver_set_batch_func. Поток
+ * отправки забирает из буфера сразу все накопившиеся блоки, но не более
+ * заданного числа, и передаёт их этой функции одним массивом.
+ *
+ * Если при создании объекта установлено свойство "line-times", для каждой
+ * строки блока дополнительно сохраняется время её приёма относительно
+ * времени блока. Эти данные передаются только функции пакетной обработки,
+ * в полях line_times и n_lines структуры #HyScanNmeaReceiverBlock. Сами
+ * NMEA данные при этом не изменяются.
+ *
+ * Строки, из которых невозможно определить время, по умолчанию отправляются
+ * отдельными блоками. Если источник вообще не передаёт время, например
+ * эхолот или гирокомпас, такие строки можно объединять в блоки по времени
+ * приёма или по числу строк с помощью функции
+ * #hyscan_nmea_receiver_group_untimed.
+ *
+ * Функция #hyscan_nmea_receiver_set_filter задаёт список разрешённых или
+ * запрещённых типов NMEA строк. Отфильтрованные строки отбрасываются сразу
+ * после выделения из потока данных и не попадают в блоки, поэтому не
+ * расходуют место в буфере и время потока отправки.
+ *
+ * Частые NMEA строки можно проредить до группировки в блоки с помощью
+ * функции #hyscan_nmea_receiver_set_decimation: пропускать каждую N-ю
+ * строку заданного типа или не более заданного числа строк в секунду.
+ *
+ * Строки, критичные к задержке, например курс и ориентация, можно объявить
+ * срочными с помощью функции #hyscan_nmea_receiver_set_urgent. Срочная
+ * строка отправляется сразу после приёма отдельным блоком, не дожидаясь
+ * завершения эпохи. Такие блоки передаются потоку отправки через
+ * отдельный небольшой кольцевой буфер, который поток отправки проверяет
+ * перед основным, поэтому они не ожидают в очереди за крупными блоками.
+ * Порядок срочных блоков относительно остальных при этом не сохраняется:
+ * срочный блок может быть отправлен раньше блока с меньшей меткой времени.
+ * Функция пакетной обработки отличает срочные блоки по полю urgent
+ * структуры #HyScanNmeaReceiverBlock.
+ *
+ * Готовые блоки передаются потоку отправки через кольцевой буфер без
+ * блокировок, рассчитанный на одного писателя и одного читателя. Поэтому
+ * функции #hyscan_nmea_receiver_add_data, #hyscan_nmea_receiver_add_chars и
+ * #hyscan_nmea_receiver_flush должны вызываться из одного потока. Блоки
+ * размещаются в буфере друг за другом и занимают в нём место по своему
+ * фактическому размеру. Размер буфера, максимальное число блоков в нём и
+ * максимальный размер блока задаются при создании объекта через свойства
+ * "buffer-size", "n-buffers" и "message-size". Буфер всегда вмещает не
+ * менее трёх блоков максимального размера.
+ *
+ * Поведение при заполнении кольцевого буфера определяется функцией
+ * #hyscan_nmea_receiver_set_overflow. По умолчанию новые блоки данных
+ * отбрасываются. Число отброшенных блоков можно узнать с помощью функции
+ * #hyscan_nmea_receiver_get_dropped. Ожидание места в буфере задерживает
+ * поток #HyScanNmeaReactor, общий для нескольких объектов, поэтому оно
+ * ограничено 5 мс.
+ *
+ * Если минимальная задержка важнее развязки потоков, при создании объекта
+ * можно установить свойство "inline". В этом режиме поток отправки данных
+ * не создаётся, а готовые блоки передаются пользователю синхронно, в потоке
+ * вызвавшем #hyscan_nmea_receiver_add_data, #hyscan_nmea_receiver_add_chars
+ * или #hyscan_nmea_receiver_flush. Обработчики данных в этом режиме
+ * задерживают приём, поэтому они должны завершаться быстро.
  *
  * Функция #hyscan_nmea_receiver_send_log может использоваться для отправки
  * информационных сообщений.
  *
  * Если была обнаружена ошибка ввода/вывода, можно использовать функцию
  * #hyscan_nmea_receiver_io_error для сигнализирования о ней.
+ *
+ * Классы приёма данных, наследуемые от HyScanNmeaReceiver, не создают
+ * собственных потоков. Они регистрируют свои источники событий в потоке
+ * #HyScanNmeaReactor, контекст которого можно узнать с помощью функции
+ * #hyscan_nmea_receiver_get_context. Объект #HyScanNmeaReactor задаётся
+ * при создании объекта через свойство "reactor", по умолчанию используется
+ * общий экземпляр #hyscan_nmea_reactor_get_default. Удаление объекта и
+ * изменение его параметров выполняются в потоке #HyScanNmeaReactor с
+ * помощью #hyscan_nmea_reactor_invoke, поэтому их нельзя выполнять из
+ * обработчиков событий другого потока #HyScanNmeaReactor.
  */
 
 #include "hyscan-nmea-receiver.h"
+#include "hyscan-nmea-parser.h"
 #include "hyscan-nmea-marshallers.h"
 
-#include <hyscan-slice-pool.h>
-
 #include <string.h>
-#include <stdio.h>
 
 #define N_BUFFERS 16
+#define MAX_N_BUFFERS 4096
+#define BUFFER_SIZE 32768
+#define MIN_BUFFER_SIZE 4096
+#define MAX_BUFFER_SIZE 67108864
 #define MAX_MSG_SIZE 4084
-#define MAX_STRING_SIZE 253
+#define MIN_MSG_SIZE 256
+#define MAX_MAX_MSG_SIZE 1048576
+#define MAX_BATCH_SIZE 64
+#define BUSY_COUNT_BITS 8
+#define BUSY_COUNT_MASK ((1u << BUSY_COUNT_BITS) - 1)
+#define BUSY_INDEX_MASK (G_MAXUINT32 >> BUSY_COUNT_BITS)
+#define N_URGENT_BUFFERS 16
 #define RX_TIMEOUT 2.0
+#define MAX_UNTIMED_WINDOW 10.0
+#define MAX_OVERFLOW_TIMEOUT 0.005
+
+enum
+{
+  PROP_O,
+  PROP_REACTOR,
+  PROP_INLINE,
+  PROP_N_BUFFERS,
+  PROP_MESSAGE_SIZE,
+  PROP_BUFFER_SIZE,
+  PROP_LINE_TIMES
+};
 
 enum
 {
@@ -93,38 +195,118 @@ enum
 typedef struct
 {
   gint64           time;                       /* Время приёма сообщения. */
-  gchar            data[MAX_MSG_SIZE];         /* Данные. */
   guint32          size;                       /* Размер сообщения. */
+  guint32          n_lines;                    /* Число NMEA строк в сообщении. */
+  gchar            data[];                     /* Данные и место для следующей NMEA строки. */
 } HyScanNmeaReceiverMessage;
 
 struct _HyScanNmeaReceiverPrivate
 {
+  HyScanNmeaReactor *reactor;                  /* Цикл обработки событий ввода/вывода. */
+  GMainContext    *context;                    /* Контекст потока обработки событий. */
+
   GThread         *emmiter;                    /* Поток отправки данных. */
 
+  gboolean         inline_delivery;            /* Признак отправки данных без потока отправки. */
+  gboolean         line_times;                 /* Признак сохранения времени приёма строк. */
   gboolean         terminate;                  /* Признак необходимости завершения работы. */
   gboolean         skip_broken;                /* Признак необходимости пропуска битых NMEA строк. */
 
   GTimer          *timeout;                    /* Таймер отправки сообщения по таймауту. */
-  GAsyncQueue     *queue;                      /* Очередь сообщений для отправки клиенту. */
-  HyScanSlicePool *buffers;                    /* Список буферов приёма данных. */
-  GRWLock          lock;                       /* Блокировка доступа к списку буферов. */
-
-  gint64           rx_time;                    /* Метка времени приёма начала строки. */
-  gint             nmea_time;                  /* NMEA время сообщения. */
-  gint64           message_time;               /* Метка времени сообщения. */
-
-  gchar            message[MAX_MSG_SIZE];      /* Буфер собираемого сообщения. */
-  guint32          message_size;               /* Размер сообщения. */
 
-  gchar            string[MAX_STRING_SIZE+3];  /* NMEA строка. */
-  guint            string_size;                /* Размер NMEA строки. */
+  gchar           *ring;                       /* Кольцевой буфер сообщений для отправки клиенту. */
+  gsize            ring_size;                  /* Размер кольцевого буфера. */
+  gsize           *offsets;                    /* Смещения сообщений в кольцевом буфере. */
+  guint            n_buffers;                  /* Максимальное число сообщений в кольцевом буфере. */
+  guint            max_msg_size;               /* Максимальный размер сообщения. */
+  gsize            slot_size;                  /* Место, резервируемое для собираемого сообщения. */
+  guint            max_lines;                  /* Максимальное число строк в таблице. */
+  guint32         *times;                      /* Время приёма строк собираемого сообщения. */
+  guint            ring_head;                  /* Число записанных в буфер сообщений. */
+  guint            ring_tail;                  /* Число отправленных или отброшенных сообщений. */
+  guint            ring_busy;                  /* Номер первого отправляемого клиенту сообщения и их число. */
+
+  gchar           *urgent_ring;                /* Кольцевой буфер срочных сообщений. */
+  gsize            urgent_slot_size;           /* Размер места под срочное сообщение. */
+  guint            urgent_head;                /* Число записанных срочных сообщений. */
+  guint            urgent_tail;                /* Число отправленных срочных сообщений. */
+
+  gint             overflow;                   /* Политика обработки переполнения буфера. */
+  gint             overflow_timeout;           /* Время ожидания места в буфере, мкс. */
+  gboolean         blocked;                    /* Признак ожидания места в буфере. */
+  GCond            space_cond;                 /* Сигнализатор освобождения места в буфере. */
+  guint            n_dropped;                  /* Число отброшенных сообщений. */
+  guint            n_sentences;                /* Число принятых NMEA строк. */
+
+  HyScanNmeaReceiverDataFunc data_func;        /* Функция обработки данных. */
+  gpointer         data_user_data;             /* Пользовательские данные функции обработки. */
+  GRecMutex        data_lock;                  /* Блокировка функции обработки данных. */
+
+  HyScanNmeaReceiverBatchFunc batch_func;      /* Функция пакетной обработки данных. */
+  gpointer         batch_user_data;            /* Пользовательские данные функции пакетной обработки. */
+  guint            batch_size;                 /* Максимальное число блоков в пакете. */
+  HyScanNmeaReceiverBlock batch[MAX_BATCH_SIZE]; /* Пакет блоков данных. */
+  HyScanNmeaReceiverMessage *messages[MAX_BATCH_SIZE]; /* Отправляемые сообщения. */
+
+  gboolean         sleeping;                   /* Признак ожидания сообщений потоком отправки. */
+  GMutex           wait_lock;                  /* Блокировка ожидания сообщений. */
+  GCond            wait_cond;                  /* Сигнализатор появления сообщений. */
+
+  gboolean         predict_epoch;              /* Признак отправки блока по последней строке эпохи. */
+  gint             untimed_window;             /* Интервал группировки строк без времени, мкс. */
+  guint            untimed_count;              /* Максимальное число строк без времени в блоке. */
+
+  HyScanNmeaParserFilter filter;               /* Новый фильтр NMEA строк. */
+  gboolean         filter_changed;             /* Признак изменения фильтра. */
+  HyScanNmeaParserDecimation decimation;       /* Новые правила прореживания NMEA строк. */
+  gboolean         decimation_changed;         /* Признак изменения правил прореживания. */
+  HyScanNmeaParserFilter urgent;               /* Новые шаблоны срочных NMEA строк. */
+  gboolean         urgent_changed;             /* Признак изменения шаблонов срочных строк. */
+  GMutex           rules_lock;                 /* Блокировка правил разбора NMEA строк. */
+
+  HyScanNmeaParser parser;                     /* Разборщик NMEA данных. */
 };
 
+static void        hyscan_nmea_receiver_set_property       (GObject       *object,
+                                                            guint          prop_id,
+                                                            const GValue  *value,
+                                                            GParamSpec    *pspec);
 static void        hyscan_nmea_receiver_object_constructed (GObject       *object);
 static void        hyscan_nmea_receiver_object_finalize    (GObject       *object);
 
 static gpointer    hyscan_nmea_receiver_emmiter            (gpointer       user_data);
 
+static HyScanNmeaReceiverMessage *
+                   hyscan_nmea_receiver_slot               (HyScanNmeaReceiverPrivate *priv,
+                                                            guint          index);
+
+static const guint32 *
+                   hyscan_nmea_receiver_times              (HyScanNmeaReceiverPrivate *priv,
+                                                            HyScanNmeaReceiverMessage *message);
+
+static HyScanNmeaReceiverMessage *
+                   hyscan_nmea_receiver_urgent_slot        (HyScanNmeaReceiverPrivate *priv,
+                                                            guint          index);
+
+static void        hyscan_nmea_receiver_deliver            (HyScanNmeaReceiver        *receiver,
+                                                            HyScanNmeaReceiverMessage **messages,
+                                                            guint          n_messages,
+                                                            gboolean       urgent);
+
+static gboolean    hyscan_nmea_receiver_has_space          (HyScanNmeaReceiverPrivate *priv,
+                                                            guint          head,
+                                                            gsize          next);
+
+static gboolean    hyscan_nmea_receiver_overflow           (HyScanNmeaReceiverPrivate *priv,
+                                                            guint          head,
+                                                            gsize          next);
+
+static gboolean    hyscan_nmea_receiver_push_urgent        (HyScanNmeaReceiver        *receiver,
+                                                            const HyScanNmeaParserBlock *block);
+
+static gboolean    hyscan_nmea_receiver_push               (HyScanNmeaReceiver        *receiver,
+                                                            const HyScanNmeaParserBlock *block);
+
 static guint       hyscan_nmea_receiver_signals[SIGNAL_LAST] = { 0 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (HyScanNmeaReceiver, hyscan_nmea_receiver, G_TYPE_OBJECT)
@@ -134,9 +316,38 @@ hyscan_nmea_receiver_class_init (HyScanNmeaReceiverClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
+  object_class->set_property = hyscan_nmea_receiver_set_property;
+
   object_class->constructed = hyscan_nmea_receiver_object_constructed;
   object_class->finalize = hyscan_nmea_receiver_object_finalize;
 
+  g_object_class_install_property (object_class, PROP_REACTOR,
+    g_param_spec_object ("reactor", "Reactor", "I/O reactor", HYSCAN_TYPE_NMEA_REACTOR,
+                          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_INLINE,
+    g_param_spec_boolean ("inline", "Inline", "Deliver data from the receiving thread", FALSE,
+                          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_N_BUFFERS,
+    g_param_spec_uint ("n-buffers", "NBuffers", "Maximum number of messages",
+                       2, MAX_N_BUFFERS, N_BUFFERS,
+                       G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_MESSAGE_SIZE,
+    g_param_spec_uint ("message-size", "MessageSize", "Maximum message size",
+                       MIN_MSG_SIZE, MAX_MAX_MSG_SIZE, MAX_MSG_SIZE,
+                       G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_BUFFER_SIZE,
+    g_param_spec_uint ("buffer-size", "BufferSize", "Message buffer size",
+                       MIN_BUFFER_SIZE, MAX_BUFFER_SIZE, BUFFER_SIZE,
+                       G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_LINE_TIMES,
+    g_param_spec_boolean ("line-times", "LineTimes", "Keep receive time of each sentence", FALSE,
+                          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
   /**
    * HyScanNmeaReceiver::nmea-data:
    * @receiver: указатель на #HyScanNmeaReceiver
@@ -147,13 +358,17 @@ hyscan_nmea_receiver_class_init (HyScanNmeaReceiverClass *klass)
    * Данный сигнал посылается при получении от устройства блока NMEA данных.
    * Данные представлены в виде NULL терминированой строки. Размер включает
    * в себя нулевой символ.
+   *
+   * Данные передаются без копирования и остаются действительными только
+   * во время обработки сигнала. Сигнал посылается из потока отправки
+   * данных или, если установлено свойство "inline", из потока приёма.
    */
   hyscan_nmea_receiver_signals[SIGNAL_NMEA_DATA] =
     g_signal_new ("nmea-data", HYSCAN_TYPE_NMEA_RECEIVER, G_SIGNAL_RUN_LAST, 0,
                   NULL, NULL,
                   hyscan_nmea_marshal_VOID__INT64_STRING_UINT,
                   G_TYPE_NONE,
-                  3, G_TYPE_INT64, G_TYPE_STRING, G_TYPE_UINT);
+                  3, G_TYPE_INT64, G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE, G_TYPE_UINT);
 
   /**
    * HyScanNmeaReceiver::nmea-log:
@@ -193,22 +408,105 @@ hyscan_nmea_receiver_init (HyScanNmeaReceiver *receiver)
   receiver->priv = hyscan_nmea_receiver_get_instance_private (receiver);
 }
 
+static void
+hyscan_nmea_receiver_set_property (GObject      *object,
+                                   guint         prop_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+  HyScanNmeaReceiver *receiver = HYSCAN_NMEA_RECEIVER (object);
+  HyScanNmeaReceiverPrivate *priv = receiver->priv;
+
+  switch (prop_id)
+    {
+    case PROP_REACTOR:
+      priv->reactor = g_value_dup_object (value);
+      break;
+
+    case PROP_INLINE:
+      priv->inline_delivery = g_value_get_boolean (value);
+      break;
+
+    case PROP_N_BUFFERS:
+      priv->n_buffers = g_value_get_uint (value);
+      break;
+
+    case PROP_MESSAGE_SIZE:
+      priv->max_msg_size = g_value_get_uint (value);
+      break;
+
+    case PROP_BUFFER_SIZE:
+      priv->ring_size = g_value_get_uint (value);
+      break;
+
+    case PROP_LINE_TIMES:
+      priv->line_times = g_value_get_boolean (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
 static void
 hyscan_nmea_receiver_object_constructed (GObject *object)
 {
   HyScanNmeaReceiver *receiver = HYSCAN_NMEA_RECEIVER (object);
   HyScanNmeaReceiverPrivate *priv = receiver->priv;
-  guint i;
 
-  g_rw_lock_init (&priv->lock);
+  if (priv->reactor == NULL)
+    priv->reactor = hyscan_nmea_reactor_get_default ();
+  priv->context = hyscan_nmea_reactor_get_context (priv->reactor);
+
+  g_mutex_init (&priv->wait_lock);
+  g_cond_init (&priv->wait_cond);
+  g_cond_init (&priv->space_cond);
+  g_rec_mutex_init (&priv->data_lock);
+  g_mutex_init (&priv->rules_lock);
 
   priv->timeout = g_timer_new ();
 
-  priv->queue = g_async_queue_new_full (g_free);
-  for (i = 0; i < N_BUFFERS; i++)
-    hyscan_slice_pool_push (&priv->buffers, g_new (HyScanNmeaReceiverMessage, 1));
+  /* Число сообщений округляется до степени двойки, чтобы номера
+   * сообщений оставались непрерывными при переполнении счётчиков. */
+  priv->n_buffers = 1 << g_bit_storage (priv->n_buffers - 1);
 
-  priv->emmiter = g_thread_new ("nmea-emmiter", hyscan_nmea_receiver_emmiter, receiver);
+  if (priv->line_times)
+    {
+      priv->max_lines = HYSCAN_NMEA_PARSER_MAX_LINES (priv->max_msg_size);
+      priv->times = g_new (guint32, priv->max_lines);
+    }
+
+  /* Место для сообщения максимального размера с учётом следующей NMEA
+   * строки и таблицы времени приёма строк, выровненное на размер заголовка. */
+  priv->slot_size = sizeof (HyScanNmeaReceiverMessage) + HYSCAN_NMEA_PARSER_BUFFER_SIZE (priv->max_msg_size);
+  priv->slot_size += priv->max_lines * sizeof (guint32);
+  priv->slot_size = (priv->slot_size + sizeof (gint64) - 1) & ~(sizeof (gint64) - 1);
+
+  /* Сообщения размещаются в буфере друг за другом и занимают место
+   * по фактическому размеру. Буфер должен вмещать не менее трёх сообщений
+   * максимального размера, чтобы писатель всегда мог продолжить запись. */
+  priv->ring_size = MAX (priv->ring_size, 3 * priv->slot_size);
+  priv->ring_size = (priv->ring_size + sizeof (gint64) - 1) & ~(sizeof (gint64) - 1);
+
+  priv->ring = g_malloc (priv->ring_size);
+  priv->offsets = g_new0 (gsize, priv->n_buffers);
+  priv->batch_size = 1;
+
+  /* Срочное сообщение состоит из одной NMEA строки с символами "\r\n" и
+   * нулевым символом и времени её приёма. */
+  priv->urgent_slot_size = sizeof (HyScanNmeaReceiverMessage) + ((HYSCAN_NMEA_PARSER_MAX_STRING + 4 + 3) & ~3);
+  priv->urgent_slot_size += sizeof (guint32);
+  priv->urgent_slot_size = (priv->urgent_slot_size + sizeof (gint64) - 1) & ~(sizeof (gint64) - 1);
+  priv->urgent_ring = g_malloc (N_URGENT_BUFFERS * priv->urgent_slot_size);
+
+  /* Сообщения собираются разборщиком прямо в кольцевом буфере. */
+  hyscan_nmea_parser_init (&priv->parser, hyscan_nmea_receiver_slot (priv, 0)->data,
+                           priv->max_msg_size, priv->times);
+
+  /* В режиме синхронной отправки поток отправки данных не нужен. */
+  if (!priv->inline_delivery)
+    priv->emmiter = g_thread_new ("nmea-emmiter", hyscan_nmea_receiver_emmiter, receiver);
 }
 
 static void
@@ -216,45 +514,465 @@ hyscan_nmea_receiver_object_finalize (GObject *object)
 {
   HyScanNmeaReceiver *receiver = HYSCAN_NMEA_RECEIVER (object);
   HyScanNmeaReceiverPrivate *priv = receiver->priv;
-  gpointer buffer;
 
+  g_mutex_lock (&priv->wait_lock);
   g_atomic_int_set (&priv->terminate, TRUE);
-  g_thread_join (priv->emmiter);
+  g_cond_signal (&priv->wait_cond);
+  g_cond_broadcast (&priv->space_cond);
+  g_mutex_unlock (&priv->wait_lock);
 
-  g_async_queue_unref (priv->queue);
-  while ((buffer = hyscan_slice_pool_pop (&priv->buffers)) != NULL)
-    g_free (buffer);
+  if (priv->emmiter != NULL)
+    g_thread_join (priv->emmiter);
+
+  g_free (priv->ring);
+  g_free (priv->offsets);
+  g_free (priv->urgent_ring);
+  g_free (priv->times);
 
   g_timer_destroy (priv->timeout);
 
-  g_rw_lock_clear (&priv->lock);
+  g_cond_clear (&priv->wait_cond);
+  g_cond_clear (&priv->space_cond);
+  g_mutex_clear (&priv->wait_lock);
+  g_rec_mutex_clear (&priv->data_lock);
+  g_mutex_clear (&priv->rules_lock);
+
+  g_main_context_unref (priv->context);
+  g_object_unref (priv->reactor);
 
   G_OBJECT_CLASS (hyscan_nmea_receiver_parent_class)->finalize (object);
 }
 
-/* Поток отправки данных клиенту. */
+/* Поток отправки данных клиенту. Поток засыпает только при отсутствии
+ * сообщений в кольцевых буферах и пробуждается функциями
+ * hyscan_nmea_receiver_push и hyscan_nmea_receiver_push_urgent или при
+ * завершении работы. */
 static gpointer
 hyscan_nmea_receiver_emmiter (gpointer user_data)
 {
   HyScanNmeaReceiver *receiver = user_data;
   HyScanNmeaReceiverPrivate *priv = receiver->priv;
-  HyScanNmeaReceiverMessage *message;
+  guint n_messages;
+  guint urgent_tail;
+  guint tail;
+  guint i;
 
   while (!g_atomic_int_get (&priv->terminate))
     {
-      message = g_async_queue_timeout_pop (priv->queue, 100000);
-      if (message == NULL)
-        continue;
+      /* Срочные сообщения отправляются в первую очередь. Их слоты
+       * освобождаются только потоком отправки, поэтому забирать их
+       * атомарно не нужно. */
+      urgent_tail = priv->urgent_tail;
+      n_messages = (guint) g_atomic_int_get (&priv->urgent_head) - urgent_tail;
+      if (n_messages > 0)
+        {
+          n_messages = MIN (n_messages, (guint) g_atomic_int_get (&priv->batch_size));
+          for (i = 0; i < n_messages; i++)
+            priv->messages[i] = hyscan_nmea_receiver_urgent_slot (priv, urgent_tail + i);
+
+          hyscan_nmea_receiver_deliver (receiver, priv->messages, n_messages, TRUE);
+
+          g_atomic_int_set (&priv->urgent_tail, urgent_tail + n_messages);
+
+          continue;
+        }
+
+      tail = g_atomic_int_get (&priv->ring_tail);
+      n_messages = (guint) g_atomic_int_get (&priv->ring_head) - tail;
+
+      /* Новых сообщений нет - ожидаем их появления. Признак ожидания
+       * устанавливается до повторной проверки буфера, поэтому писатель
+       * либо увидит этот признак, либо мы увидим новое сообщение. */
+      if (n_messages == 0)
+        {
+          g_mutex_lock (&priv->wait_lock);
+          g_atomic_int_set (&priv->sleeping, TRUE);
+
+          if (((guint) g_atomic_int_get (&priv->ring_head) == tail) &&
+              ((guint) g_atomic_int_get (&priv->urgent_head) == urgent_tail) &&
+              !g_atomic_int_get (&priv->terminate))
+            {
+              g_cond_wait (&priv->wait_cond, &priv->wait_lock);
+            }
+
+          g_atomic_int_set (&priv->sleeping, FALSE);
+          g_mutex_unlock (&priv->wait_lock);
+
+          continue;
+        }
+
+      n_messages = MIN (n_messages, (guint) g_atomic_int_get (&priv->batch_size));
+
+      /* Забираем сообщения из буфера. При переполнении писатель может
+       * отбросить самое старое сообщение, поэтому сообщения забираются
+       * атомарно. Слоты сообщений остаются занятыми до окончания отправки,
+       * о чём писатель узнаёт по значению ring_busy. Номер первого
+       * сообщения и их число публикуются одним словом, поэтому писатель
+       * не может увидеть номер от одной выборки, а число от другой. */
+      g_atomic_int_set (&priv->ring_busy, (tail << BUSY_COUNT_BITS) | n_messages);
+      if (!g_atomic_int_compare_and_exchange (&priv->ring_tail, tail, tail + n_messages))
+        {
+          g_atomic_int_set (&priv->ring_busy, 0);
+          continue;
+        }
+
+      for (i = 0; i < n_messages; i++)
+        priv->messages[i] = hyscan_nmea_receiver_slot (priv, tail + i);
+
+      hyscan_nmea_receiver_deliver (receiver, priv->messages, n_messages, FALSE);
 
+      /* Освобождаем слоты сообщений для писателя. */
+      g_atomic_int_set (&priv->ring_busy, 0);
+
+      /* Пробуждаем писателя, если он ожидает места в буфере. */
+      if (g_atomic_int_get (&priv->blocked))
+        {
+          g_mutex_lock (&priv->wait_lock);
+          g_cond_signal (&priv->space_cond);
+          g_mutex_unlock (&priv->wait_lock);
+        }
+    }
+
+  return NULL;
+}
+
+/* Функция возвращает сообщение кольцевого буфера с номером index. */
+static HyScanNmeaReceiverMessage *
+hyscan_nmea_receiver_slot (HyScanNmeaReceiverPrivate *priv,
+                           guint                      index)
+{
+  return (HyScanNmeaReceiverMessage *) (priv->ring + priv->offsets[index & (priv->n_buffers - 1)]);
+}
+
+/* Функция возвращает срочное сообщение с номером index. */
+static HyScanNmeaReceiverMessage *
+hyscan_nmea_receiver_urgent_slot (HyScanNmeaReceiverPrivate *priv,
+                                  guint                      index)
+{
+  return (HyScanNmeaReceiverMessage *) (priv->urgent_ring + (index % N_URGENT_BUFFERS) * priv->urgent_slot_size);
+}
+
+/* Функция возвращает таблицу времени приёма строк отправляемого сообщения
+ * или NULL, если время приёма строк не сохраняется. Таблица располагается
+ * сразу после данных сообщения. */
+static const guint32 *
+hyscan_nmea_receiver_times (HyScanNmeaReceiverPrivate *priv,
+                            HyScanNmeaReceiverMessage *message)
+{
+  if (priv->max_lines == 0)
+    return NULL;
+
+  return (const guint32 *) (message->data + ((message->size + 3) & ~3));
+}
+
+/* Функция передаёт n_messages сообщений функции пакетной обработки,
+ * функции обработки данных и обработчикам сигнала nmea-data. Признак
+ * urgent указывает, что сообщения взяты из буфера срочных сообщений. */
+static void
+hyscan_nmea_receiver_deliver (HyScanNmeaReceiver         *receiver,
+                              HyScanNmeaReceiverMessage **messages,
+                              guint                       n_messages,
+                              gboolean                    urgent)
+{
+  HyScanNmeaReceiverPrivate *priv = receiver->priv;
+  HyScanNmeaReceiverMessage *message;
+  guint i;
+
+  g_rec_mutex_lock (&priv->data_lock);
+
+  if (priv->batch_func != NULL)
+    {
+      for (i = 0; i < n_messages; i++)
+        {
+          message = messages[i];
+          priv->batch[i].time = message->time;
+          priv->batch[i].data = message->data;
+          priv->batch[i].size = message->size;
+          priv->batch[i].line_times = hyscan_nmea_receiver_times (priv, message);
+          priv->batch[i].n_lines = (priv->max_lines > 0) ? message->n_lines : 0;
+          priv->batch[i].urgent = urgent;
+        }
+
+      priv->batch_func (receiver, priv->batch, n_messages, priv->batch_user_data);
+    }
+
+  for (i = 0; (i < n_messages) && (priv->data_func != NULL); i++)
+    {
+      message = messages[i];
+      priv->data_func (receiver, message->time, message->data, message->size, priv->data_user_data);
+    }
+
+  g_rec_mutex_unlock (&priv->data_lock);
+
+  for (i = 0; i < n_messages; i++)
+    {
+      message = messages[i];
       g_signal_emit (receiver, hyscan_nmea_receiver_signals[SIGNAL_NMEA_DATA], 0,
                      message->time, message->data, message->size);
+    }
+}
+
+/* Функция возвращает число сообщений, занятых потоком отправки, и номер
+ * первого из них. В ring_busy хранятся младшие разряды номера, полный номер
+ * восстанавливается по номеру собираемого сообщения head, от которого он
+ * отстоит не более чем на n_buffers сообщений. */
+static guint
+hyscan_nmea_receiver_get_busy (HyScanNmeaReceiverPrivate *priv,
+                               guint                      head,
+                               guint                     *busy)
+{
+  guint value = g_atomic_int_get (&priv->ring_busy);
+
+  *busy = head - ((head - (value >> BUSY_COUNT_BITS)) & BUSY_INDEX_MASK);
+
+  return value & BUSY_COUNT_MASK;
+}
+
+/* Функция проверяет возможность опубликовать сообщение с номером head
+ * и начать собирать следующее сообщение со смещения next. Для этого в
+ * буфере должно быть свободное место, следующее сообщение не должно быть
+ * занято потоком отправки, а место для сообщения максимального размера
+ * начиная с next не должно пересекаться с неотправленными сообщениями.
+ *
+ * Номер ring_tail считывается до ring_busy. Поток отправки публикует
+ * ring_busy до того, как сдвинуть ring_tail, поэтому если забранные им
+ * сообщения уже не видны по ring_tail, они видны по ring_busy. */
+static gboolean
+hyscan_nmea_receiver_has_space (HyScanNmeaReceiverPrivate *priv,
+                                guint                      head,
+                                gsize                      next)
+{
+  guint tail = g_atomic_int_get (&priv->ring_tail);
+  guint reading;
+  guint busy;
+  guint oldest;
+  gsize start;
+  gsize current;
+
+  if ((head - tail) >= (priv->n_buffers - 1))
+    return FALSE;
+
+  reading = hyscan_nmea_receiver_get_busy (priv, head, &busy);
+  if ((reading > 0) && ((head + 1 - priv->n_buffers - busy) < reading))
+    return FALSE;
+
+  /* Самое старое сообщение, которое занимает место в буфере. */
+  oldest = ((reading > 0) && ((head - busy) > (head - tail))) ? busy : tail;
+  start = priv->offsets[oldest & (priv->n_buffers - 1)];
+  current = priv->offsets[head & (priv->n_buffers - 1)];
+
+  /* Занятая часть буфера начинается со start и заканчивается сообщением
+   * head. Если она не переходит через конец буфера, место есть либо
+   * после сообщения head, либо в начале буфера до start. */
+  if (start <= current)
+    return (next > current) || (next + priv->slot_size <= start);
+
+  return (next > current) && (next + priv->slot_size <= start);
+}
+
+/* Функция обрабатывает переполнение кольцевого буфера согласно выбранной
+ * политике. Функция возвращает TRUE, если в буфере появилось место. */
+static gboolean
+hyscan_nmea_receiver_overflow (HyScanNmeaReceiverPrivate *priv,
+                               guint                      head,
+                               gsize                      next)
+{
+  guint tail = g_atomic_int_get (&priv->ring_tail);
+  gint64 deadline;
+
+  switch (g_atomic_int_get (&priv->overflow))
+    {
+    /* Отбрасываем самые старые сообщения, пока не освободится место.
+     * Если поток отправки успел забрать сообщение раньше, место уже
+     * освобождено. Пока поток отправки занят сообщениями, их место в
+     * буфере не освобождается, поэтому отбрасывание неотправленных
+     * сообщений помогает только при нехватке номеров сообщений. Иначе
+     * отбрасывается новый блок. */
+    case HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_OLDEST:
+      while (!hyscan_nmea_receiver_has_space (priv, head, next) && (head != tail))
+        {
+          guint busy;
+
+          if ((hyscan_nmea_receiver_get_busy (priv, head, &busy) > 0) &&
+              ((head - tail) < (priv->n_buffers - 1)))
+            {
+              break;
+            }
+
+          if (g_atomic_int_compare_and_exchange (&priv->ring_tail, tail, tail + 1))
+            g_atomic_int_inc (&priv->n_dropped);
+
+          tail = g_atomic_int_get (&priv->ring_tail);
+        }
+      break;
+
+    /* Ожидаем освобождения места, но не дольше заданного времени. */
+    case HYSCAN_NMEA_RECEIVER_OVERFLOW_BLOCK:
+      deadline = g_get_monotonic_time () + g_atomic_int_get (&priv->overflow_timeout);
 
-      g_rw_lock_writer_lock (&priv->lock);
-      hyscan_slice_pool_push (&priv->buffers, message);
-      g_rw_lock_writer_unlock (&priv->lock);
+      g_mutex_lock (&priv->wait_lock);
+      g_atomic_int_set (&priv->blocked, TRUE);
+
+      while (!hyscan_nmea_receiver_has_space (priv, head, next) &&
+             !g_atomic_int_get (&priv->terminate))
+        {
+          if (!g_cond_wait_until (&priv->space_cond, &priv->wait_lock, deadline))
+            break;
+        }
+
+      g_atomic_int_set (&priv->blocked, FALSE);
+      g_mutex_unlock (&priv->wait_lock);
+      break;
+
+    default:
+      break;
     }
 
-  return NULL;
+  return hyscan_nmea_receiver_has_space (priv, head, next);
+}
+
+/* Функция отправляет срочный блок из одной NMEA строки через буфер
+ * срочных сообщений. Блок копируется, поэтому разборщик продолжает
+ * собирать текущий блок на прежнем месте. Если буфер срочных сообщений
+ * заполнен, функция возвращает FALSE: срочные сообщения не ожидают места
+ * в буфере и не вытесняют друг друга. */
+static gboolean
+hyscan_nmea_receiver_push_urgent (HyScanNmeaReceiver          *receiver,
+                                  const HyScanNmeaParserBlock *block)
+{
+  HyScanNmeaReceiverPrivate *priv = receiver->priv;
+  HyScanNmeaReceiverMessage *message;
+  guint head = priv->urgent_head;
+  guint32 size = block->size + 1;
+
+  if (!priv->inline_delivery &&
+      ((head - (guint) g_atomic_int_get (&priv->urgent_tail)) >= N_URGENT_BUFFERS))
+    {
+      return FALSE;
+    }
+
+  message = hyscan_nmea_receiver_urgent_slot (priv, head);
+
+  memcpy (message->data, block->data, block->size);
+  if (priv->max_lines > 0)
+    memcpy (message->data + ((size + 3) & ~3), block->line_times, block->n_lines * sizeof (guint32));
+
+  message->time = block->time;
+  message->size = size;
+  message->n_lines = block->n_lines;
+  message->data[size - 1] = 0;
+
+  hyscan_nmea_parser_next (&priv->parser, NULL);
+
+  /* Отправляем сообщение из текущего потока. */
+  if (priv->inline_delivery)
+    {
+      hyscan_nmea_receiver_deliver (receiver, &message, 1, TRUE);
+
+      return TRUE;
+    }
+
+  /* Публикуем сообщение. */
+  g_atomic_int_set (&priv->urgent_head, head + 1);
+
+  /* Пробуждаем поток отправки, только если он ожидает данные. */
+  if (g_atomic_int_get (&priv->sleeping))
+    {
+      g_mutex_lock (&priv->wait_lock);
+      g_cond_signal (&priv->wait_cond);
+      g_mutex_unlock (&priv->wait_lock);
+    }
+
+  return TRUE;
+}
+
+/* Функция отправляет блок, собранный разборщиком, и, при необходимости,
+ * пробуждает поток отправки данных. Срочные блоки отправляются функцией
+ * hyscan_nmea_receiver_push_urgent.
+ *
+ * Сообщения собираются прямо в кольцевом буфере: сообщение с номером
+ * ring_head принадлежит писателю, поэтому опубликовано может быть не более
+ * n_buffers - 1 сообщений. Для собираемого сообщения резервируется место
+ * под сообщение максимального размера, но после отправки сообщение
+ * занимает в буфере только место под свои данные и таблицу времени приёма
+ * строк. Следующее сообщение начинается сразу за ним или, если до конца
+ * буфера недостаточно места, с начала буфера. Начатая NMEA строка,
+ * расположенная после сообщения, переносится разборщиком в начало
+ * следующего сообщения. Функция возвращает FALSE, если в буфере нет
+ * свободного места. В этом случае разборщик продолжает работу с текущим
+ * сообщением.
+ *
+ * В режиме синхронной отправки сообщение передаётся пользователю сразу,
+ * а место в буфере освобождается до возврата из функции. */
+static gboolean
+hyscan_nmea_receiver_push (HyScanNmeaReceiver          *receiver,
+                           const HyScanNmeaParserBlock *block)
+{
+  HyScanNmeaReceiverPrivate *priv = receiver->priv;
+  HyScanNmeaReceiverMessage *message;
+  HyScanNmeaReceiverMessage *next;
+  guint head = priv->ring_head;
+  guint32 size = block->size + 1;
+  gsize offset;
+
+  if (block->urgent)
+    return hyscan_nmea_receiver_push_urgent (receiver, block);
+
+  message = hyscan_nmea_receiver_slot (priv, head);
+
+  /* Смещение следующего сообщения. */
+  offset = priv->offsets[head & (priv->n_buffers - 1)] + sizeof (HyScanNmeaReceiverMessage) + size;
+  if (priv->max_lines > 0)
+    offset = ((offset + 3) & ~3) + block->n_lines * sizeof (guint32);
+  offset = (offset + sizeof (gint64) - 1) & ~(sizeof (gint64) - 1);
+  if (offset + priv->slot_size > priv->ring_size)
+    offset = 0;
+
+  if (!priv->inline_delivery &&
+      !hyscan_nmea_receiver_has_space (priv, head, offset) &&
+      !hyscan_nmea_receiver_overflow (priv, head, offset))
+    {
+      return FALSE;
+    }
+
+  next = (HyScanNmeaReceiverMessage *) (priv->ring + offset);
+
+  /* Начатая строка может перекрываться со своим новым местом. Она
+   * переносится до записи таблицы времени приёма строк на её место. */
+  hyscan_nmea_parser_next (&priv->parser, next->data);
+
+  if (priv->max_lines > 0)
+    memcpy (message->data + ((size + 3) & ~3), block->line_times, block->n_lines * sizeof (guint32));
+
+  message->time = block->time;
+  message->size = size;
+  message->n_lines = block->n_lines;
+  message->data[size - 1] = 0;
+
+  priv->offsets[(head + 1) & (priv->n_buffers - 1)] = offset;
+
+  /* Отправляем сообщение из текущего потока. */
+  if (priv->inline_delivery)
+    {
+      hyscan_nmea_receiver_deliver (receiver, &message, 1, FALSE);
+
+      priv->ring_head = priv->ring_tail = head + 1;
+
+      return TRUE;
+    }
+
+  /* Публикуем сообщение. */
+  g_atomic_int_set (&priv->ring_head, head + 1);
+
+  /* Пробуждаем поток отправки, только если он ожидает данные. */
+  if (g_atomic_int_get (&priv->sleeping))
+    {
+      g_mutex_lock (&priv->wait_lock);
+      g_cond_signal (&priv->wait_cond);
+      g_mutex_unlock (&priv->wait_lock);
+    }
+
+  return TRUE;
 }
 
 /**
@@ -270,6 +988,160 @@ hyscan_nmea_receiver_new (void)
   return g_object_new (HYSCAN_TYPE_NMEA_RECEIVER, NULL);
 }
 
+/**
+ * hyscan_nmea_receiver_get_context:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ *
+ * Функция возвращает контекст потока #HyScanNmeaReactor, в котором
+ * классы приёма данных должны регистрировать свои источники событий.
+ *
+ * Returns: (transfer none): #GMainContext.
+ */
+GMainContext *
+hyscan_nmea_receiver_get_context (HyScanNmeaReceiver *receiver)
+{
+  g_return_val_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver), NULL);
+
+  return receiver->priv->context;
+}
+
+/**
+ * hyscan_nmea_receiver_set_data_func:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @func: (nullable): функция обработки данных или NULL
+ * @user_data: пользовательские данные
+ *
+ * Функция устанавливает функцию обработки блоков NMEA данных. Функция
+ * вызывается в потоке отправки данных (или в потоке приёма, если
+ * установлено свойство "inline") перед отправкой сигнала
+ * #HyScanNmeaReceiver::nmea-data. Для отключения функции обработки
+ * необходимо передать NULL.
+ *
+ * Функцию обработки можно изменить из неё самой. При вызове из другого
+ * потока функция дожидается завершения текущего вызова функции обработки,
+ * поэтому после возврата предыдущая функция больше не будет вызвана.
+ */
+void
+hyscan_nmea_receiver_set_data_func (HyScanNmeaReceiver         *receiver,
+                                    HyScanNmeaReceiverDataFunc  func,
+                                    gpointer                    user_data)
+{
+  HyScanNmeaReceiverPrivate *priv;
+
+  g_return_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver));
+
+  priv = receiver->priv;
+
+  g_rec_mutex_lock (&priv->data_lock);
+  priv->data_func = func;
+  priv->data_user_data = user_data;
+  g_rec_mutex_unlock (&priv->data_lock);
+}
+
+/**
+ * hyscan_nmea_receiver_set_batch_func:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @func: (nullable): функция пакетной обработки данных или NULL
+ * @max_blocks: максимальное число блоков в пакете
+ * @user_data: пользовательские данные
+ *
+ * Функция устанавливает функцию пакетной обработки блоков NMEA данных.
+ * Поток отправки данных забирает из буфера все накопившиеся блоки, но не
+ * более @max_blocks, и передаёт их функции одним массивом. Функция
+ * вызывается перед функцией обработки данных и отправкой сигнала
+ * #HyScanNmeaReceiver::nmea-data для каждого из блоков.
+ *
+ * Число блоков в пакете ограничено значением 64. Пока блоки пакета не
+ * обработаны, их место в буфере остаётся занятым. Правила изменения
+ * функции аналогичны #hyscan_nmea_receiver_set_data_func.
+ */
+void
+hyscan_nmea_receiver_set_batch_func (HyScanNmeaReceiver          *receiver,
+                                     HyScanNmeaReceiverBatchFunc  func,
+                                     guint                        max_blocks,
+                                     gpointer                     user_data)
+{
+  HyScanNmeaReceiverPrivate *priv;
+
+  g_return_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver));
+
+  priv = receiver->priv;
+
+  g_rec_mutex_lock (&priv->data_lock);
+  priv->batch_func = func;
+  priv->batch_user_data = user_data;
+  g_atomic_int_set (&priv->batch_size, (func != NULL) ? CLAMP (max_blocks, 1, MAX_BATCH_SIZE) : 1);
+  g_rec_mutex_unlock (&priv->data_lock);
+}
+
+/**
+ * hyscan_nmea_receiver_set_overflow:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @overflow: политика обработки переполнения #HyScanNmeaReceiverOverflow
+ * @timeout: максимальное время ожидания места в буфере, с
+ *
+ * Функция задаёт поведение при заполнении буфера сообщений. Параметр
+ * @timeout используется только с политикой
+ * %HYSCAN_NMEA_RECEIVER_OVERFLOW_BLOCK. Если за это время место в буфере
+ * не освободилось, новый блок данных отбрасывается.
+ *
+ * Ожидание места в буфере задерживает поток приёма данных, а вместе с ним
+ * и все источники событий, зарегистрированные в этом потоке, в том числе
+ * источники других объектов. Поэтому время ожидания ограничено 5 мс.
+ */
+void
+hyscan_nmea_receiver_set_overflow (HyScanNmeaReceiver         *receiver,
+                                   HyScanNmeaReceiverOverflow  overflow,
+                                   gdouble                     timeout)
+{
+  HyScanNmeaReceiverPrivate *priv;
+
+  g_return_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver));
+
+  priv = receiver->priv;
+
+  timeout = CLAMP (timeout, 0.0, MAX_OVERFLOW_TIMEOUT);
+
+  g_atomic_int_set (&priv->overflow_timeout, (gint)(timeout * G_USEC_PER_SEC));
+  g_atomic_int_set (&priv->overflow, overflow);
+}
+
+/**
+ * hyscan_nmea_receiver_get_dropped:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ *
+ * Функция возвращает число блоков данных, отброшенных из-за переполнения
+ * буфера сообщений, с момента создания объекта.
+ *
+ * Returns: Число отброшенных блоков данных.
+ */
+guint
+hyscan_nmea_receiver_get_dropped (HyScanNmeaReceiver *receiver)
+{
+  g_return_val_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver), 0);
+
+  return g_atomic_int_get (&receiver->priv->n_dropped);
+}
+
+/**
+ * hyscan_nmea_receiver_get_n_sentences:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ *
+ * Функция возвращает число валидных NMEA строк, принятых с момента
+ * создания объекта. Строки, отброшенные фильтром или прореживанием,
+ * учитываются, поэтому по изменению этого числа можно судить о приёме
+ * данных, даже если блоки не отправляются.
+ *
+ * Returns: Число принятых NMEA строк.
+ */
+guint
+hyscan_nmea_receiver_get_n_sentences (HyScanNmeaReceiver *receiver)
+{
+  g_return_val_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver), 0);
+
+  return g_atomic_int_get (&receiver->priv->n_sentences);
+}
+
 /**
  * hyscan_nmea_receiver_skip_broken:
  * @receiver: указатель на #HyScanNmeaReceiver
@@ -287,6 +1159,174 @@ hyscan_nmea_receiver_skip_broken (HyScanNmeaReceiver *receiver,
   g_atomic_int_set (&receiver->priv->skip_broken, skip);
 }
 
+/**
+ * hyscan_nmea_receiver_set_predict_epoch:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @predict: признак отправки блока по последней строке эпохи
+ *
+ * Функция включает или отключает досрочную отправку блоков данных. Объект
+ * запоминает тип NMEA строки, которой завершается каждая эпоха, и число
+ * строк в эпохе. Если несколько эпох подряд завершались строкой одного
+ * типа с тем же номером, блок отправляется сразу после приёма такой
+ * строки, не дожидаясь строк следующей эпохи. Поэтому эпохи, которые
+ * завершаются несколькими строками одного типа, например GSV 1/3 - 3/3,
+ * не разделяются на части. Если порядок или число строк изменится,
+ * досрочная отправка прекращается до тех пор, пока не будет определён
+ * новый порядок. По умолчанию досрочная отправка выключена.
+ */
+void
+hyscan_nmea_receiver_set_predict_epoch (HyScanNmeaReceiver *receiver,
+                                        gboolean            predict)
+{
+  g_return_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver));
+
+  g_atomic_int_set (&receiver->priv->predict_epoch, predict);
+}
+
+/**
+ * hyscan_nmea_receiver_group_untimed:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @window: интервал группировки строк, с
+ * @n_sentences: максимальное число строк в блоке
+ *
+ * Функция задаёт группировку NMEA строк, из которых невозможно определить
+ * время, например DBT, DPT, HDT или THS. По умолчанию каждая такая строка
+ * отправляется отдельным блоком. Если @window больше нуля, строки,
+ * принятые в течение @window секунд после первой строки блока, объединяются
+ * в один блок. Если @n_sentences больше единицы, блок отправляется после
+ * приёма @n_sentences строк. Временем блока является время приёма его
+ * первой строки. Функция #hyscan_nmea_receiver_flush отправляет текущий
+ * блок независимо от этих ограничений, а отправка блока по отсутствию
+ * данных #hyscan_nmea_receiver_flush_idle их учитывает. Интервал ограничен
+ * 10 секундами.
+ */
+void
+hyscan_nmea_receiver_group_untimed (HyScanNmeaReceiver *receiver,
+                                    gdouble             window,
+                                    guint               n_sentences)
+{
+  g_return_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver));
+
+  window = CLAMP (window, 0.0, MAX_UNTIMED_WINDOW);
+
+  g_atomic_int_set (&receiver->priv->untimed_window, G_USEC_PER_SEC * window);
+  g_atomic_int_set (&receiver->priv->untimed_count, n_sentences);
+}
+
+/**
+ * hyscan_nmea_receiver_set_filter:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @patterns: (nullable) (array zero-terminated=1): шаблоны типов NMEA строк
+ * @allow: %TRUE - список разрешённых строк, %FALSE - запрещённых
+ *
+ * Функция задаёт фильтр NMEA строк по их типу. Формат шаблонов описан в
+ * #hyscan_nmea_parser_filter_compile. Строки, не прошедшие через фильтр,
+ * отбрасываются сразу после выделения из потока данных. Если @patterns
+ * равен NULL или не содержит шаблонов, фильтрация отключается. Новый
+ * фильтр начинает действовать со следующего вызова функций добавления
+ * данных.
+ *
+ * Returns: %TRUE если фильтр установлен, %FALSE если шаблоны некорректны.
+ * В этом случае действующий фильтр не изменяется.
+ */
+gboolean
+hyscan_nmea_receiver_set_filter (HyScanNmeaReceiver  *receiver,
+                                 const gchar * const *patterns,
+                                 gboolean             allow)
+{
+  HyScanNmeaReceiverPrivate *priv;
+  HyScanNmeaParserFilter filter;
+
+  g_return_val_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver), FALSE);
+
+  priv = receiver->priv;
+
+  if (!hyscan_nmea_parser_filter_compile (&filter, patterns, allow))
+    return FALSE;
+
+  g_mutex_lock (&priv->rules_lock);
+  priv->filter = filter;
+  g_atomic_int_set (&priv->filter_changed, TRUE);
+  g_mutex_unlock (&priv->rules_lock);
+
+  return TRUE;
+}
+
+/**
+ * hyscan_nmea_receiver_set_urgent:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @patterns: (nullable) (array zero-terminated=1): шаблоны типов срочных NMEA строк
+ *
+ * Функция задаёт типы срочных NMEA строк, например HDT, THS или PASHR.
+ * Формат шаблонов описан в #hyscan_nmea_parser_filter_compile. Срочные
+ * строки отправляются сразу после приёма отдельными блоками, минуя
+ * группировку по эпохам и очередь обычных блоков. Если @patterns равен
+ * NULL или не содержит шаблонов, срочных строк нет. Новые шаблоны начинают
+ * действовать со следующего вызова функций добавления данных.
+ *
+ * Returns: %TRUE если шаблоны установлены, %FALSE если шаблоны
+ * некорректны. В этом случае действующие шаблоны не изменяются.
+ */
+gboolean
+hyscan_nmea_receiver_set_urgent (HyScanNmeaReceiver  *receiver,
+                                 const gchar * const *patterns)
+{
+  HyScanNmeaReceiverPrivate *priv;
+  HyScanNmeaParserFilter urgent;
+
+  g_return_val_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver), FALSE);
+
+  priv = receiver->priv;
+
+  if (!hyscan_nmea_parser_filter_compile (&urgent, patterns, TRUE))
+    return FALSE;
+
+  g_mutex_lock (&priv->rules_lock);
+  priv->urgent = urgent;
+  g_atomic_int_set (&priv->urgent_changed, TRUE);
+  g_mutex_unlock (&priv->rules_lock);
+
+  return TRUE;
+}
+
+/**
+ * hyscan_nmea_receiver_set_decimation:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @rates: (array length=n_rates) (nullable): правила прореживания
+ * @n_rates: число правил
+ *
+ * Функция задаёт правила прореживания NMEA строк по их типу. Правила
+ * описаны в #hyscan_nmea_parser_decimation_compile. Строки прореживаются
+ * до группировки в блоки. Если @n_rates равно нулю, прореживание
+ * отключается. Новые правила начинают действовать со следующего вызова
+ * функций добавления данных.
+ *
+ * Returns: %TRUE если правила установлены, %FALSE если правила
+ * некорректны. В этом случае действующие правила не изменяются.
+ */
+gboolean
+hyscan_nmea_receiver_set_decimation (HyScanNmeaReceiver         *receiver,
+                                     const HyScanNmeaParserRate *rates,
+                                     guint                       n_rates)
+{
+  HyScanNmeaReceiverPrivate *priv;
+  HyScanNmeaParserDecimation decimation;
+
+  g_return_val_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver), FALSE);
+
+  priv = receiver->priv;
+
+  if (!hyscan_nmea_parser_decimation_compile (&decimation, rates, n_rates))
+    return FALSE;
+
+  g_mutex_lock (&priv->rules_lock);
+  priv->decimation = decimation;
+  g_atomic_int_set (&priv->decimation_changed, TRUE);
+  g_mutex_unlock (&priv->rules_lock);
+
+  return TRUE;
+}
+
 /**
  * hyscan_nmea_receiver_add_data:
  * @receiver: указатель на #HyScanNmeaReceiver
@@ -297,16 +1337,43 @@ hyscan_nmea_receiver_skip_broken (HyScanNmeaReceiver *receiver,
  * Функция обрабатывает принятые данные.
  *
  * Returns: %TRUE если по результатам обработки обнаружена валидная
- * NMEA строка, иначе %FALSE.
+ * NMEA строка, в том числе отброшенная фильтром, иначе %FALSE.
  */
 gboolean
 hyscan_nmea_receiver_add_data (HyScanNmeaReceiver *receiver,
                                gint64              time,
                                const gchar        *data,
                                guint32             size)
+{
+  return hyscan_nmea_receiver_add_chars (receiver, time, 0, data, size);
+}
+
+/**
+ * hyscan_nmea_receiver_add_chars:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @time: метка времени приёма последнего символа
+ * @char_time: время передачи одного символа, мкс
+ * @data: принятые данные
+ * @size: размер данных
+ *
+ * Функция обрабатывает блок последовательно принятых символов. Время
+ * приёма каждого символа определяется как @time - (@size - 1 - i) * @char_time,
+ * где i - индекс символа в блоке. Это позволяет сохранить точное время
+ * прихода символа '$' при чтении сразу всех накопленных данных.
+ *
+ * Returns: %TRUE если по результатам обработки обнаружена валидная
+ * NMEA строка, в том числе отброшенная фильтром, иначе %FALSE.
+ */
+gboolean
+hyscan_nmea_receiver_add_chars (HyScanNmeaReceiver *receiver,
+                                gint64              time,
+                                gint64              char_time,
+                                const gchar        *data,
+                                guint32             size)
 {
   HyScanNmeaReceiverPrivate *priv;
-  gboolean good_nmea = FALSE;
+  HyScanNmeaParserBlock block;
+  guint n_sentences;
   guint32 rxi;
 
   g_return_val_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver), FALSE);
@@ -315,189 +1382,68 @@ hyscan_nmea_receiver_add_data (HyScanNmeaReceiver *receiver,
 
   /* Если данные не приходили длительное время, очистим текущий буфер. */
   if (g_timer_elapsed (priv->timeout, NULL) > RX_TIMEOUT)
+    hyscan_nmea_parser_reset (&priv->parser);
+
+  /* Параметры разбора могут изменяться из других потоков. */
+  hyscan_nmea_parser_skip_broken (&priv->parser, g_atomic_int_get (&priv->skip_broken));
+  hyscan_nmea_parser_set_predict_epoch (&priv->parser, g_atomic_int_get (&priv->predict_epoch));
+  hyscan_nmea_parser_group_untimed (&priv->parser,
+                                    g_atomic_int_get (&priv->untimed_window),
+                                    g_atomic_int_get (&priv->untimed_count));
+
+  if (g_atomic_int_get (&priv->filter_changed) ||
+      g_atomic_int_get (&priv->decimation_changed) ||
+      g_atomic_int_get (&priv->urgent_changed))
     {
-      priv->message_time = 0;
-      priv->message_size = 0;
-      priv->string_size = 0;
-    }
+      g_mutex_lock (&priv->rules_lock);
 
-  /* Обрабатываем данные по отдельным символам. */
-  for (rxi = 0; rxi < size; rxi++)
-    {
-      gchar rx_data = data[rxi];
+      if (priv->filter_changed)
+        hyscan_nmea_parser_set_filter (&priv->parser, &priv->filter);
+      if (priv->decimation_changed)
+        hyscan_nmea_parser_set_decimation (&priv->parser, &priv->decimation);
+      if (priv->urgent_changed)
+        hyscan_nmea_parser_set_urgent (&priv->parser, &priv->urgent);
 
-      /* Время приёма начала строки. */
-      if (rx_data == '$')
-        priv->rx_time = time;
+      g_atomic_int_set (&priv->filter_changed, FALSE);
+      g_atomic_int_set (&priv->decimation_changed, FALSE);
+      g_atomic_int_set (&priv->urgent_changed, FALSE);
 
-      /* Фиксируем время начала приёма блока. */
-      if (priv->message_time == 0)
-        priv->message_time = priv->rx_time;
+      g_mutex_unlock (&priv->rules_lock);
+    }
 
-      /* Текущая обрабатываемая строка пустая и данные не являются началом строки. */
-      if ((priv->string_size == 0) && (rx_data != '$'))
-        continue;
+  n_sentences = hyscan_nmea_parser_get_n_sentences (&priv->parser);
 
-      /* Собираем строку до тех пор пока не встретится символ '\r'. */
-      if (rx_data != '\r')
+  /* Отправляем готовые блоки данных. Если в буфере нет места,
+   * блок отбрасывается. */
+  rxi = 0;
+  while (TRUE)
+    {
+      if (hyscan_nmea_parser_pull (&priv->parser, &block))
         {
-          /* Если строка слишком длинная, пропускаем её. */
-          if (priv->string_size > MAX_STRING_SIZE)
+          if (!hyscan_nmea_receiver_push (receiver, &block))
             {
-              priv->string_size = 0;
-              continue;
+              hyscan_nmea_parser_next (&priv->parser, NULL);
+              g_atomic_int_inc (&priv->n_dropped);
             }
 
-          /* Сохраняем текущий символ. */
-          priv->string [priv->string_size++] = rx_data;
-          priv->string [priv->string_size] = 0;
           continue;
         }
 
-      /* Строка собрана. */
-      else
-        {
-          gboolean send_block = FALSE;
-          gboolean bad_crc = FALSE;
-          guchar nmea_crc1 = 0;
-          guint nmea_crc2 = 255;
-          gint nmea_time = -1;
-          guint i;
-
-          /* NMEA строка не может быть короче 10 символов. */
-          if (priv->string_size < 10)
-            {
-              priv->string_size = 0;
-              continue;
-            }
-
-          /* Проверяем контрольную сумму NMEA строки. */
-          priv->string[priv->string_size] = 0;
-          for (i = 1; i < priv->string_size - 3; i++)
-            nmea_crc1 ^= priv->string[i];
-
-          /* Если контрольная сумма не совпадает, не используем время из это строки. */
-          if ((sscanf (priv->string + priv->string_size - 3, "*%02X", &nmea_crc2) != 1) ||
-              (nmea_crc1 != nmea_crc2))
-            {
-              bad_crc = TRUE;
-            }
-
-          /* Пропускаем "плохие" NMEA строки. */
-          if (g_atomic_int_get (&priv->skip_broken) && bad_crc)
-            {
-              priv->string_size = 0;
-              continue;
-            }
-
-          /* Признак корректной NMEA строки. */
-          good_nmea = TRUE;
-
-          /* Вытаскиваем время из стандартных NMEA строк. */
-          if ((g_str_has_prefix (priv->string + 3, "GGA") ||
-               g_str_has_prefix (priv->string + 3, "RMC") ||
-               g_str_has_prefix (priv->string + 3, "BWC") ||
-               g_str_has_prefix (priv->string + 3, "ZDA")) && !bad_crc)
-            {
-              gint hour, min, sec, msec;
-              gint n_fields;
-
-              /* Смещение до поля со временем во всех этих строках равно 7. */
-              n_fields = sscanf (priv->string + 7,"%2d%2d%2d.%d", &hour, &min, &sec, &msec);
-              if (n_fields == 3)
-                nmea_time = 1000 * (3600 * hour + 60 * min + sec);
-              else if (n_fields == 4)
-                nmea_time = 1000 * (3600 * hour + 60 * min + sec) + msec;
-              else
-                nmea_time = 0;
-            }
-
-          /* NMEA строки HyScan/Hydra. */
-          if ((g_str_has_prefix (priv->string + 3, "ACP") ||
-               g_str_has_prefix (priv->string + 3, "PTF") ||
-               g_str_has_prefix (priv->string + 3, "PTQ")) && !bad_crc)
-            {
-              if (sscanf (priv->string + 7,"%d", &nmea_time) != 1)
-                nmea_time = 0;
-            }
-
-          /* Если текущее время и время блока различаются, отправляем блок данных. */
-          if (nmea_time >= 0)
-            {
-              if ((priv->nmea_time > 0) && (priv->nmea_time != nmea_time))
-                send_block = TRUE;
-
-              priv->nmea_time = nmea_time;
-            }
-
-          /* Если в блоке больше нет места, отправляем блок. */
-          if ((priv->message_size + priv->string_size + 3) > MAX_MSG_SIZE)
-            send_block = TRUE;
-
-          /* Если нет возможности определить время из строки,
-           * отправляем строку без объединения в блок. */
-          if (priv->nmea_time == 0)
-            {
-              HyScanNmeaReceiverMessage *message;
-
-              priv->string[priv->string_size++] = '\r';
-              priv->string[priv->string_size++] = '\n';
-              priv->string[priv->string_size++] = 0;
-
-              g_rw_lock_writer_lock (&priv->lock);
-              message = hyscan_slice_pool_pop (&priv->buffers);
-              g_rw_lock_writer_unlock (&priv->lock);
-
-              if (message != NULL)
-                {
-                  message->time = priv->rx_time;
-                  message->size = priv->string_size;
-                  memcpy (message->data, priv->string, priv->string_size);
-                  g_async_queue_push (priv->queue, message);
-                }
-
-              priv->message_time = 0;
-              priv->message_size = 0;
-              priv->string_size = 0;
-              continue;
-            }
+      if (rxi >= size)
+        break;
 
-          /* Отправляем блок данных. */
-          if (send_block && (priv->message_size > 0))
-            {
-              HyScanNmeaReceiverMessage *message;
-
-              g_rw_lock_writer_lock (&priv->lock);
-              message = hyscan_slice_pool_pop (&priv->buffers);
-              g_rw_lock_writer_unlock (&priv->lock);
-
-              if (message != NULL)
-                {
-                  message->time = priv->message_time;
-                  message->size = priv->message_size + 1;
-                  memcpy (message->data, priv->message, priv->message_size + 1);
-                  g_async_queue_push (priv->queue, message);
-                }
-
-              priv->message_time = 0;
-              priv->message_size = 0;
-            }
-
-          /* Сохраняем строку в блоке. */
-          memcpy (priv->message + priv->message_size, priv->string, priv->string_size);
-          priv->message_size += priv->string_size;
-          priv->message [priv->message_size++] = '\r';
-          priv->message [priv->message_size++] = '\n';
-          priv->message [priv->message_size] = 0;
-
-          priv->string_size = 0;
-        }
+      rxi += hyscan_nmea_parser_push (&priv->parser, time, char_time, data + rxi, size - rxi);
     }
 
   if (size > 0)
     g_timer_start (priv->timeout);
 
-  return good_nmea;
+  /* Число принятых NMEA строк, включая отфильтрованные. */
+  n_sentences = hyscan_nmea_parser_get_n_sentences (&priv->parser) - n_sentences;
+  if (n_sentences > 0)
+    g_atomic_int_add (&priv->n_sentences, n_sentences);
+
+  return n_sentences > 0;
 }
 
 /**
@@ -512,32 +1458,64 @@ hyscan_nmea_receiver_flush (HyScanNmeaReceiver  *receiver,
                             gdouble              timeout)
 {
   HyScanNmeaReceiverPrivate *priv;
+  HyScanNmeaParserBlock block;
 
   g_return_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver));
 
   priv = receiver->priv;
 
-  if ((g_timer_elapsed (priv->timeout, NULL) > timeout) && (priv->message_size > 0))
+  if ((g_timer_elapsed (priv->timeout, NULL) > timeout) &&
+      hyscan_nmea_parser_flush (&priv->parser, &block))
     {
-      HyScanNmeaReceiverMessage *message;
+      /* Если в буфере нет места, в блок продолжают добавляться строки. */
+      hyscan_nmea_receiver_push (receiver, &block);
 
-      g_rw_lock_writer_lock (&priv->lock);
-      message = hyscan_slice_pool_pop (&priv->buffers);
-      g_rw_lock_writer_unlock (&priv->lock);
+      g_timer_start (priv->timeout);
+    }
+}
 
-      if (message != NULL)
-        {
-          message->time = priv->message_time;
-          message->size = priv->message_size + 1;
-          memcpy (message->data, priv->message, priv->message_size + 1);
-          g_async_queue_push (priv->queue, message);
+/**
+ * hyscan_nmea_receiver_flush_idle:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @time: текущее время, мкс
+ *
+ * Функция отправляет блок NMEA данных при отсутствии новых данных. В отличие
+ * от #hyscan_nmea_receiver_flush, функция учитывает группировку строк без
+ * времени, заданную #hyscan_nmea_receiver_group_untimed: такой блок
+ * отправляется не раньше окончания интервала группировки, а блок,
+ * собираемый только по числу строк, не отправляется. Время @time задаётся
+ * в единицах #g_get_monotonic_time, как и метки времени принятых данных.
+ *
+ * Returns: Время, в которое функцию необходимо вызвать повторно, или -1.
+ */
+gint64
+hyscan_nmea_receiver_flush_idle (HyScanNmeaReceiver *receiver,
+                                 gint64              time)
+{
+  HyScanNmeaReceiverPrivate *priv;
+  HyScanNmeaParserBlock block;
+  gint64 flush_time;
 
-          priv->message_time = 0;
-          priv->message_size = 0;
-        }
+  g_return_val_if_fail (HYSCAN_IS_NMEA_RECEIVER (receiver), -1);
+
+  priv = receiver->priv;
+
+  flush_time = hyscan_nmea_parser_get_flush_time (&priv->parser);
+  if (flush_time < 0)
+    return -1;
+
+  if (time < flush_time)
+    return flush_time;
+
+  if (hyscan_nmea_parser_flush (&priv->parser, &block))
+    {
+      /* Если в буфере нет места, в блок продолжают добавляться строки. */
+      hyscan_nmea_receiver_push (receiver, &block);
 
       g_timer_start (priv->timeout);
     }
+
+  return -1;
 }
 
 /**
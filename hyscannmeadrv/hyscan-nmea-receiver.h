@@ -35,10 +35,26 @@
 #ifndef __HYSCAN_NMEA_RECEIVER_H__
 #define __HYSCAN_NMEA_RECEIVER_H__
 
-#include <hyscan-types.h>
+#include <hyscan-nmea-reactor.h>
+#include <hyscan-nmea-parser.h>
 
 G_BEGIN_DECLS
 
+/**
+ * HyScanNmeaReceiverOverflow:
+ * @HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST: Отбрасывать новые блоки данных.
+ * @HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_OLDEST: Отбрасывать самые старые блоки данных.
+ * @HYSCAN_NMEA_RECEIVER_OVERFLOW_BLOCK: Ожидать освобождения места в течение заданного времени, не более 5 мс.
+ *
+ * Политики обработки переполнения буфера сообщений.
+ */
+typedef enum
+{
+  HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST,
+  HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_OLDEST,
+  HYSCAN_NMEA_RECEIVER_OVERFLOW_BLOCK
+} HyScanNmeaReceiverOverflow;
+
 #define HYSCAN_TYPE_NMEA_RECEIVER             (hyscan_nmea_receiver_get_type ())
 #define HYSCAN_NMEA_RECEIVER(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), HYSCAN_TYPE_NMEA_RECEIVER, HyScanNmeaReceiver))
 #define HYSCAN_IS_NMEA_RECEIVER(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HYSCAN_TYPE_NMEA_RECEIVER))
@@ -62,25 +78,149 @@ struct _HyScanNmeaReceiverClass
   GObjectClass parent_class;
 };
 
+/**
+ * HyScanNmeaReceiverDataFunc:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @time: метка времени приёма данных, мкс
+ * @data: NMEA данные
+ * @size: размер NMEA данных
+ * @user_data: пользовательские данные
+ *
+ * Функция обработки блока NMEA данных. Параметры аналогичны параметрам
+ * сигнала #HyScanNmeaReceiver::nmea-data.
+ */
+typedef void         (*HyScanNmeaReceiverDataFunc)             (HyScanNmeaReceiver      *receiver,
+                                                                gint64                   time,
+                                                                const gchar             *data,
+                                                                guint                    size,
+                                                                gpointer                 user_data);
+
+/**
+ * HyScanNmeaReceiverBlock:
+ * @time: метка времени приёма данных, мкс
+ * @data: NMEA данные
+ * @size: размер NMEA данных
+ * @line_times: (nullable): время приёма каждой NMEA строки относительно @time, мкс
+ * @n_lines: число элементов в @line_times
+ * @urgent: признак срочного блока
+ *
+ * Блок NMEA данных в пакете. Поля @time, @data и @size аналогичны
+ * параметрам сигнала #HyScanNmeaReceiver::nmea-data.
+ *
+ * Срочные блоки, см. #hyscan_nmea_receiver_set_urgent, могут быть
+ * отправлены раньше обычных блоков с меньшей меткой времени. Если
+ * получателю важен порядок меток времени, срочные блоки следует
+ * обрабатывать отдельно от обычных.
+ *
+ * Время приёма строк заполняется, только если при создании объекта
+ * установлено свойство "line-times", иначе @line_times равно NULL.
+ * Элемент с индексом i соответствует i-ой строке блока и определяется
+ * по времени приёма её символа '$'.
+ */
+typedef struct
+{
+  gint64                       time;
+  const gchar                 *data;
+  guint                        size;
+  const guint32               *line_times;
+  guint                        n_lines;
+  gboolean                     urgent;
+} HyScanNmeaReceiverBlock;
+
+/**
+ * HyScanNmeaReceiverBatchFunc:
+ * @receiver: указатель на #HyScanNmeaReceiver
+ * @blocks: массив блоков NMEA данных
+ * @n_blocks: число блоков в массиве
+ * @user_data: пользовательские данные
+ *
+ * Функция пакетной обработки блоков NMEA данных. Данные блоков остаются
+ * действительными только во время вызова функции.
+ */
+typedef void         (*HyScanNmeaReceiverBatchFunc)            (HyScanNmeaReceiver            *receiver,
+                                                                const HyScanNmeaReceiverBlock *blocks,
+                                                                guint                          n_blocks,
+                                                                gpointer                       user_data);
+
 HYSCAN_API
 GType                  hyscan_nmea_receiver_get_type           (void);
 
 HYSCAN_API
 HyScanNmeaReceiver *   hyscan_nmea_receiver_new                (void);
 
+HYSCAN_API
+GMainContext *         hyscan_nmea_receiver_get_context        (HyScanNmeaReceiver      *receiver);
+
+HYSCAN_API
+void                   hyscan_nmea_receiver_set_data_func      (HyScanNmeaReceiver      *receiver,
+                                                                HyScanNmeaReceiverDataFunc func,
+                                                                gpointer                 user_data);
+
+HYSCAN_API
+void                   hyscan_nmea_receiver_set_batch_func     (HyScanNmeaReceiver      *receiver,
+                                                                HyScanNmeaReceiverBatchFunc func,
+                                                                guint                    max_blocks,
+                                                                gpointer                 user_data);
+
+HYSCAN_API
+void                   hyscan_nmea_receiver_set_overflow       (HyScanNmeaReceiver      *receiver,
+                                                                HyScanNmeaReceiverOverflow overflow,
+                                                                gdouble                  timeout);
+
+HYSCAN_API
+guint                  hyscan_nmea_receiver_get_dropped        (HyScanNmeaReceiver      *receiver);
+
+HYSCAN_API
+guint                  hyscan_nmea_receiver_get_n_sentences    (HyScanNmeaReceiver      *receiver);
+
 HYSCAN_API
 void                   hyscan_nmea_receiver_skip_broken        (HyScanNmeaReceiver      *receiver,
                                                                 gboolean                 skip);
 
+HYSCAN_API
+void                   hyscan_nmea_receiver_set_predict_epoch  (HyScanNmeaReceiver      *receiver,
+                                                                gboolean                 predict);
+
+HYSCAN_API
+void                   hyscan_nmea_receiver_group_untimed      (HyScanNmeaReceiver      *receiver,
+                                                                gdouble                  window,
+                                                                guint                    n_sentences);
+
+HYSCAN_API
+gboolean               hyscan_nmea_receiver_set_filter         (HyScanNmeaReceiver      *receiver,
+                                                                const gchar * const     *patterns,
+                                                                gboolean                 allow);
+
+HYSCAN_API
+gboolean               hyscan_nmea_receiver_set_decimation     (HyScanNmeaReceiver      *receiver,
+                                                                const HyScanNmeaParserRate *rates,
+                                                                guint                    n_rates);
+
+HYSCAN_API
+gboolean               hyscan_nmea_receiver_set_urgent         (HyScanNmeaReceiver      *receiver,
+                                                                const gchar * const     *patterns);
+
 HYSCAN_API
 gboolean               hyscan_nmea_receiver_add_data           (HyScanNmeaReceiver      *receiver,
                                                                 gint64                   time,
                                                                 const gchar             *data,
                                                                 guint32                  size);
 
+HYSCAN_API
+gboolean               hyscan_nmea_receiver_add_chars          (HyScanNmeaReceiver      *receiver,
+                                                                gint64                   time,
+                                                                gint64                   char_time,
+                                                                const gchar             *data,
+                                                                guint32                  size);
+
 HYSCAN_API
 void                   hyscan_nmea_receiver_flush              (HyScanNmeaReceiver      *receiver,
                                                                 gdouble                  timeout);
+
+HYSCAN_API
+gint64                 hyscan_nmea_receiver_flush_idle         (HyScanNmeaReceiver      *receiver,
+                                                                gint64                   time);
+
 HYSCAN_API
 void                   hyscan_nmea_receiver_send_log           (HyScanNmeaReceiver      *receiver,
                                                                 gint64                   time,
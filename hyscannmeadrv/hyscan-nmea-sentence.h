@@ -0,0 +1,85 @@
+/* hyscan-nmea-sentence.h
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+#ifndef __HYSCAN_NMEA_SENTENCE_H__
+#define __HYSCAN_NMEA_SENTENCE_H__
+
+#include <hyscan-types.h>
+
+G_BEGIN_DECLS
+
+/* Идентификатор типа стандартной NMEA строки, например "GGA". */
+#define HYSCAN_NMEA_SENTENCE_KEY(a, b, c)  (((guint32)(guchar)(a) << 16) | \
+                                            ((guint32)(guchar)(b) << 8) | \
+                                            ((guint32)(guchar)(c)))
+
+/* Идентификатор строки производителя оборудования, например "$PGRM". */
+#define HYSCAN_NMEA_SENTENCE_PKEY(a, b, c) (((guint32)'P' << 24) | HYSCAN_NMEA_SENTENCE_KEY (a, b, c))
+
+HYSCAN_API
+guint8                 hyscan_nmea_sentence_xor                (const gchar           *data,
+                                                                gsize                  size);
+
+HYSCAN_API
+gint                   hyscan_nmea_sentence_hex_pair           (const gchar           *hex);
+
+HYSCAN_API
+gboolean               hyscan_nmea_sentence_check              (const gchar           *sentence,
+                                                                gsize                  size);
+
+HYSCAN_API
+const gchar *          hyscan_nmea_sentence_parse_int          (const gchar           *data,
+                                                                guint                  width,
+                                                                gint                  *value);
+
+HYSCAN_API
+gint                   hyscan_nmea_sentence_parse_time         (const gchar           *data);
+
+HYSCAN_API
+const gchar *          hyscan_nmea_sentence_parse_decimal      (const gchar           *data,
+                                                                gdouble               *value);
+
+HYSCAN_API
+const gchar *          hyscan_nmea_sentence_parse_coord        (const gchar           *data,
+                                                                gdouble               *value);
+
+HYSCAN_API
+guint32                hyscan_nmea_sentence_get_formatter      (const gchar           *sentence);
+
+HYSCAN_API
+gint                   hyscan_nmea_sentence_get_time           (const gchar           *sentence);
+
+G_END_DECLS
+
+#endif /* __HYSCAN_NMEA_SENTENCE_H__ */
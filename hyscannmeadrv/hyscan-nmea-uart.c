@@ -47,6 +47,14 @@
  * Если выбран режим автоматического определения скорости UART порта -
  * #HYSCAN_NMEA_UART_MODE_AUTO, принимаются только корректные NMEA строки.
  *
+ * Класс не создаёт собственного потока. Приём данных выполняется в потоке
+ * #HyScanNmeaReactor, который обрабатывает события только при поступлении
+ * данных или в момент отправки блока по таймауту. Частоту обработки событий
+ * порта можно узнать с помощью функции #hyscan_nmea_uart_get_wakeup_rate.
+ *
+ * При ошибке чтения из порта посылается сигнал "nmea-io-error", а чтение
+ * возобновляется через 100 мс.
+ *
  * Список UART портов, доступных в системе, можно получить с помощью функции
  * #hyscan_nmea_uart_list_devices.
  */
@@ -59,7 +67,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <termios.h>
-#include <sys/select.h>
+#include <glib-unix.h>
 
 #define HANDLE gint
 #define INVALID_HANDLE_VALUE -1
@@ -76,8 +84,15 @@
 #endif
 
 #define N_CHARS_TIMEOUT  25
-#define N_BUFFERS        16
-#define MAX_MSG_SIZE     4084
+#define RX_BUFFER_SIZE   4096
+#define AUTO_SPEED_TIME  2000000
+#define POLL_TIME        10000
+#define RETRY_TIME       100000
+
+/* Приведение обработчиков с другой сигнатурой для g_source_set_callback. */
+#ifndef G_SOURCE_FUNC
+#define G_SOURCE_FUNC(f) ((GSourceFunc) (void (*) (void)) (f))
+#endif
 
 enum
 {
@@ -89,18 +104,34 @@ typedef struct
 {
   HANDLE               fd;             /* Дескриптор открытого порта. */
   gdouble              timeout;        /* Таймаут при чтении, с. */
+  gint64               char_time;      /* Время передачи одного символа, мкс. */
 } UARTDevice;
 
-struct _HyScanNmeaUARTPrivate
+typedef struct
 {
-  GThread             *receiver;       /* Поток приёма данных из UART порта. */
+  HyScanNmeaUART      *uart;           /* Указатель на объект. */
+  const gchar         *path;           /* Путь к устройству. */
+  HyScanNmeaUARTMode   mode;           /* Режим работы. */
+  gboolean             status;         /* Результат конфигурации. */
+} UARTConfig;
 
-  gboolean             started;        /* Признак работы потока приёма данных. */
-  gboolean             configure;      /* Признак режима конфигурации UART порта. */
-  gboolean             terminate;      /* Признак необходимости завершения работы. */
+struct _HyScanNmeaUARTPrivate
+{
+  GMainContext        *context;        /* Контекст потока приёма данных. */
+  GSource             *io;             /* Источник событий приёма данных. */
+  GSource             *timer;          /* Таймер запланированных событий. */
 
   UARTDevice          *device;         /* Параметры UART устройства. */
   gboolean             auto_speed;     /* Признак автоматического выбора скорости приёма. */
+  HyScanNmeaUARTMode   cur_mode;       /* Текущий режим при автоматическом выборе скорости. */
+  gint64               flush_time;     /* Время отправки блока по таймауту. */
+  gint64               speed_time;     /* Время переключения скорости приёма. */
+  gint64               retry_time;     /* Время возобновления приёма после ошибки. */
+
+  gchar                rx_data[RX_BUFFER_SIZE];  /* Буфер приёма данных. */
+
+  guint                wakeups;        /* Число обработанных событий порта. */
+  GTimer              *wakeups_timer;  /* Таймер подсчёта частоты событий. */
 };
 
 static void            hyscan_nmea_uart_object_constructed     (GObject               *object);
@@ -112,10 +143,29 @@ static void            hyscan_nmea_uart_close                  (UARTDevice
 static gboolean        hyscan_nmea_uart_set_mode               (UARTDevice            *device,
                                                                 HyScanNmeaUARTMode     mode);
 
-static gchar           hyscan_nmea_uart_read                   (UARTDevice            *device,
-                                                                HyScanNmeaUART        *uart);
+static gssize          hyscan_nmea_uart_read                   (UARTDevice            *device,
+                                                                gchar                 *data,
+                                                                guint32                size);
+
+static void            hyscan_nmea_uart_schedule               (HyScanNmeaUARTPrivate *priv);
+static void            hyscan_nmea_uart_next_speed             (HyScanNmeaUARTPrivate *priv,
+                                                                gint64                 cur_time);
+
+static gboolean        hyscan_nmea_uart_receive                (HyScanNmeaUART        *uart);
+#ifdef G_OS_UNIX
+static gboolean        hyscan_nmea_uart_io                     (gint                   fd,
+                                                                GIOCondition           condition,
+                                                                gpointer               user_data);
+#endif
+#ifdef G_OS_WIN32
+static gboolean        hyscan_nmea_uart_poll                   (gpointer               user_data);
+#endif
+static gboolean        hyscan_nmea_uart_timer                  (gpointer               user_data);
 
-static gpointer        hyscan_nmea_uart_receiver               (gpointer               user_data);
+static void            hyscan_nmea_uart_watch                  (HyScanNmeaUART        *uart);
+static void            hyscan_nmea_uart_stop                   (HyScanNmeaUART        *uart);
+static gboolean        hyscan_nmea_uart_shutdown               (gpointer               user_data);
+static gboolean        hyscan_nmea_uart_configure              (gpointer               user_data);
 
 G_DEFINE_TYPE_WITH_PRIVATE (HyScanNmeaUART, hyscan_nmea_uart, HYSCAN_TYPE_NMEA_RECEIVER)
 
@@ -142,9 +192,17 @@ hyscan_nmea_uart_object_constructed (GObject *object)
 
   G_OBJECT_CLASS (hyscan_nmea_uart_parent_class)->constructed (object);
 
-  priv->started = TRUE;
+  priv->context = hyscan_nmea_receiver_get_context (HYSCAN_NMEA_RECEIVER (uart));
+  priv->flush_time = -1;
+  priv->speed_time = -1;
+  priv->retry_time = -1;
+
+  priv->wakeups_timer = g_timer_new ();
 
-  priv->receiver = g_thread_new ("uart-receiver", hyscan_nmea_uart_receiver, uart);
+  /* Таймер отправки блока и переключения скорости порта. */
+  priv->timer = hyscan_nmea_reactor_timer_new ();
+  g_source_set_callback (priv->timer, hyscan_nmea_uart_timer, uart, NULL);
+  g_source_attach (priv->timer, priv->context);
 }
 
 static void
@@ -153,10 +211,11 @@ hyscan_nmea_uart_object_finalize (GObject *object)
   HyScanNmeaUART *uart = HYSCAN_NMEA_UART (object);
   HyScanNmeaUARTPrivate *priv = uart->priv;
 
-  g_atomic_int_set (&priv->terminate, TRUE);
-  g_thread_join (priv->receiver);
+  /* Источники событий удаляются в потоке приёма данных, после
+   * этого обработчики событий гарантированно не будут вызваны. */
+  hyscan_nmea_reactor_invoke (priv->context, hyscan_nmea_uart_shutdown, uart);
 
-  hyscan_nmea_uart_close (priv->device);
+  g_timer_destroy (priv->wakeups_timer);
 
   G_OBJECT_CLASS (hyscan_nmea_uart_parent_class)->finalize (object);
 }
@@ -252,44 +311,33 @@ hyscan_nmea_uart_set_mode (UARTDevice         *device,
 
   /* Таймаут на N_CHARS_TIMEOUT символов. */
   device->timeout = baudrate * N_CHARS_TIMEOUT;
+  device->char_time = 1000000.0 * baudrate;
 
   return TRUE;
 }
 
-/* Функция считывает доступные данные из uart порта. */
-static gchar
-hyscan_nmea_uart_read (UARTDevice     *device,
-                       HyScanNmeaUART *uart)
+/* Функция считывает все накопленные в порту данные. Функция возвращает
+ * число считанных байт, 0 если данных нет или -1 при ошибке. */
+static gssize
+hyscan_nmea_uart_read (UARTDevice *device,
+                       gchar      *data,
+                       guint32     size)
 {
-  fd_set set;
-  struct timeval tv;
-  gchar data;
+  gssize readed;
 
   if ((device == NULL) || (device->fd == INVALID_HANDLE_VALUE))
-    return 0;
+    return -1;
 
-  /* Ожидаем новые данные в течение device->timeout. */
-  FD_ZERO (&set);
-  tv.tv_sec = 0;
-  tv.tv_usec = 100000 * device->timeout;
-  FD_SET (device->fd, &set);
-  if (select (device->fd + 1, &set, NULL, NULL, &tv) <= 0)
-    return  0;
+  readed = read (device->fd, data, size);
+  if (readed > 0)
+    return readed;
 
-  /* Считываем данные. */
-  if (read (device->fd, &data, 1) <= 0)
-    {
-      /* При ошибке чтения блокируем работу на 100 мс и посылаем сигнал "nmea-io-error". */
-      if (errno)
-        {
-          hyscan_nmea_receiver_io_error (HYSCAN_NMEA_RECEIVER (uart));
-          g_usleep (100000);
-        }
-
-      return 0;
-    }
+  /* Данных пока нет. */
+  if ((readed < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+    return 0;
 
-  return data;
+  /* Порт закрыт или устройство отключено. */
+  return -1;
 }
 #endif
 
@@ -379,122 +427,289 @@ hyscan_nmea_uart_set_mode (UARTDevice         *device,
   if (!SetCommState (device->fd, &dcb))
     return FALSE;
 
+  /* При ReadIntervalTimeout = MAXDWORD и нулевых остальных таймаутах
+   * ReadFile сразу возвращает все накопленные данные, не ожидая новых. */
   cto.ReadIntervalTimeout = MAXDWORD;
-  cto.ReadTotalTimeoutMultiplier = MAXDWORD;
-  cto.ReadTotalTimeoutConstant = 1000 * baudrate;
+  cto.ReadTotalTimeoutMultiplier = 0;
+  cto.ReadTotalTimeoutConstant = 0;
   if (!SetCommTimeouts (device->fd, &cto))
     return FALSE;
 
   /* Таймаут на N_CHARS_TIMEOUT символов. */
   device->timeout = baudrate * N_CHARS_TIMEOUT;
+  device->char_time = 1000000.0 * baudrate;
 
   return TRUE;
 }
 
-/* Функция считывает доступные данные из uart порта. */
-static gchar
-hyscan_nmea_uart_read (UARTDevice     *device,
-                       HyScanNmeaUART *uart)
+/* Функция считывает все накопленные в порту данные. Функция возвращает
+ * число считанных байт, 0 если данных нет или -1 при ошибке. */
+static gssize
+hyscan_nmea_uart_read (UARTDevice *device,
+                       gchar      *data,
+                       guint32     size)
 {
-  gchar data;
-  DWORD readed = -1;
+  DWORD readed = 0;
 
   if ((device == NULL) || (device->fd == INVALID_HANDLE_VALUE))
-    return 0;
+    return -1;
+
+  if (!ReadFile (device->fd, data, size, &readed, NULL))
+    return -1;
 
-  if (!ReadFile (device->fd, &data, 1, &readed, NULL) || (readed == 0))
+  return readed;
+}
+#endif
+/* Функция взводит таймер на ближайшее запланированное событие. */
+static void
+hyscan_nmea_uart_schedule (HyScanNmeaUARTPrivate *priv)
+{
+  gint64 ready_time = priv->flush_time;
+
+  if (priv->auto_speed && ((ready_time < 0) || (priv->speed_time < ready_time)))
+    ready_time = priv->speed_time;
+
+  if ((priv->retry_time > 0) && ((ready_time < 0) || (priv->retry_time < ready_time)))
+    ready_time = priv->retry_time;
+
+  g_source_set_ready_time (priv->timer, ready_time);
+}
+
+/* Функция переключает скорость порта в автоматическом режиме. Режимы
+ * перебираются каждые AUTO_SPEED_TIME мкс, до тех пор пока не будет
+ * найден рабочий. */
+static void
+hyscan_nmea_uart_next_speed (HyScanNmeaUARTPrivate *priv,
+                             gint64                 cur_time)
+{
+  if ((priv->cur_mode == HYSCAN_NMEA_UART_MODE_DISABLED) ||
+      (priv->cur_mode == HYSCAN_NMEA_UART_MODE_115200_8N1))
+    {
+      priv->cur_mode = HYSCAN_NMEA_UART_MODE_4800_8N1;
+    }
+  else
     {
-      /* При ошибке чтения посылаем сигнал "nmea-io-error". */
-      if (GetLastError ())
-        hyscan_nmea_receiver_io_error (HYSCAN_NMEA_RECEIVER (uart));
+      priv->cur_mode += 1;
+    }
 
-      return 0;
+  hyscan_nmea_uart_set_mode (priv->device, priv->cur_mode);
+  priv->speed_time = cur_time + AUTO_SPEED_TIME;
+}
+
+/* Функция считывает данные из порта и передаёт их на обработку.
+ * Функция возвращает FALSE, если приём данных необходимо прекратить. */
+static gboolean
+hyscan_nmea_uart_receive (HyScanNmeaUART *uart)
+{
+  HyScanNmeaReceiver *nmea = HYSCAN_NMEA_RECEIVER (uart);
+  HyScanNmeaUARTPrivate *priv = uart->priv;
+  gint64 rx_time;
+  gssize rx_size;
+
+  g_atomic_int_inc (&priv->wakeups);
+
+  /* Считываем сразу все данные, накопленные драйвером порта. */
+  rx_size = hyscan_nmea_uart_read (priv->device, priv->rx_data, RX_BUFFER_SIZE);
+
+  /* При ошибке чтения посылаем сигнал "nmea-io-error" и приостанавливаем
+   * приём на RETRY_TIME мкс. */
+  if (rx_size < 0)
+    {
+      g_clear_pointer (&priv->io, g_source_unref);
+      hyscan_nmea_receiver_io_error (nmea);
+
+      priv->retry_time = g_get_monotonic_time () + RETRY_TIME;
+      hyscan_nmea_uart_schedule (priv);
+
+      return FALSE;
     }
 
-  return data;
+  if (rx_size == 0)
+    return TRUE;
+
+  /* Отправляем данные на обработку. Время приёма каждого символа
+   * восстанавливается по скорости работы порта. */
+  rx_time = g_get_monotonic_time ();
+  if (hyscan_nmea_receiver_add_chars (nmea, rx_time, priv->device->char_time, priv->rx_data, rx_size))
+    priv->speed_time = rx_time + AUTO_SPEED_TIME;
+
+  /* Блок будет отправлен, если в течение времени передачи
+   * N_CHARS_TIMEOUT символов не будет новых данных. */
+  priv->flush_time = rx_time + G_USEC_PER_SEC * priv->device->timeout;
+  hyscan_nmea_uart_schedule (priv);
+
+  return TRUE;
+}
+
+#ifdef G_OS_UNIX
+/* Обработчик готовности порта к чтению. */
+static gboolean
+hyscan_nmea_uart_io (gint         fd,
+                     GIOCondition condition,
+                     gpointer     user_data)
+{
+  return hyscan_nmea_uart_receive (user_data);
+}
+#endif
+
+#ifdef G_OS_WIN32
+/* Обработчик периодического опроса порта. Для COM портов нет источника
+ * событий GLib, поэтому порт опрашивается каждые POLL_TIME мкс. */
+static gboolean
+hyscan_nmea_uart_poll (gpointer user_data)
+{
+  HyScanNmeaUART *uart = user_data;
+
+  if (!hyscan_nmea_uart_receive (uart))
+    return G_SOURCE_REMOVE;
+
+  g_source_set_ready_time (uart->priv->io, g_get_monotonic_time () + POLL_TIME);
+
+  return G_SOURCE_CONTINUE;
 }
 #endif
 
-/* Поток приёма данных. */
-static gpointer
-hyscan_nmea_uart_receiver (gpointer user_data)
+/* Обработчик запланированных событий: отправка блока по таймауту,
+ * переключение скорости порта в автоматическом режиме и возобновление
+ * приёма после ошибки чтения. */
+static gboolean
+hyscan_nmea_uart_timer (gpointer user_data)
 {
   HyScanNmeaUART *uart = user_data;
-  HyScanNmeaReceiver *nmea = user_data;
   HyScanNmeaUARTPrivate *priv = uart->priv;
+  gint64 cur_time = g_get_monotonic_time ();
+
+  g_atomic_int_inc (&priv->wakeups);
+
+  /* Блок из строк без времени может быть отправлен позже, по окончании
+   * интервала их группировки. */
+  if ((priv->flush_time > 0) && (cur_time >= priv->flush_time))
+    priv->flush_time = hyscan_nmea_receiver_flush_idle (HYSCAN_NMEA_RECEIVER (uart), cur_time);
 
-  HyScanNmeaUARTMode cur_mode = HYSCAN_NMEA_UART_MODE_DISABLED;
-  GTimer *timer = g_timer_new ();
+  if (priv->auto_speed && (cur_time >= priv->speed_time))
+    hyscan_nmea_uart_next_speed (priv, cur_time);
 
-  while (!g_atomic_int_get (&priv->terminate))
+  if ((priv->retry_time > 0) && (cur_time >= priv->retry_time))
     {
-      gint64 rx_time;
-      gchar rx_data;
+      priv->retry_time = -1;
+      hyscan_nmea_uart_watch (uart);
+    }
 
-      /* Режим конфигурации. */
-      if (g_atomic_int_get (&priv->configure))
-        {
-          /* Восстанавливаем режим работы и закрываем устройство. */
-          if (g_atomic_int_compare_and_exchange (&priv->started, TRUE, FALSE))
-            {
-              g_clear_pointer (&priv->device, hyscan_nmea_uart_close);
-              cur_mode = HYSCAN_NMEA_UART_MODE_DISABLED;
-            }
-
-          g_usleep (100000);
-          continue;
-        }
+  hyscan_nmea_uart_schedule (priv);
 
-      /* Конфигурация завершена. */
-      else
-        {
-          /* Устройство не выбрано. */
-          if (priv->device == NULL)
-            {
-              g_usleep (100000);
-              continue;
-            }
-
-          /* В автоматическом режиме переключаем режимы работы каждые 2 секунды,
-           * до тех пор пока не найдём рабочий. */
-          if ((priv->auto_speed) &&
-              ((cur_mode == HYSCAN_NMEA_UART_MODE_DISABLED) ||
-              (g_timer_elapsed (timer, NULL) > 2.0)))
-            {
-              if ((cur_mode == HYSCAN_NMEA_UART_MODE_DISABLED) ||
-                  (cur_mode == HYSCAN_NMEA_UART_MODE_115200_8N1))
-                {
-                  cur_mode = HYSCAN_NMEA_UART_MODE_4800_8N1;
-                }
-              else
-                {
-                  cur_mode += 1;
-                }
-
-              hyscan_nmea_uart_set_mode (priv->device, cur_mode);
-              g_timer_start (timer);
-            }
-        }
+  return G_SOURCE_CONTINUE;
+}
+
+/* Функция создаёт источник событий приёма данных из открытого порта. */
+static void
+hyscan_nmea_uart_watch (HyScanNmeaUART *uart)
+{
+  HyScanNmeaUARTPrivate *priv = uart->priv;
 
-      /* Пытаемся прочитать данные из порта. */
-      rx_data = hyscan_nmea_uart_read (priv->device, uart);
-      rx_time = g_get_monotonic_time ();
+#ifdef G_OS_UNIX
+  priv->io = g_unix_fd_source_new (priv->device->fd, G_IO_IN | G_IO_ERR | G_IO_HUP);
+  g_source_set_callback (priv->io, G_SOURCE_FUNC (hyscan_nmea_uart_io), uart, NULL);
+#endif
+#ifdef G_OS_WIN32
+  priv->io = hyscan_nmea_reactor_timer_new ();
+  g_source_set_callback (priv->io, hyscan_nmea_uart_poll, uart, NULL);
+  g_source_set_ready_time (priv->io, 0);
+#endif
+  g_source_attach (priv->io, priv->context);
+}
 
-      /* Отправляем данные на обработку. */
-      if (rx_data > 0)
-        {
-          if (hyscan_nmea_receiver_add_data (nmea, rx_time, &rx_data, 1))
-            g_timer_start (timer);
-        }
-      else
-        {
-          hyscan_nmea_receiver_flush (nmea, priv->device->timeout);
-        }
+/* Функция прекращает приём данных и закрывает устройство. */
+static void
+hyscan_nmea_uart_stop (HyScanNmeaUART *uart)
+{
+  HyScanNmeaUARTPrivate *priv = uart->priv;
+
+  if (priv->io != NULL)
+    {
+      g_source_destroy (priv->io);
+      g_clear_pointer (&priv->io, g_source_unref);
     }
 
-  g_timer_destroy (timer);
+  g_clear_pointer (&priv->device, hyscan_nmea_uart_close);
+
+  priv->auto_speed = FALSE;
+  priv->cur_mode = HYSCAN_NMEA_UART_MODE_DISABLED;
+  priv->flush_time = -1;
+  priv->speed_time = -1;
+  priv->retry_time = -1;
 
-  return NULL;
+  g_source_set_ready_time (priv->timer, -1);
+}
+
+/* Функция удаляет все источники событий. Выполняется в потоке приёма данных. */
+static gboolean
+hyscan_nmea_uart_shutdown (gpointer user_data)
+{
+  HyScanNmeaUART *uart = user_data;
+  HyScanNmeaUARTPrivate *priv = uart->priv;
+
+  hyscan_nmea_uart_stop (uart);
+
+  g_source_destroy (priv->timer);
+  g_clear_pointer (&priv->timer, g_source_unref);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Функция изменяет устройство и режим его работы. Выполняется в
+ * потоке приёма данных. */
+static gboolean
+hyscan_nmea_uart_configure (gpointer user_data)
+{
+  UARTConfig *config = user_data;
+  HyScanNmeaUART *uart = config->uart;
+  HyScanNmeaUARTPrivate *priv = uart->priv;
+
+  /* Закрываем текущее устройство. */
+  hyscan_nmea_uart_stop (uart);
+
+  /* Устройство отключено. */
+  if ((config->path == NULL) || (config->mode == HYSCAN_NMEA_UART_MODE_DISABLED))
+    {
+      config->status = TRUE;
+      return G_SOURCE_REMOVE;
+    }
+
+  /* Открываем устройство. */
+  priv->device = hyscan_nmea_uart_open (config->path);
+  if (priv->device == NULL)
+    {
+      g_warning ("HyScanNmeaUART: %s: can't open device", config->path);
+      return G_SOURCE_REMOVE;
+    }
+
+  /* В автоматическом режиме отключается приём "плохих" строк. */
+  if (config->mode == HYSCAN_NMEA_UART_MODE_AUTO)
+    {
+      priv->auto_speed = TRUE;
+      hyscan_nmea_receiver_skip_broken (HYSCAN_NMEA_RECEIVER (uart), TRUE);
+    }
+
+  /* Устанавливаем режим работы порта. */
+  if (!hyscan_nmea_uart_set_mode (priv->device, config->mode))
+    {
+      hyscan_nmea_uart_stop (uart);
+      g_warning ("HyScanNmeaUART: %s: can't set device mode", config->path);
+      return G_SOURCE_REMOVE;
+    }
+
+  /* Начинаем приём данных. */
+  hyscan_nmea_uart_watch (uart);
+
+  /* Выбираем первую скорость в автоматическом режиме. */
+  if (priv->auto_speed)
+    hyscan_nmea_uart_next_speed (priv, g_get_monotonic_time ());
+
+  hyscan_nmea_uart_schedule (priv);
+
+  config->status = TRUE;
+
+  return G_SOURCE_REMOVE;
 }
 
 /**
@@ -525,62 +740,48 @@ hyscan_nmea_uart_set_device (HyScanNmeaUART     *uart,
                              const gchar        *path,
                              HyScanNmeaUARTMode  mode)
 {
-  HyScanNmeaReceiver *nmea = HYSCAN_NMEA_RECEIVER (uart);
-  HyScanNmeaUARTPrivate *priv;
-  gboolean status = FALSE;
+  UARTConfig config;
 
   g_return_val_if_fail (HYSCAN_IS_UART (uart), FALSE);
 
-  priv = uart->priv;
-
-  /* Переходим в режим конфигурации. */
-  while (!g_atomic_int_compare_and_exchange (&priv->configure, FALSE, TRUE))
-    g_usleep (10000);
-  while (g_atomic_int_get (&priv->started))
-    g_usleep (10000);
+  config.uart = uart;
+  config.path = path;
+  config.mode = mode;
+  config.status = FALSE;
 
-  /* Устройство отключено. */
-  if (path == NULL || mode == HYSCAN_NMEA_UART_MODE_DISABLED)
-    {
-      status = TRUE;
-      goto exit;
-    }
+  hyscan_nmea_reactor_invoke (uart->priv->context, hyscan_nmea_uart_configure, &config);
 
-  /* Открываем устройство. */
-  priv->device = hyscan_nmea_uart_open (path);
-  if (priv->device == NULL)
-    {
-      g_warning ("HyScanNmeaUART: %s: can't open device", path);
-      goto exit;
-    }
+  return config.status;
+}
 
-  /* В автоматическом режиме отключается приём "плохих" строк. */
-  if (mode == HYSCAN_NMEA_UART_MODE_AUTO)
-    {
-      priv->auto_speed = TRUE;
-      hyscan_nmea_receiver_skip_broken (nmea, TRUE);
-    }
-  else
-    {
-      priv->auto_speed = FALSE;
-    }
+/**
+ * hyscan_nmea_uart_get_wakeup_rate:
+ * @uart: указатель на #HyScanNmeaUART
+ *
+ * Функция возвращает среднее число обработанных событий порта в секунду
+ * с момента предыдущего вызова этой функции (или с момента создания
+ * объекта). События обрабатываются только при поступлении данных и в
+ * моменты запланированных событий, поэтому для неактивного порта это
+ * значение должно быть близко к нулю.
+ *
+ * Returns: Число событий в секунду.
+ */
+gdouble
+hyscan_nmea_uart_get_wakeup_rate (HyScanNmeaUART *uart)
+{
+  HyScanNmeaUARTPrivate *priv;
+  gdouble elapsed;
+  guint wakeups;
 
-  /* Устанавливаем режим работы порта. */
-  if (!hyscan_nmea_uart_set_mode (priv->device, mode))
-    {
-      g_clear_pointer (&priv->device, hyscan_nmea_uart_close);
-      g_warning ("HyScanNmeaUART: %s: can't set device mode", path);
-      goto exit;
-    }
+  g_return_val_if_fail (HYSCAN_IS_UART (uart), 0.0);
 
-  status = TRUE;
+  priv = uart->priv;
 
-exit:
-  /* Завершаем конфигурацию. */
-  g_atomic_int_set (&priv->started, TRUE);
-  g_atomic_int_set (&priv->configure, FALSE);
+  wakeups = g_atomic_int_and (&priv->wakeups, 0);
+  elapsed = g_timer_elapsed (priv->wakeups_timer, NULL);
+  g_timer_start (priv->wakeups_timer);
 
-  return status;
+  return (elapsed > 0.0) ? wakeups / elapsed : 0.0;
 }
 
 /**
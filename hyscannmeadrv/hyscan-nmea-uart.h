@@ -114,6 +114,9 @@ gboolean               hyscan_nmea_uart_set_device       (HyScanNmeaUART
                                                           const gchar                   *path,
                                                           HyScanNmeaUARTMode             mode);
 
+HYSCAN_API
+gdouble                hyscan_nmea_uart_get_wakeup_rate  (HyScanNmeaUART                *uart);
+
 HYSCAN_API
 GList *                hyscan_nmea_uart_list_devices     (void);
 
@@ -44,6 +44,15 @@
  * IP адрес и UDP порт для приёма данных задаются с помощью функции
  * #hyscan_nmea_udp_set_address.
  *
+ * Класс не создаёт собственного потока. Приём данных выполняется в потоке
+ * #HyScanNmeaReactor только при поступлении датаграмм.
+ *
+ * Функция #hyscan_nmea_udp_set_flush управляет досрочной отправкой блоков
+ * данных. Если каждая датаграмма содержит законченную эпоху, блок можно
+ * отправлять сразу после обработки датаграммы. Кроме этого, можно задать
+ * время, по истечении которого блок отправляется, если новые датаграммы
+ * не поступали.
+ *
  * Список IP адресов доступных в системе можно узнать с помощью функции
  * #hyscan_nmea_udp_list_addresses.
  */
@@ -66,22 +75,47 @@
 #endif
 
 #define N_BUFFERS      64
+#define RX_BUFFER_SIZE 65536
+#define MAX_FLUSH_TIME 10.0
+#define MAX_DATAGRAMS  64
 
-struct _HyScanNmeaUDPPrivate
+/* Приведение обработчиков с другой сигнатурой для g_source_set_callback. */
+#ifndef G_SOURCE_FUNC
+#define G_SOURCE_FUNC(f) ((GSourceFunc) (void (*) (void)) (f))
+#endif
+
+typedef struct
 {
-  GThread             *receiver;       /* Поток приёма данных. */
+  HyScanNmeaUDP       *udp;            /* Указатель на объект. */
+  const gchar         *ip;             /* IP адрес. */
+  guint16              port;           /* UDP порт. */
+  gboolean             status;         /* Результат конфигурации. */
+} UDPConfig;
 
-  gboolean             started;        /* Признак работы потока приёма данных. */
-  gboolean             configure;      /* Признак режима конфигурации UART порта. */
-  gboolean             terminate;      /* Признак необходимости завершения работы. */
+struct _HyScanNmeaUDPPrivate
+{
+  GMainContext        *context;        /* Контекст потока приёма данных. */
+  GSource             *io;             /* Источник событий приёма данных. */
+  GSource             *timer;          /* Таймер отправки блока по таймауту. */
 
   GSocket             *socket;         /* Сокет для приёма данных по UDP. */
+  gchar               *rx_data;        /* Буфер приёма данных. */
+
+  gboolean             datagram_flush; /* Признак отправки блока после каждой датаграммы. */
+  gint                 flush_timeout;  /* Время отправки блока после приёма данных, мкс. */
 };
 
 static void            hyscan_nmea_udp_object_constructed      (GObject               *object);
 static void            hyscan_nmea_udp_object_finalize         (GObject               *object);
 
-static gpointer        hyscan_nmea_udp_receiver                (gpointer               user_data);
+static gboolean        hyscan_nmea_udp_receive                 (GSocket               *socket,
+                                                                GIOCondition           condition,
+                                                                gpointer               user_data);
+static gboolean        hyscan_nmea_udp_timer                   (gpointer               user_data);
+
+static void            hyscan_nmea_udp_stop                    (HyScanNmeaUDPPrivate  *priv);
+static gboolean        hyscan_nmea_udp_shutdown                (gpointer               user_data);
+static gboolean        hyscan_nmea_udp_configure               (gpointer               user_data);
 
 G_DEFINE_TYPE_WITH_PRIVATE (HyScanNmeaUDP, hyscan_nmea_udp, HYSCAN_TYPE_NMEA_RECEIVER)
 
@@ -108,9 +142,13 @@ hyscan_nmea_udp_object_constructed (GObject *object)
 
   G_OBJECT_CLASS (hyscan_nmea_udp_parent_class)->constructed (object);
 
-  priv->started = TRUE;
+  priv->context = hyscan_nmea_receiver_get_context (HYSCAN_NMEA_RECEIVER (udp));
+  priv->rx_data = g_malloc (RX_BUFFER_SIZE);
 
-  priv->receiver = g_thread_new ("udp-receiver", hyscan_nmea_udp_receiver, udp);
+  /* Таймер отправки блока. */
+  priv->timer = hyscan_nmea_reactor_timer_new ();
+  g_source_set_callback (priv->timer, hyscan_nmea_udp_timer, udp, NULL);
+  g_source_attach (priv->timer, priv->context);
 }
 
 static void
@@ -119,138 +157,140 @@ hyscan_nmea_udp_object_finalize (GObject *object)
   HyScanNmeaUDP *udp = HYSCAN_NMEA_UDP (object);
   HyScanNmeaUDPPrivate *priv = udp->priv;
 
-  g_atomic_int_set (&priv->terminate, TRUE);
-  g_thread_join (priv->receiver);
+  /* Источник событий удаляется в потоке приёма данных, после
+   * этого обработчик событий гарантированно не будет вызван. */
+  hyscan_nmea_reactor_invoke (priv->context, hyscan_nmea_udp_shutdown, priv);
 
-  g_clear_object (&priv->socket);
+  g_free (priv->rx_data);
 
   G_OBJECT_CLASS (hyscan_nmea_udp_parent_class)->finalize (object);
 }
 
-/* Поток приёма данных. */
-static gpointer
-hyscan_nmea_udp_receiver (gpointer user_data)
+/* Обработчик готовности сокета к чтению. За один вызов считывается не более
+ * MAX_DATAGRAMS датаграмм, остальные будут прочитаны при следующем вызове,
+ * чтобы не задерживать другие источники событий потока приёма. */
+static gboolean
+hyscan_nmea_udp_receive (GSocket      *socket,
+                         GIOCondition  condition,
+                         gpointer      user_data)
 {
   HyScanNmeaUDP *udp = user_data;
   HyScanNmeaReceiver *nmea = user_data;
   HyScanNmeaUDPPrivate *priv = udp->priv;
 
-  gchar rx_data[65536];
+  gboolean datagram_flush = g_atomic_int_get (&priv->datagram_flush);
+  gint flush_timeout = g_atomic_int_get (&priv->flush_timeout);
   gssize rx_size;
   gint64 rx_time;
+  gint64 last_time = -1;
+  guint n_datagrams = 0;
 
-  while (!g_atomic_int_get (&priv->terminate))
+  do
     {
-      /* Режим конфигурации. */
-      if (g_atomic_int_get (&priv->configure))
+      /* Время приёма данных. */
+      rx_time = g_get_monotonic_time ();
+
+      /* Приём данных и обработка. */
+      rx_size = g_socket_receive (socket, priv->rx_data, RX_BUFFER_SIZE - 1, NULL, NULL);
+      if (rx_size > 0)
         {
-          g_clear_object (&priv->socket);
+          hyscan_nmea_receiver_add_data (nmea, rx_time, priv->rx_data, rx_size);
 
-          /* Ждём завершения конфигурации. */
-          g_atomic_int_set (&priv->started, FALSE);
-          g_usleep (100000);
-          continue;
+          /* Датаграмма завершает блок данных. */
+          if (datagram_flush)
+            hyscan_nmea_receiver_flush (nmea, -1.0);
+
+          last_time = rx_time;
         }
+    }
+  while ((rx_size > 0) && (++n_datagrams < MAX_DATAGRAMS));
 
-      /* Конфигурация завершена. */
-      else
-        {
-          /* Адрес не установлен. */
-          if (priv->socket == NULL)
-            {
-              g_usleep (100000);
-              continue;
-            }
+  /* Блок будет отправлен, если в течение flush_timeout не будет новых данных. */
+  if ((last_time > 0) && (flush_timeout > 0))
+    g_source_set_ready_time (priv->timer, last_time + flush_timeout);
 
-          /* Ожидаем данные. */
-          if (!g_socket_condition_timed_wait (priv->socket, G_IO_IN, 100000, NULL, NULL))
-            continue;
+  return G_SOURCE_CONTINUE;
+}
 
-          /* Время приёма данных. */
-          rx_time = g_get_monotonic_time ();
+/* Обработчик таймера отправки блока. Блок из строк без времени может
+ * быть отправлен позже, по окончании интервала их группировки. */
+static gboolean
+hyscan_nmea_udp_timer (gpointer user_data)
+{
+  HyScanNmeaUDP *udp = user_data;
+  gint64 ready_time;
 
-          /* Приём данных и обработка. */
-          rx_size = g_socket_receive (priv->socket, rx_data, sizeof (rx_data) - 1, NULL, NULL);
-          if (rx_size > 0)
-            hyscan_nmea_receiver_add_data (nmea, rx_time, rx_data, rx_size);
-        }
-    }
+  ready_time = hyscan_nmea_receiver_flush_idle (HYSCAN_NMEA_RECEIVER (udp), g_get_monotonic_time ());
+  g_source_set_ready_time (udp->priv->timer, ready_time);
 
-  return NULL;
+  return G_SOURCE_CONTINUE;
 }
 
-/**
- * hyscan_nmea_udp_new:
- *
- * Функция создаёт новый объект #HyScanNmeaUDP.
- *
- * Returns: #HyScanNmeaUDP. Для удаления #g_object_unref.
- */
-HyScanNmeaUDP *
-hyscan_nmea_udp_new (void)
+/* Функция прекращает приём данных и закрывает сокет. */
+static void
+hyscan_nmea_udp_stop (HyScanNmeaUDPPrivate *priv)
 {
-  return g_object_new (HYSCAN_TYPE_NMEA_UDP, NULL);
+  if (priv->io != NULL)
+    {
+      g_source_destroy (priv->io);
+      g_clear_pointer (&priv->io, g_source_unref);
+    }
+
+  g_clear_object (&priv->socket);
+
+  g_source_set_ready_time (priv->timer, -1);
 }
 
-/**
- * hyscan_nmea_udp_set_address:
- * @udp: указатель на #HyScanNmeaUDP
- * @ip: IP адрес
- * @port: UDP порт
- *
- * Функция устанавливает IP адрес и номер UDP порта для приёма данных.
- * В качестве IP адреса могут быть переданы специальные названия "any"
- * и "loopback", которые используются для выбора всех IP v4 адресов и
- * loopback адреса соответственно.
- *
- * Returns: %TRUE если команда выполнена успешно, иначе %FALSE.
- */
-gboolean
-hyscan_nmea_udp_set_address (HyScanNmeaUDP *udp,
-                             const gchar   *ip,
-                             guint16        port)
+/* Функция удаляет источники событий. Выполняется в потоке приёма данных. */
+static gboolean
+hyscan_nmea_udp_shutdown (gpointer user_data)
 {
-  HyScanNmeaUDPPrivate *priv;
+  HyScanNmeaUDPPrivate *priv = user_data;
 
-  GSocketAddress *address = NULL;
-  gboolean status = FALSE;
+  hyscan_nmea_udp_stop (priv);
 
-  g_return_val_if_fail (HYSCAN_IS_NMEA_UDP (udp), FALSE);
+  g_source_destroy (priv->timer);
+  g_clear_pointer (&priv->timer, g_source_unref);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Функция изменяет адрес приёма данных. Выполняется в потоке приёма данных. */
+static gboolean
+hyscan_nmea_udp_configure (gpointer user_data)
+{
+  UDPConfig *config = user_data;
+  HyScanNmeaUDP *udp = config->udp;
+  HyScanNmeaUDPPrivate *priv = udp->priv;
 
-  priv = udp->priv;
+  GSocketAddress *address = NULL;
 
-  /* Переходим в режим конфигурации. */
-  while (!g_atomic_int_compare_and_exchange (&priv->configure, FALSE, TRUE))
-    g_usleep (10000);
-  while (g_atomic_int_get (&priv->started))
-    g_usleep (10000);
+  /* Закрываем предыдущий сокет приёма данных. */
+  hyscan_nmea_udp_stop (priv);
 
   /* Устройство отключено. */
-  if (ip == NULL || port < 1024)
+  if (config->ip == NULL || config->port < 1024)
     {
-      status = TRUE;
-      goto exit;
+      config->status = TRUE;
+      return G_SOURCE_REMOVE;
     }
 
-  /* Закрываем предыдущий сокет приёма данных. */
-  g_clear_object (&priv->socket);
-
   /* Адрес подключения. */
-  if (g_strcmp0 (ip, "any") == 0)
+  if (g_strcmp0 (config->ip, "any") == 0)
     {
       GInetAddress *inet_addr = g_inet_address_new_any (G_SOCKET_FAMILY_IPV4);
-      address = g_inet_socket_address_new (inet_addr, port);
+      address = g_inet_socket_address_new (inet_addr, config->port);
       g_object_unref (inet_addr);
     }
-  else if (g_strcmp0 (ip, "loopback") == 0)
+  else if (g_strcmp0 (config->ip, "loopback") == 0)
     {
       GInetAddress *inet_addr = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
-      address = g_inet_socket_address_new (inet_addr, port);
+      address = g_inet_socket_address_new (inet_addr, config->port);
       g_object_unref (inet_addr);
     }
   else
     {
-      address = g_inet_socket_address_new_from_string (ip, port);
+      address = g_inet_socket_address_new_from_string (config->ip, config->port);
     }
 
   if (address == NULL)
@@ -264,27 +304,105 @@ hyscan_nmea_udp_set_address (HyScanNmeaUDP *udp,
   if (priv->socket == NULL)
     goto exit;
 
+  /* Сокет не блокирует поток приёма данных. */
+  g_socket_set_blocking (priv->socket, FALSE);
+
   /* Размер приёмного буфера. */
-  status = g_socket_set_option (priv->socket, SOL_SOCKET, SO_RCVBUF, N_BUFFERS * 4096, NULL);
-  if (!status)
+  if (!g_socket_set_option (priv->socket, SOL_SOCKET, SO_RCVBUF, N_BUFFERS * 4096, NULL))
     {
       g_clear_object (&priv->socket);
       goto exit;
     }
 
   /* Привязка к рабочему адресу и порту. */
-  status = g_socket_bind (priv->socket, address, FALSE, NULL);
-  if (!status)
-    g_clear_object (&priv->socket);
+  if (!g_socket_bind (priv->socket, address, FALSE, NULL))
+    {
+      g_clear_object (&priv->socket);
+      goto exit;
+    }
+
+  /* Начинаем приём данных. */
+  priv->io = g_socket_create_source (priv->socket, G_IO_IN, NULL);
+  g_source_set_callback (priv->io, G_SOURCE_FUNC (hyscan_nmea_udp_receive), udp, NULL);
+  g_source_attach (priv->io, priv->context);
+
+  config->status = TRUE;
 
 exit:
   g_clear_object (&address);
 
-  /* Завершаем конфигурацию. */
-  g_atomic_int_set (&priv->started, TRUE);
-  g_atomic_int_set (&priv->configure, FALSE);
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * hyscan_nmea_udp_new:
+ *
+ * Функция создаёт новый объект #HyScanNmeaUDP.
+ *
+ * Returns: #HyScanNmeaUDP. Для удаления #g_object_unref.
+ */
+HyScanNmeaUDP *
+hyscan_nmea_udp_new (void)
+{
+  return g_object_new (HYSCAN_TYPE_NMEA_UDP, NULL);
+}
+
+/**
+ * hyscan_nmea_udp_set_address:
+ * @udp: указатель на #HyScanNmeaUDP
+ * @ip: IP адрес
+ * @port: UDP порт
+ *
+ * Функция устанавливает IP адрес и номер UDP порта для приёма данных.
+ * В качестве IP адреса могут быть переданы специальные названия "any"
+ * и "loopback", которые используются для выбора всех IP v4 адресов и
+ * loopback адреса соответственно.
+ *
+ * Returns: %TRUE если команда выполнена успешно, иначе %FALSE.
+ */
+gboolean
+hyscan_nmea_udp_set_address (HyScanNmeaUDP *udp,
+                             const gchar   *ip,
+                             guint16        port)
+{
+  UDPConfig config;
+
+  g_return_val_if_fail (HYSCAN_IS_NMEA_UDP (udp), FALSE);
+
+  config.udp = udp;
+  config.ip = ip;
+  config.port = port;
+  config.status = FALSE;
+
+  hyscan_nmea_reactor_invoke (udp->priv->context, hyscan_nmea_udp_configure, &config);
+
+  return config.status;
+}
+
+/**
+ * hyscan_nmea_udp_set_flush:
+ * @udp: указатель на #HyScanNmeaUDP
+ * @datagram: признак отправки блока после каждой датаграммы
+ * @timeout: время ожидания новых данных, с
+ *
+ * Функция задаёт условия досрочной отправки блока данных. Если @datagram
+ * равен %TRUE, блок отправляется после обработки каждой датаграммы, при
+ * этом незавершённая NMEA строка переносится в следующий блок. Если
+ * @timeout больше нуля, блок отправляется, если в течение этого времени
+ * не было новых датаграмм. Время ограничено 10 секундами. По умолчанию
+ * досрочная отправка отключена.
+ */
+void
+hyscan_nmea_udp_set_flush (HyScanNmeaUDP *udp,
+                           gboolean       datagram,
+                           gdouble        timeout)
+{
+  g_return_if_fail (HYSCAN_IS_NMEA_UDP (udp));
+
+  timeout = CLAMP (timeout, 0.0, MAX_FLUSH_TIME);
 
-  return status;
+  g_atomic_int_set (&udp->priv->datagram_flush, datagram);
+  g_atomic_int_set (&udp->priv->flush_timeout, G_USEC_PER_SEC * timeout);
 }
 
 /**
@@ -73,6 +73,11 @@ gboolean               hyscan_nmea_udp_set_address     (HyScanNmeaUDP         *u
                                                         const gchar           *ip,
                                                         guint16                port);
 
+HYSCAN_API
+void                   hyscan_nmea_udp_set_flush       (HyScanNmeaUDP         *udp,
+                                                        gboolean               datagram,
+                                                        gdouble                timeout);
+
 HYSCAN_API
 gchar **               hyscan_nmea_udp_list_addresses  (void);
 
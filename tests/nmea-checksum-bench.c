@@ -0,0 +1,184 @@
+/* nmea-checksum-bench.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* Тест сравнивает скорость проверки контрольной суммы NMEA строк функцией
+ * hyscan_nmea_sentence_check с побайтным вычислением и разбором
+ * контрольной суммы через sscanf. Проверка выполняется для строк типичной
+ * длины (80 байт) и строк максимальной длины (253 байта). */
+
+#include <hyscan-nmea-sentence.h>
+#include <string.h>
+#include <stdio.h>
+
+#define N_SENTENCES 64
+
+/* Функция формирует NMEA строки заданной длины (без символов "\r\n"). */
+static gchar **
+make_sentences (guint length)
+{
+  gchar **sentences = g_new0 (gchar *, N_SENTENCES + 1);
+  guint i, j;
+
+  for (i = 0; i < N_SENTENCES; i++)
+    {
+      gchar *sentence = g_malloc (length + 1);
+      guchar crc = 0;
+
+      memcpy (sentence, "$GPXXX,", 7);
+      for (j = 7; j < length - 3; j++)
+        sentence[j] = g_random_int_range (0, 2) ? g_random_int_range ('0', '9' + 1) : ',';
+
+      for (j = 1; j < length - 3; j++)
+        crc ^= sentence[j];
+
+      g_snprintf (sentence + length - 3, 4, "*%02X", crc);
+      sentences[i] = sentence;
+    }
+
+  return sentences;
+}
+
+/* Проверка контрольной суммы побайтно и через sscanf. */
+static gboolean
+check_scanf (const gchar *sentence,
+             gsize        size)
+{
+  guchar crc1 = 0;
+  guint crc2 = 255;
+  gsize i;
+
+  for (i = 1; i < size - 3; i++)
+    crc1 ^= sentence[i];
+
+  if (sscanf (sentence + size - 3, "*%02X", &crc2) != 1)
+    return FALSE;
+
+  return crc1 == crc2;
+}
+
+/* Функция возвращает число проверенных строк в секунду. */
+static gdouble
+run (gchar    **sentences,
+     guint      length,
+     guint      n_sentences,
+     gboolean   use_scanf)
+{
+  GTimer *timer;
+  gdouble elapsed;
+  guint n_good = 0;
+  guint i;
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < n_sentences; i++)
+    {
+      const gchar *sentence = sentences[i % N_SENTENCES];
+
+      if (use_scanf)
+        n_good += check_scanf (sentence, length);
+      else
+        n_good += hyscan_nmea_sentence_check (sentence, length);
+    }
+
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  if (n_good != n_sentences)
+    g_error ("checksum mismatch");
+
+  return n_sentences / elapsed;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gint n_sentences = 10000000;
+  guint lengths[] = { 80, 253 };
+  guint i;
+
+  /* Разбор командной строки. */
+  {
+    gchar **args;
+    GError *error = NULL;
+    GOptionContext *context;
+    GOptionEntry entries[] =
+      {
+        { "sentences", 'n', 0, G_OPTION_ARG_INT, &n_sentences, "Number of sentences", NULL },
+        { NULL }
+      };
+
+#ifdef G_OS_WIN32
+    args = g_win32_get_command_line ();
+#else
+    args = g_strdupv (argv);
+#endif
+
+    context = g_option_context_new ("");
+    g_option_context_set_help_enabled (context, TRUE);
+    g_option_context_add_main_entries (context, entries, NULL);
+    g_option_context_set_ignore_unknown_options (context, FALSE);
+    if (!g_option_context_parse_strv (context, &args, &error))
+      {
+        g_print ("%s\n", error->message);
+        return -1;
+      }
+
+    if (n_sentences <= 0)
+      {
+        g_print ("%s", g_option_context_get_help (context, FALSE, NULL));
+        return 0;
+      }
+
+    g_option_context_free (context);
+    g_strfreev (args);
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (lengths); i++)
+    {
+      gchar **sentences = make_sentences (lengths[i]);
+      gdouble scanf_rate;
+      gdouble check_rate;
+
+      scanf_rate = run (sentences, lengths[i], n_sentences, TRUE);
+      check_rate = run (sentences, lengths[i], n_sentences, FALSE);
+
+      g_print ("%3u bytes: sscanf %.2f Msentences/s, check %.2f Msentences/s\n",
+               lengths[i], scanf_rate / 1e6, check_rate / 1e6);
+
+      g_strfreev (sentences);
+    }
+
+  return 0;
+}
@@ -0,0 +1,325 @@
+/* nmea-drv-fields-test.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* Тест проверяет отправку разобранных значений полей драйвером NMEA
+ * датчика. Эпохи NMEA строк отправляются драйверу через UDP порт на
+ * локальный адрес, каждая эпоха в отдельной датаграмме. Драйвер
+ * запускается без отправки разобранных значений и с ней. В обоих случаях
+ * основной датчик должен передать одни и те же NMEA строки с возрастающими
+ * метками времени, а во втором случае датчик разобранных значений должен
+ * передать для каждой эпохи запись HyScanNmeaFields с временем эпохи и
+ * меткой времени её блока NMEA строк. */
+
+#include <hyscan-nmea-driver.h>
+#include <hyscan-nmea-fields.h>
+#include <hyscan-nmea-sentence.h>
+#include <hyscan-sensor.h>
+#include <hyscan-buffer.h>
+#include <gio/gio.h>
+#include <string.h>
+
+#define N_EPOCHS       50
+#define EPOCH_PERIOD   20000
+#define START_TIMEOUT  500000
+#define STOP_TIMEOUT   500000
+
+/* Данные, принятые от драйвера. */
+typedef struct
+{
+  GMutex       lock;                           /* Блокировка. */
+  const gchar *fields_id;                      /* Название датчика разобранных значений. */
+  GString     *nmea;                           /* NMEA строки основного датчика. */
+  gint64       times[N_EPOCHS];                /* Метки времени блоков NMEA строк. */
+  guint        n_blocks;                       /* Число блоков NMEA строк. */
+  guint        n_fields;                       /* Число записей разобранных значений. */
+  gboolean     status;                         /* Признак корректности данных. */
+} TestData;
+
+/* Функция формирует NMEA строки эпохи с номером epoch. */
+static gchar *
+make_epoch (guint epoch)
+{
+  const gchar *formats[] =
+  {
+    "GPGGA,%s,5540.1234,N,03730.5678,E,1,08,0.9,150.0,M,14.0,M,,",
+    "GPRMC,%s,A,5540.1234,N,03730.5678,E,0.5,54.7,191119,,,A"
+  };
+  GString *text = g_string_new (NULL);
+  gchar time[16];
+  guint i;
+
+  g_snprintf (time, sizeof (time), "1200%02u.%02u", epoch / 100, epoch % 100);
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++)
+    {
+      gchar *body = g_strdup_printf (formats[i], time);
+
+      g_string_append_printf (text, "$%s*%02X\r\n", body,
+                              hyscan_nmea_sentence_xor (body, strlen (body)));
+      g_free (body);
+    }
+
+  return g_string_free (text, FALSE);
+}
+
+/* Данные от датчиков. */
+static void
+data_cb (HyScanSensor *sensor,
+         const gchar  *name,
+         gint          source,
+         gint64        time,
+         HyScanBuffer *buffer,
+         gpointer      user_data)
+{
+  TestData *data = user_data;
+  HyScanDataType type;
+  const gchar *values;
+  guint32 size;
+
+  values = hyscan_buffer_get (buffer, &type, &size);
+
+  g_mutex_lock (&data->lock);
+
+  /* NMEA строки основного датчика. */
+  if (g_strcmp0 (name, HYSCAN_NMEA_DRIVER_DEFAULT_DEV_ID) == 0)
+    {
+      if ((source != HYSCAN_SOURCE_NMEA) || (type != HYSCAN_DATA_STRING) ||
+          (data->n_blocks >= N_EPOCHS) ||
+          ((data->n_blocks > 0) && (time <= data->times[data->n_blocks - 1])))
+        {
+          g_print ("unexpected nmea block %u\n", data->n_blocks);
+          data->status = FALSE;
+        }
+      else
+        {
+          g_string_append_len (data->nmea, values, size);
+          data->times[data->n_blocks++] = time;
+        }
+    }
+
+  /* Разобранные значения полей. */
+  else if ((data->fields_id != NULL) && (g_strcmp0 (name, data->fields_id) == 0))
+    {
+      HyScanNmeaFields fields;
+      guint epoch = data->n_fields + 1;
+
+      if ((type != HYSCAN_DATA_BLOB) || (size != sizeof (fields)) ||
+          (data->n_fields >= data->n_blocks) || (time != data->times[data->n_fields]))
+        {
+          g_print ("unexpected fields record %u\n", data->n_fields);
+          data->status = FALSE;
+        }
+      else
+        {
+          memcpy (&fields, values, sizeof (fields));
+
+          if (!(fields.mask & HYSCAN_NMEA_FIELDS_TIME) ||
+              (fields.time != 12 * 3600 * (gint64) G_USEC_PER_SEC + epoch * 10000))
+            {
+              g_print ("fields record %u: wrong time\n", data->n_fields);
+              data->status = FALSE;
+            }
+
+          data->n_fields += 1;
+        }
+    }
+
+  else
+    {
+      g_print ("data from unknown sensor %s\n", name);
+      data->status = FALSE;
+    }
+
+  g_mutex_unlock (&data->lock);
+}
+
+/* Функция подключает драйвер к UDP порту port, отправляет ему эпохи NMEA
+ * строк и сохраняет принятые данные в data. */
+static gboolean
+run (gint      port,
+     gboolean  decode_fields,
+     TestData *data)
+{
+  HyScanNmeaDriver *driver;
+  HyScanParamList *params;
+  GSocketAddress *address;
+  GInetAddress *inet_addr;
+  GSocket *socket;
+  gchar *fields_id;
+  guint i;
+
+  fields_id = decode_fields ? g_strconcat (HYSCAN_NMEA_DRIVER_DEFAULT_DEV_ID,
+                                           HYSCAN_NMEA_DRIVER_FIELDS_SUFFIX, NULL) : NULL;
+
+  g_mutex_init (&data->lock);
+  data->fields_id = fields_id;
+  data->nmea = g_string_new (NULL);
+  data->n_blocks = 0;
+  data->n_fields = 0;
+  data->status = TRUE;
+
+  /* Драйвер принимает данные на всех адресах, каждая датаграмма
+   * является блоком данных. */
+  params = hyscan_param_list_new ();
+  hyscan_param_list_set_enum (params, "/udp/address", 0);
+  hyscan_param_list_set_integer (params, "/udp/port", port);
+  hyscan_param_list_set_boolean (params, "/udp/datagram", TRUE);
+  hyscan_param_list_set_boolean (params, "/delivery/fields", decode_fields);
+
+  driver = hyscan_nmea_driver_new (HYSCAN_NMEA_DRIVER_UDP_URI, params);
+  g_object_unref (params);
+  if (driver == NULL)
+    {
+      g_print ("can't create driver\n");
+      g_free (fields_id);
+      return FALSE;
+    }
+
+  g_signal_connect (driver, "sensor-data", G_CALLBACK (data_cb), data);
+
+  hyscan_sensor_set_enable (HYSCAN_SENSOR (driver), HYSCAN_NMEA_DRIVER_DEFAULT_DEV_ID, TRUE);
+  if ((fields_id != NULL) && !hyscan_sensor_set_enable (HYSCAN_SENSOR (driver), fields_id, TRUE))
+    {
+      g_print ("no fields sensor\n");
+      data->status = FALSE;
+    }
+
+  /* Ожидаем подключения драйвера к порту. */
+  g_usleep (START_TIMEOUT);
+
+  /* Отправляем эпохи NMEA строк. */
+  inet_addr = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  address = g_inet_socket_address_new (inet_addr, port);
+  socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM, G_SOCKET_PROTOCOL_DEFAULT, NULL);
+
+  for (i = 0; (socket != NULL) && (i < N_EPOCHS); i++)
+    {
+      gchar *epoch = make_epoch (i + 1);
+
+      g_socket_send_to (socket, address, epoch, strlen (epoch), NULL, NULL);
+      g_free (epoch);
+
+      g_usleep (EPOCH_PERIOD);
+    }
+
+  g_usleep (STOP_TIMEOUT);
+
+  g_clear_object (&socket);
+  g_object_unref (address);
+  g_object_unref (inet_addr);
+  g_object_unref (driver);
+
+  if ((data->n_blocks != N_EPOCHS) || (decode_fields && (data->n_fields != N_EPOCHS)))
+    {
+      g_print ("%u nmea blocks, %u fields records of %u epochs\n",
+               data->n_blocks, data->n_fields, N_EPOCHS);
+      data->status = FALSE;
+    }
+
+  g_mutex_clear (&data->lock);
+  g_free (fields_id);
+
+  return data->status;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gint port = 10100;
+  TestData plain;
+  TestData fields;
+  gboolean status = TRUE;
+
+  /* Разбор командной строки. */
+  {
+    gchar **args;
+    GError *error = NULL;
+    GOptionContext *context;
+    GOptionEntry entries[] =
+      {
+        { "port", 'p', 0, G_OPTION_ARG_INT, &port, "First udp port (default: 10100)", NULL },
+        { NULL }
+      };
+
+#ifdef G_OS_WIN32
+    args = g_win32_get_command_line ();
+#else
+    args = g_strdupv (argv);
+#endif
+
+    context = g_option_context_new ("");
+    g_option_context_set_help_enabled (context, TRUE);
+    g_option_context_add_main_entries (context, entries, NULL);
+    g_option_context_set_ignore_unknown_options (context, FALSE);
+    if (!g_option_context_parse_strv (context, &args, &error))
+      {
+        g_print ("%s\n", error->message);
+        return -1;
+      }
+
+    if ((port < 1024) || (port > 65534))
+      {
+        g_print ("%s", g_option_context_get_help (context, FALSE, NULL));
+        return 0;
+      }
+
+    g_option_context_free (context);
+    g_strfreev (args);
+  }
+
+  if (!run (port, FALSE, &plain))
+    {
+      g_print ("driver failed without fields\n");
+      status = FALSE;
+    }
+
+  if (!run (port + 1, TRUE, &fields))
+    {
+      g_print ("driver failed with fields\n");
+      status = FALSE;
+    }
+
+  /* Поток NMEA строк не зависит от отправки разобранных значений. */
+  if (!g_string_equal (plain.nmea, fields.nmea))
+    {
+      g_print ("nmea data differs\n");
+      status = FALSE;
+    }
+
+  g_string_free (plain.nmea, TRUE);
+  g_string_free (fields.nmea, TRUE);
+
+  return status ? 0 : -1;
+}
@@ -53,11 +53,13 @@ status_check (gpointer data)
   HyScanParamList *list = hyscan_param_list_new ();
   GList *status_enums = hyscan_data_schema_enum_get_values (schema, HYSCAN_DEVICE_STATUS_ENUM);
   const gchar *status_id = "/state/"HYSCAN_NMEA_DRIVER_DEFAULT_DEV_ID"/status";
+  const gchar *dropped_id = "/state/"HYSCAN_NMEA_DRIVER_DEFAULT_DEV_ID"/dropped";
 
   while (!g_atomic_int_get (&shutdown))
     {
       hyscan_param_list_clear (list);
       hyscan_param_list_add (list, status_id);
+      hyscan_param_list_add (list, dropped_id);
       if (hyscan_param_get (param, list))
         {
           GList *link = status_enums;
@@ -76,7 +78,8 @@ status_check (gpointer data)
               link = g_list_next (link);
             }
 
-          g_print ("Sensor status: %s\n", status_str);
+          g_print ("Sensor status: %s, dropped blocks: %" G_GINT64_FORMAT "\n",
+                   status_str, hyscan_param_list_get_integer (list, dropped_id));
         }
 
       g_usleep (1000000);
@@ -132,6 +135,7 @@ main (int    argc,
   gchar *uart_mode = NULL;
   gchar *udp_address = NULL;
   gint udp_port = 0;
+  gboolean inline_delivery = FALSE;
   gchar *URI = NULL;
 
   HyScanDriver *driver;
@@ -155,6 +159,7 @@ main (int    argc,
         { "uart-mode", 'm', 0, G_OPTION_ARG_STRING, &uart_mode, "UART mode", NULL },
         { "udp-address", 'h', 0, G_OPTION_ARG_STRING, &udp_address, "UDP address", NULL },
         { "udp-port", 'p', 0, G_OPTION_ARG_INT, &udp_port, "UDP port", NULL },
+        { "inline", 'n', 0, G_OPTION_ARG_NONE, &inline_delivery, "Deliver data from the receiving thread", NULL },
         { NULL }
       };
 
@@ -409,6 +414,10 @@ main (int    argc,
         hyscan_param_list_set_integer (params, "/udp/port", udp_port);
     }
 
+  /* Отправка данных из потока приёма. */
+  if (inline_delivery)
+    hyscan_param_list_set_boolean (params, "/delivery/inline", TRUE);
+
   /* Проверяем параметры подключения к датчику. */
   if (!hyscan_discover_check (HYSCAN_DISCOVER (driver), uri, params))
     g_error ("Unknown sensor uri %s", uri);
@@ -0,0 +1,159 @@
+/* nmea-fields-test.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* Тест проверяет разбор значений полей NMEA строк функцией
+ * hyscan_nmea_fields_parse. Для каждого блока NMEA данных задаются
+ * ожидаемые признаки разобранных полей и их значения. Также проверяется,
+ * что строки с ошибкой контрольной суммы и недостоверные значения не
+ * учитываются, а функция hyscan_nmea_fields_parse_sentence сообщает о
+ * разборе значений из повторной строки. */
+
+#include <hyscan-nmea-fields.h>
+#include <string.h>
+
+#define EPSILON 1e-9
+
+/* Блоки NMEA данных и ожидаемые значения. */
+static const struct
+{
+  const gchar      *data;
+  HyScanNmeaFields  fields;
+} blocks[] =
+{
+  {
+    "$GPGGA,123519.50,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*6C\r\n",
+    { HYSCAN_NMEA_FIELDS_TIME | HYSCAN_NMEA_FIELDS_POSITION | HYSCAN_NMEA_FIELDS_ALTITUDE |
+      HYSCAN_NMEA_FIELDS_QUALITY | HYSCAN_NMEA_FIELDS_HDOP,
+      1, 45319500000, 48.1173, 11.0 + 31.0 / 60.0, 545.4, 0.0, 0.0, 0.0, 0.9 }
+  },
+  {
+    "$GNRMC,123519,A,4807.038,S,01131.000,W,022.4,084.4,230394,003.1,W*7B\r\n"
+    "$GPHDT,274.07,T*03\r\n",
+    { HYSCAN_NMEA_FIELDS_TIME | HYSCAN_NMEA_FIELDS_POSITION | HYSCAN_NMEA_FIELDS_SPEED |
+      HYSCAN_NMEA_FIELDS_TRACK | HYSCAN_NMEA_FIELDS_HEADING,
+      0, 45319000000, -48.1173, -(11.0 + 31.0 / 60.0), 0.0, 22.4 * 1852.0 / 3600.0, 84.4, 274.07, 0.0 }
+  },
+  {
+    "$GNGNS,014035.00,4332.69262,S,17235.48549,E,RR,13,0.9,25.63,11.24,,*70\r\n"
+    "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48\r\n",
+    { HYSCAN_NMEA_FIELDS_TIME | HYSCAN_NMEA_FIELDS_POSITION | HYSCAN_NMEA_FIELDS_ALTITUDE |
+      HYSCAN_NMEA_FIELDS_SPEED | HYSCAN_NMEA_FIELDS_TRACK | HYSCAN_NMEA_FIELDS_HDOP,
+      0, 6035000000, -(43.0 + 32.69262 / 60.0), 172.0 + 35.48549 / 60.0, 25.63,
+      5.5 * 1852.0 / 3600.0, 54.7, 0.0, 0.9 }
+  },
+  {
+    "$GPGLL,4916.45,N,12311.12,W,225444,A,*1D\r\n"
+    "$HETHS,123.4,V*3E\r\n",
+    { HYSCAN_NMEA_FIELDS_TIME | HYSCAN_NMEA_FIELDS_POSITION,
+      0, 82484000000, 49.0 + 16.45 / 60.0, -(123.0 + 11.12 / 60.0), 0.0, 0.0, 0.0, 0.0, 0.0 }
+  },
+  {
+    "$GPGGA,002153.000,,,,,0,00,,,M,,M,,*7D\r\n"
+    "$GPRMC,002153.000,V,,,,,,,,,,N*48\r\n"
+    "$HETHS,123.4,A*29\r\n",
+    { HYSCAN_NMEA_FIELDS_TIME | HYSCAN_NMEA_FIELDS_QUALITY | HYSCAN_NMEA_FIELDS_HEADING,
+      0, 1313000000, 0.0, 0.0, 0.0, 0.0, 0.0, 123.4, 0.0 }
+  },
+  {
+    "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*48\r\n"
+    "$GPHDT,274.07,T",
+    { 0 }
+  }
+};
+
+/* Функция сравнивает разобранные значения с ожидаемыми. */
+static gboolean
+check_fields (const HyScanNmeaFields *fields,
+              const HyScanNmeaFields *expected)
+{
+  return (fields->mask == expected->mask) &&
+         (fields->quality == expected->quality) &&
+         (fields->time == expected->time) &&
+         (ABS (fields->latitude - expected->latitude) < EPSILON) &&
+         (ABS (fields->longitude - expected->longitude) < EPSILON) &&
+         (ABS (fields->altitude - expected->altitude) < EPSILON) &&
+         (ABS (fields->speed - expected->speed) < EPSILON) &&
+         (ABS (fields->track - expected->track) < EPSILON) &&
+         (ABS (fields->heading - expected->heading) < EPSILON) &&
+         (ABS (fields->hdop - expected->hdop) < EPSILON);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  guint n_errors = 0;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (blocks); i++)
+    {
+      HyScanNmeaFields fields;
+      gsize size = strlen (blocks[i].data) + 1;
+
+      hyscan_nmea_fields_parse (&fields, blocks[i].data, size);
+
+      if (!check_fields (&fields, &blocks[i].fields))
+        {
+          g_print ("fields mismatch in block %u: mask 0x%02x, quality %d, time %" G_GINT64_FORMAT ", "
+                   "position %.9f %.9f, altitude %.3f, speed %.3f, track %.3f, heading %.3f, hdop %.3f\n",
+                   i, fields.mask, fields.quality, fields.time,
+                   fields.latitude, fields.longitude, fields.altitude,
+                   fields.speed, fields.track, fields.heading, fields.hdop);
+          n_errors += 1;
+        }
+    }
+
+  /* Повторная строка с уже разобранными значениями также разбирается. */
+  {
+    const gchar *sentence = "$GPGGA,123519.50,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*6C";
+    HyScanNmeaFields fields;
+
+    memset (&fields, 0, sizeof (fields));
+
+    if (!hyscan_nmea_fields_parse_sentence (&fields, sentence, strlen (sentence)) ||
+        !hyscan_nmea_fields_parse_sentence (&fields, sentence, strlen (sentence)))
+      {
+        g_print ("repeated sentence is not parsed\n");
+        n_errors += 1;
+      }
+  }
+
+  if (n_errors > 0)
+    {
+      g_print ("%u errors\n", n_errors);
+      return -1;
+    }
+
+  return 0;
+}
@@ -0,0 +1,574 @@
+/* nmea-framing-test.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* Тест сравнивает выделение NMEA строк из потока и их группировку в блоки
+ * разборщиком HyScanNmeaParser с посимвольной обработкой, которая
+ * использовалась до перехода на поиск символов '$' и '\r' функцией memchr.
+ * Посимвольная обработка воспроизведена в тесте без изменений, контрольная
+ * сумма и время строк определяются функциями hyscan_nmea_sentence_*, чтобы
+ * сравнивалось только выделение строк.
+ *
+ * Сравниваются метки времени, размер и содержимое всех блоков. Данные
+ * передаются участками случайного размера, с временем приёма символов и
+ * без него, с пропуском битых строк и без него, с большим и маленьким
+ * размером блока. Проверяются фрагмент записи реального приёмника, записи
+ * из файлов, указанных в командной строке, и случайные потоки, в которых
+ * встречаются слишком длинные строки, символы '$' внутри строк, символы
+ * '\r' без '\n', строки с неверной контрольной суммой и мусор. */
+
+#include <hyscan-nmea-parser.h>
+#include <hyscan-nmea-sentence.h>
+#include <string.h>
+
+#define MIN_STRING_SIZE 10
+#define MAX_BLOCK_SIZE  4084
+#define MIN_BLOCK_SIZE  256
+#define MAX_CHUNK_SIZE  4096
+#define CHAR_TIME       87
+
+/* Посимвольный разборщик. */
+typedef struct
+{
+  gchar       *message;                        /* Собираемый блок. */
+  guint32      message_size;                   /* Размер блока. */
+  guint        string_size;                    /* Размер NMEA строки. */
+  guint        max_size;                       /* Максимальный размер блока. */
+
+  gint64       rx_time;                        /* Метка времени приёма начала строки. */
+  gint64       message_time;                   /* Метка времени блока. */
+  gint         nmea_time;                      /* NMEA время блока. */
+
+  gboolean     skip_broken;                    /* Признак пропуска битых NMEA строк. */
+
+  GString     *blocks;                         /* Отправленные блоки. */
+} Reference;
+
+/* Фрагмент записи NMEA строк GNSS приёмника. */
+static const gchar recorded[] =
+  "$GNRMC,104501.00,A,5540.12345,N,03730.56789,E,0.512,54.70,191119,,,A*46\r\n"
+  "$GNVTG,54.70,T,,M,0.512,N,0.948,K,A*16\r\n"
+  "$GNGGA,104501.00,5540.12345,N,03730.56789,E,1,12,0.78,150.2,M,14.0,M,,*4B\r\n"
+  "$GNGSA,A,3,02,05,12,13,15,18,20,25,29,,,,1.32,0.78,1.06*11\r\n"
+  "$HEHDT,123.45,T*1E\r\n"
+  "$PASHR,104501,123.45,T,0.12,-0.34,,0.01,0.01,0.02,1,0.000*14\r\n"
+  "$GNZDA,104501.00,19,11,2019,00,00*7B\r\n"
+  "$GNRMC,104501.20,A,5540.12345,N,03730.56789,E,0.512,54.70,191119,,,A*44\r\n"
+  "$GNVTG,54.70,T,,M,0.512,N,0.948,K,A*16\r\n"
+  "$GNGGA,104501.20,5540.12345,N,03730.56789,E,1,12,0.78,150.2,M,14.0,M,,*49\r\n"
+  "$GNGSA,A,3,02,05,12,13,15,18,20,25,29,,,,1.32,0.78,1.06*11\r\n"
+  "$HEHDT,124.45,T*19\r\n"
+  "$PASHR,104501,123.45,T,0.12,-0.34,,0.01,0.01,0.02,1,0.000*14\r\n"
+  "$GPGSV,3,1,11,02,45,123,40,05,30,210,38,12,60,045,44,13,15,300,30*70\r\n"
+  "$GPGSV,3,2,11,15,25,080,35,18,70,180,45,20,10,020,28,25,35,260,39*77\r\n"
+  "$GPGSV,3,3,11,29,50,310,42,31,05,150,,32,08,100,*48\r\n"
+  "$GNZDA,104501.20,19,11,2019,00,00*79\r\n"
+  "$GNRMC,104501.40,A,5540.12345,N,03730.56789,E,0.512,54.70,191119,,,A*42\r\n"
+  "$GNVTG,54.70,T,,M,0.512,N,0.948,K,A*16\r\n"
+  "$GNGGA,104501.40,5540.12345,N,03730.56789,E,1,12,0.78,150.2,M,14.0,M,,*4F\r\n"
+  "$GNGSA,A,3,02,05,12,13,15,18,20,25,29,,,,1.32,0.78,1.06*11\r\n"
+  "$HEHDT,125.45,T*18\r\n"
+  "$PASHR,104501,123.45,T,0.12,-0.34,,0.01,0.01,0.02,1,0.000*14\r\n"
+  "$GNZDA,104501.40,19,11,2019,00,00*7F\r\n";
+
+/* Функция добавляет блок в список отправленных блоков. */
+static void
+add_block (GString     *blocks,
+           gint64       time,
+           const gchar *data,
+           guint32      size)
+{
+  g_string_append_printf (blocks, "%" G_GINT64_FORMAT " %u\n", time, size);
+  g_string_append_len (blocks, data, size);
+  g_string_append_c (blocks, '\n');
+}
+
+/* Функция обрабатывает данные по отдельным символам. */
+static void
+reference_push (Reference   *ref,
+                gint64       time,
+                gint64       char_time,
+                const gchar *data,
+                guint32      size)
+{
+  guint32 rxi;
+
+  for (rxi = 0; rxi < size; rxi++)
+    {
+      gchar *string = ref->message + ref->message_size;
+      gchar rx_data = data[rxi];
+
+      /* Время приёма начала строки. */
+      if (rx_data == '$')
+        ref->rx_time = time - (size - 1 - rxi) * char_time;
+
+      /* Фиксируем время начала приёма блока. */
+      if (ref->message_time == 0)
+        ref->message_time = ref->rx_time;
+
+      /* Текущая обрабатываемая строка пустая и данные не являются началом строки. */
+      if ((ref->string_size == 0) && (rx_data != '$'))
+        continue;
+
+      /* Собираем строку до тех пор пока не встретится символ '\r'. */
+      if (rx_data != '\r')
+        {
+          /* Если строка слишком длинная, пропускаем её. */
+          if (ref->string_size > HYSCAN_NMEA_PARSER_MAX_STRING)
+            {
+              ref->string_size = 0;
+              continue;
+            }
+
+          /* Сохраняем текущий символ. */
+          string [ref->string_size++] = rx_data;
+          string [ref->string_size] = 0;
+          continue;
+        }
+
+      /* Строка собрана. */
+      else
+        {
+          gboolean send_block = FALSE;
+          gboolean bad_crc;
+          gint nmea_time = -1;
+
+          /* NMEA строка не может быть короче 10 символов. */
+          if (ref->string_size < MIN_STRING_SIZE)
+            {
+              ref->string_size = 0;
+              continue;
+            }
+
+          /* Проверяем контрольную сумму NMEA строки. */
+          string[ref->string_size] = 0;
+          bad_crc = !hyscan_nmea_sentence_check (string, ref->string_size);
+
+          /* Пропускаем "плохие" NMEA строки. */
+          if (ref->skip_broken && bad_crc)
+            {
+              ref->string_size = 0;
+              continue;
+            }
+
+          /* Вытаскиваем время из NMEA строк. */
+          if (!bad_crc)
+            nmea_time = hyscan_nmea_sentence_get_time (string);
+
+          /* Если текущее время и время блока различаются, отправляем блок данных. */
+          if (nmea_time >= 0)
+            {
+              if ((ref->nmea_time > 0) && (ref->nmea_time != nmea_time))
+                send_block = TRUE;
+
+              ref->nmea_time = nmea_time;
+            }
+
+          /* Если в блоке больше нет места, отправляем блок. */
+          if ((ref->message_size + ref->string_size + 3) > ref->max_size)
+            send_block = TRUE;
+
+          /* Если нет возможности определить время из строки,
+           * отправляем строку без объединения в блок. */
+          if (ref->nmea_time == 0)
+            {
+              memcpy (string + ref->string_size, "\r\n", 2);
+              add_block (ref->blocks, ref->rx_time, string, ref->string_size + 2);
+
+              ref->message_time = 0;
+              ref->message_size = 0;
+              ref->string_size = 0;
+              continue;
+            }
+
+          /* Отправляем блок данных. Текущая строка переносится в следующий блок. */
+          if (send_block && (ref->message_size > 0))
+            {
+              add_block (ref->blocks, ref->message_time, ref->message, ref->message_size);
+              memmove (ref->message, string, ref->string_size);
+
+              ref->message_time = 0;
+              ref->message_size = 0;
+            }
+
+          /* Сохраняем строку в блоке. */
+          ref->message_size += ref->string_size;
+          ref->message [ref->message_size++] = '\r';
+          ref->message [ref->message_size++] = '\n';
+          ref->message [ref->message_size] = 0;
+
+          ref->string_size = 0;
+        }
+    }
+}
+
+/* Функция формирует NMEA строку с контрольной суммой. */
+static void
+append_sentence (GString     *stream,
+                 const gchar *body,
+                 const gchar *end)
+{
+  g_string_append_printf (stream, "$%s*%02X%s", body,
+                          hyscan_nmea_sentence_xor (body, strlen (body)), end);
+}
+
+/* Функция формирует случайный поток из n_pieces фрагментов: NMEA строк со
+ * временем и без него, слишком длинных строк, строк с неверной контрольной
+ * суммой, оборванных строк, строк без '\n' и мусора. */
+static gchar *
+make_stream (guint  n_pieces,
+             gsize *size)
+{
+  const gchar *garbage = "$$\r\r\n*,0A9x ";
+  GString *stream = g_string_new (NULL);
+  guint epoch = 1;
+  guint i;
+
+  for (i = 0; i < n_pieces; i++)
+    {
+      gchar time[16];
+      gchar *body;
+      guint j, n;
+
+      /* Эпоха меняется в среднем через пять фрагментов. */
+      if (g_random_int_range (0, 5) == 0)
+        epoch += 1;
+
+      g_snprintf (time, sizeof (time), "%02u%02u%02u.%02u",
+                  (epoch / 360000) % 24, (epoch / 6000) % 60, (epoch / 100) % 60, epoch % 100);
+
+      switch (g_random_int_range (0, 10))
+        {
+        /* Строки со временем. */
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+          if (g_random_boolean ())
+            body = g_strdup_printf ("GPGGA,%s,5540.1234,N,03730.5678,E,1,08,0.9,150.0,M,14.0,M,,", time);
+          else
+            body = g_strdup_printf ("GNZDA,%s,19,11,2019,00,00", time);
+          append_sentence (stream, body, "\r\n");
+          g_free (body);
+          break;
+
+        /* Строка без времени. */
+        case 4:
+          append_sentence (stream, "HEHDT,123.45,T", "\r\n");
+          break;
+
+        /* Строка с неверной контрольной суммой. */
+        case 5:
+          body = g_strdup_printf ("GPRMC,%s,A,5540.1234,N,03730.5678,E,0.5,54.7,191119,,,A", time);
+          g_string_append_printf (stream, "$%s*%02X\r\n", body,
+                                  hyscan_nmea_sentence_xor (body, strlen (body)) ^ 0x01);
+          g_free (body);
+          break;
+
+        /* Строка длиной около максимальной: от '$' до контрольной суммы
+         * включительно HYSCAN_NMEA_PARSER_MAX_STRING - 4 ... + 4 символов.
+         * Если строка не завершена, символ '$' следующей строки может
+         * оказаться первым не поместившимся в строку символом. */
+        case 6:
+          n = HYSCAN_NMEA_PARSER_MAX_STRING + g_random_int_range (-4, 5) - 4;
+          if (g_random_boolean ())
+            body = g_strdup_printf ("GPGGA,%s,", time);
+          else
+            body = g_strdup ("GPTXT,");
+          j = strlen (body);
+          body = g_realloc (body, n + 1);
+          for (; j < n; j++)
+            body[j] = ',';
+          body[n] = 0;
+          append_sentence (stream, body, g_random_boolean () ? "\r\n" : "");
+          g_free (body);
+          break;
+
+        /* Оборванная строка, за которой сразу начинается следующая. */
+        case 7:
+          body = g_strdup_printf ("GPGGA,%s,5540.1234,N,03730.5678,E,1,08,0.9,150.0,M,14.0,M,,", time);
+          g_string_append_c (stream, '$');
+          g_string_append_len (stream, body, g_random_int_range (0, strlen (body)));
+          append_sentence (stream, body, "\r\n");
+          g_free (body);
+          break;
+
+        /* Строки, завершающиеся только '\r' или только '\n'. */
+        case 8:
+          body = g_strdup_printf ("GNZDA,%s,19,11,2019,00,00", time);
+          append_sentence (stream, body, g_random_boolean () ? "\r" : "\n");
+          g_free (body);
+          break;
+
+        /* Мусор, в том числе нулевые символы. */
+        default:
+          n = g_random_int_range (1, 17);
+          for (j = 0; j < n; j++)
+            g_string_append_c (stream, garbage[g_random_int_range (0, strlen (garbage) + 1)]);
+          break;
+        }
+    }
+
+  *size = stream->len;
+
+  return g_string_free (stream, FALSE);
+}
+
+/* Функция разбирает поток data посимвольно и разборщиком и сравнивает
+ * полученные блоки. */
+static gboolean
+compare (const gchar *data,
+         gsize        size,
+         guint        max_chunk,
+         gint64       char_time,
+         gboolean     skip_broken,
+         guint        max_size)
+{
+  HyScanNmeaParser parser;
+  HyScanNmeaParserBlock block;
+  Reference ref;
+  GString *blocks;
+  gchar *buffer;
+  gint64 time = 0;
+  gboolean status;
+  gsize i;
+
+  memset (&ref, 0, sizeof (ref));
+  ref.message = g_malloc (HYSCAN_NMEA_PARSER_BUFFER_SIZE (max_size));
+  ref.max_size = max_size;
+  ref.skip_broken = skip_broken;
+  ref.blocks = g_string_new (NULL);
+
+  buffer = g_malloc (HYSCAN_NMEA_PARSER_BUFFER_SIZE (max_size));
+  blocks = g_string_new (NULL);
+
+  hyscan_nmea_parser_init (&parser, buffer, max_size, NULL);
+  hyscan_nmea_parser_skip_broken (&parser, skip_broken);
+
+  while (size > 0)
+    {
+      guint32 chunk = g_random_int_range (1, max_chunk + 1);
+      guint32 rxi = 0;
+
+      chunk = MIN (chunk, size);
+
+      time += g_random_int_range (1, 10000);
+
+      reference_push (&ref, time, char_time, data, chunk);
+
+      /* Участок данных обрабатывается, пока не будут забраны все блоки.
+       * Оставшиеся данные передаются с тем же временем приёма участка. */
+      while (TRUE)
+        {
+          if (hyscan_nmea_parser_pull (&parser, &block))
+            {
+              add_block (blocks, block.time, block.data, block.size);
+              hyscan_nmea_parser_next (&parser, NULL);
+              continue;
+            }
+
+          if (rxi == chunk)
+            break;
+
+          rxi += hyscan_nmea_parser_push (&parser, time, char_time, data + rxi, chunk - rxi);
+        }
+
+      data += chunk;
+      size -= chunk;
+    }
+
+  /* Последний блок. */
+  if (ref.message_size > 0)
+    add_block (ref.blocks, ref.message_time, ref.message, ref.message_size);
+
+  if (hyscan_nmea_parser_flush (&parser, &block))
+    {
+      add_block (blocks, block.time, block.data, block.size);
+      hyscan_nmea_parser_next (&parser, NULL);
+    }
+
+  status = g_string_equal (ref.blocks, blocks);
+
+  /* Первое различие в блоках. */
+  if (!status)
+    {
+      for (i = 0; (i < ref.blocks->len) && (i < blocks->len); i++)
+        if (ref.blocks->str[i] != blocks->str[i])
+          break;
+
+      i = (i > 64) ? i - 64 : 0;
+      g_print ("blocks differ at %" G_GSIZE_FORMAT ":\n%.128s\n---\n%.128s\n",
+               i, ref.blocks->str + MIN (i, ref.blocks->len), blocks->str + MIN (i, blocks->len));
+    }
+
+  g_string_free (ref.blocks, TRUE);
+  g_string_free (blocks, TRUE);
+  g_free (ref.message);
+  g_free (buffer);
+
+  return status;
+}
+
+/* Функция сравнивает разбор потока data при разных настройках. */
+static gboolean
+check (const gchar *name,
+       const gchar *data,
+       gsize        size)
+{
+  const guint max_chunks[] = { 1, 7, 64, MAX_CHUNK_SIZE };
+  gboolean status = TRUE;
+  guint i;
+
+  for (i = 0; i < 16; i++)
+    {
+      guint max_chunk = max_chunks[i % 4];
+      gint64 char_time = (i & 4) ? CHAR_TIME : 0;
+      gboolean skip_broken = (i & 8) != 0;
+      guint max_size = (i & 1) ? MIN_BLOCK_SIZE : MAX_BLOCK_SIZE;
+
+      if (!compare (data, size, max_chunk, char_time, skip_broken, max_size))
+        {
+          g_print ("%s: framing mismatch, chunk %u, char time %" G_GINT64_FORMAT ", "
+                   "skip broken %d, block size %u\n",
+                   name, max_chunk, char_time, skip_broken, max_size);
+          status = FALSE;
+        }
+    }
+
+  return status;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gchar **inputs = NULL;
+  gint n_pieces = 20000;
+  gint n_streams = 10;
+  gint seed = 0;
+  gboolean status = TRUE;
+  GString *stream;
+  gint i;
+
+  /* Разбор командной строки. */
+  {
+    gchar **args;
+    GError *error = NULL;
+    GOptionContext *context;
+    GOptionEntry entries[] =
+      {
+        { "input", 'i', 0, G_OPTION_ARG_FILENAME_ARRAY, &inputs, "Recorded NMEA data", NULL },
+        { "pieces", 'n', 0, G_OPTION_ARG_INT, &n_pieces, "Number of pieces in random stream", NULL },
+        { "streams", 'm', 0, G_OPTION_ARG_INT, &n_streams, "Number of random streams", NULL },
+        { "seed", 's', 0, G_OPTION_ARG_INT, &seed, "Random seed", NULL },
+        { NULL }
+      };
+
+#ifdef G_OS_WIN32
+    args = g_win32_get_command_line ();
+#else
+    args = g_strdupv (argv);
+#endif
+
+    context = g_option_context_new ("");
+    g_option_context_set_help_enabled (context, TRUE);
+    g_option_context_add_main_entries (context, entries, NULL);
+    g_option_context_set_ignore_unknown_options (context, FALSE);
+    if (!g_option_context_parse_strv (context, &args, &error))
+      {
+        g_print ("%s\n", error->message);
+        return -1;
+      }
+
+    if ((n_pieces <= 0) || (n_streams < 0))
+      {
+        g_print ("%s", g_option_context_get_help (context, FALSE, NULL));
+        return 0;
+      }
+
+    g_option_context_free (context);
+    g_strfreev (args);
+  }
+
+  if (seed != 0)
+    g_random_set_seed (seed);
+
+  /* Фрагмент записи приёмника, повторённый несколько раз. */
+  stream = g_string_new (NULL);
+  for (i = 0; i < 100; i++)
+    g_string_append (stream, recorded);
+
+  if (!check ("recorded", stream->str, stream->len))
+    status = FALSE;
+
+  g_string_free (stream, TRUE);
+
+  /* Записи из файлов. */
+  for (i = 0; (inputs != NULL) && (inputs[i] != NULL); i++)
+    {
+      GError *error = NULL;
+      gchar *data;
+      gsize size;
+
+      if (!g_file_get_contents (inputs[i], &data, &size, &error))
+        {
+          g_print ("%s\n", error->message);
+          g_error_free (error);
+          status = FALSE;
+          continue;
+        }
+
+      if (!check (inputs[i], data, size))
+        status = FALSE;
+
+      g_free (data);
+    }
+
+  /* Случайные потоки. */
+  for (i = 0; i < n_streams; i++)
+    {
+      gchar *data;
+      gsize size;
+
+      data = make_stream (n_pieces, &size);
+
+      if (!check ("random", data, size))
+        status = FALSE;
+
+      g_free (data);
+    }
+
+  g_strfreev (inputs);
+
+  return status ? 0 : -1;
+}
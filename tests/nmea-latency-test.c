@@ -0,0 +1,243 @@
+/* nmea-latency-test.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* Тест измеряет время смены параметров и удаления объектов приёма данных.
+ * Создаётся несколько UDP портов на loopback интерфейсе, на которые
+ * отправляются NMEA строки. Затем каждый порт переключается на другой номер
+ * и удаляется. Если указан UART порт, дополнительно измеряется время
+ * переключения его скорости. Тест завершается с ошибкой, если любая из
+ * операций заняла больше MAX_LATENCY мкс. */
+
+#include <hyscan-nmea-udp.h>
+#include <hyscan-nmea-uart.h>
+#include <gio/gio.h>
+#include <string.h>
+
+#define MAX_LATENCY 1000
+
+#define NMEA_GGA "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n"
+
+/* Статистика времени выполнения операции. */
+typedef struct
+{
+  const gchar *name;
+  gint64       max;
+  gint64       total;
+  guint        n;
+} Latency;
+
+static void
+latency_add (Latency *latency,
+             gint64   start)
+{
+  gint64 elapsed = g_get_monotonic_time () - start;
+
+  latency->max = MAX (latency->max, elapsed);
+  latency->total += elapsed;
+  latency->n += 1;
+}
+
+static gboolean
+latency_print (Latency *latency)
+{
+  if (latency->n == 0)
+    return TRUE;
+
+  g_print ("%-16s avg %6.1f us, max %6" G_GINT64_FORMAT " us\n", latency->name,
+           (gdouble)latency->total / latency->n, latency->max);
+
+  return latency->max <= MAX_LATENCY;
+}
+
+/* Функция отправляет NMEA строку на UDP порт loopback интерфейса. */
+static void
+send_nmea (GSocket *socket,
+           guint16  port)
+{
+  GInetAddress *loopback;
+  GSocketAddress *address;
+
+  loopback = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  address = g_inet_socket_address_new (loopback, port);
+
+  g_socket_send_to (socket, address, NMEA_GGA, strlen (NMEA_GGA), NULL, NULL);
+
+  g_object_unref (address);
+  g_object_unref (loopback);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  HyScanNmeaReactor *reactor;
+  HyScanNmeaUDP **udps;
+  GSocket *socket;
+  gint n_sensors = 20;
+  gint port = 20000;
+  gchar *uart_port = NULL;
+  gboolean status = TRUE;
+  gint i, j;
+
+  Latency reconfigure = { "udp reconfigure", 0, 0, 0 };
+  Latency finalize = { "udp finalize", 0, 0, 0 };
+  Latency uart_mode = { "uart mode", 0, 0, 0 };
+  Latency uart_finalize = { "uart finalize", 0, 0, 0 };
+
+  /* Разбор командной строки. */
+  {
+    gchar **args;
+    GError *error = NULL;
+    GOptionContext *context;
+    GOptionEntry entries[] =
+      {
+        { "sensors", 'n', 0, G_OPTION_ARG_INT, &n_sensors, "Number of UDP sensors", NULL },
+        { "port", 'p', 0, G_OPTION_ARG_INT, &port, "First udp port", NULL },
+        { "uart-port", 'o', 0, G_OPTION_ARG_STRING, &uart_port, "UART port for mode switch test", NULL },
+        { NULL }
+      };
+
+#ifdef G_OS_WIN32
+    args = g_win32_get_command_line ();
+#else
+    args = g_strdupv (argv);
+#endif
+
+    context = g_option_context_new ("");
+    g_option_context_set_help_enabled (context, TRUE);
+    g_option_context_add_main_entries (context, entries, NULL);
+    g_option_context_set_ignore_unknown_options (context, FALSE);
+    if (!g_option_context_parse_strv (context, &args, &error))
+      {
+        g_print ("%s\n", error->message);
+        return -1;
+      }
+
+    if ((n_sensors <= 0) || (port < 1024) || (port + 2 * n_sensors > 65535))
+      {
+        g_print ("%s", g_option_context_get_help (context, FALSE, NULL));
+        return 0;
+      }
+
+    g_option_context_free (context);
+    g_strfreev (args);
+  }
+
+  /* Удерживаем поток обработки событий, чтобы измерять только
+   * время работы с портами. */
+  reactor = hyscan_nmea_reactor_get_default ();
+
+  socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM, G_SOCKET_PROTOCOL_DEFAULT, NULL);
+  if (socket == NULL)
+    g_error ("can't create udp socket");
+
+  /* Открываем UDP порты. */
+  udps = g_new0 (HyScanNmeaUDP *, n_sensors);
+  for (i = 0; i < n_sensors; i++)
+    {
+      udps[i] = hyscan_nmea_udp_new ();
+      if (!hyscan_nmea_udp_set_address (udps[i], "loopback", port + i))
+        g_error ("can't bind udp port %d", port + i);
+    }
+
+  /* Данные, чтобы потоки отправки данных были заняты работой. */
+  for (j = 0; j < 10; j++)
+    for (i = 0; i < n_sensors; i++)
+      send_nmea (socket, port + i);
+
+  /* Переключение UDP портов. */
+  for (i = 0; i < n_sensors; i++)
+    {
+      gint64 start = g_get_monotonic_time ();
+
+      if (!hyscan_nmea_udp_set_address (udps[i], "loopback", port + n_sensors + i))
+        g_error ("can't bind udp port %d", port + n_sensors + i);
+
+      latency_add (&reconfigure, start);
+    }
+
+  for (j = 0; j < 10; j++)
+    for (i = 0; i < n_sensors; i++)
+      send_nmea (socket, port + n_sensors + i);
+
+  /* Удаление UDP портов. */
+  for (i = 0; i < n_sensors; i++)
+    {
+      gint64 start = g_get_monotonic_time ();
+
+      g_object_unref (udps[i]);
+
+      latency_add (&finalize, start);
+    }
+
+  /* Переключение скорости UART порта. */
+  if (uart_port != NULL)
+    {
+      HyScanNmeaUART *uart = hyscan_nmea_uart_new ();
+      HyScanNmeaUARTMode mode;
+      gint64 start;
+
+      for (mode = HYSCAN_NMEA_UART_MODE_4800_8N1; mode <= HYSCAN_NMEA_UART_MODE_115200_8N1; mode++)
+        {
+          start = g_get_monotonic_time ();
+
+          if (!hyscan_nmea_uart_set_device (uart, uart_port, mode))
+            g_error ("can't open uart port %s", uart_port);
+
+          latency_add (&uart_mode, start);
+        }
+
+      start = g_get_monotonic_time ();
+      g_object_unref (uart);
+      latency_add (&uart_finalize, start);
+    }
+
+  status &= latency_print (&reconfigure);
+  status &= latency_print (&finalize);
+  status &= latency_print (&uart_mode);
+  status &= latency_print (&uart_finalize);
+
+  g_object_unref (socket);
+  g_object_unref (reactor);
+  g_free (udps);
+  g_free (uart_port);
+
+  if (!status)
+    {
+      g_print ("Latency exceeds %d us\n", MAX_LATENCY);
+      return -1;
+    }
+
+  return 0;
+}
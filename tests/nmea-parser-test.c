@@ -0,0 +1,627 @@
+/* nmea-parser-test.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* Тест проверяет разбор NMEA данных объектом HyScanNmeaParser без
+ * использования потоков и выделения памяти. Формируется поток из
+ * нескольких эпох NMEA строк, который передаётся разборщику участками
+ * случайного размера. Каждый полученный блок должен содержать ровно одну
+ * эпоху, а время приёма строк блока не должно убывать. Проверка
+ * выполняется с досрочной отправкой блоков и без неё, а также с фильтром,
+ * отбрасывающим часть строк эпохи, с прореживанием части строк, со
+ * срочными строками, которые должны приходить отдельными блоками раньше
+ * блока своей эпохи, и с эпохами, завершающимися несколькими строками
+ * GSV, по первой из которых блок не должен отправляться досрочно.
+ *
+ * Дополнительно проверяется группировка строк без времени, поступающих
+ * с паузами: отправка блока по отсутствию данных, как в транспортах, не
+ * должна нарушать интервал группировки и число строк в блоке. Также
+ * проверяется, что строки, отброшенные фильтром, учитываются в числе
+ * принятых строк, даже если фильтр отбрасывает все строки. */
+
+#include <hyscan-nmea-parser.h>
+#include <hyscan-nmea-sentence.h>
+#include <string.h>
+
+#define MAX_BLOCK_SIZE 1024
+#define MAX_CHUNK_SIZE 64
+#define UNTIMED_PERIOD 40000
+#define IDLE_TIMEOUT   5000
+
+/* Строки эпохи. */
+typedef enum
+{
+  EPOCH_ALL,                                   /* Все строки. */
+  EPOCH_FILTERED,                              /* Строки, прошедшие фильтр. */
+  EPOCH_DECIMATED,                             /* Строки, оставшиеся после прореживания. */
+  EPOCH_REGULAR,                               /* Строки, кроме срочных. */
+  EPOCH_URGENT                                 /* Срочные строки. */
+} EpochLines;
+
+/* Настройки разборщика. */
+typedef struct
+{
+  const gchar                *name;            /* Описание настроек. */
+  gboolean                    predict;         /* Досрочная отправка блоков. */
+  const gchar * const        *filter;          /* Запрещённые строки. */
+  const HyScanNmeaParserRate *rates;           /* Правила прореживания. */
+  guint                       n_rates;         /* Число правил прореживания. */
+  const gchar * const        *urgent;          /* Срочные строки. */
+  gboolean                    gsv;             /* Эпоха завершается строками GSV. */
+} Setup;
+
+/* Строки одной эпохи, время подставляется вместо %s. Строки с признаком
+ * filtered отбрасываются фильтром filter_patterns, из строк с ненулевым
+ * every правила decimation_rates оставляют каждую every-ю, строки с
+ * признаком urgent объявляются срочными шаблонами urgent_patterns. Строки
+ * с признаком gsv присутствуют только в потоке для настроек с gsv. */
+static const struct
+{
+  const gchar *format;
+  gboolean     filtered;
+  guint        every;
+  gboolean     urgent;
+  gboolean     gsv;
+} epoch_formats[] =
+{
+  { "GPGGA,%s,5540.1234,N,03730.5678,E,1,08,0.9,150.0,M,14.0,M,,", FALSE, 0, FALSE, FALSE },
+  { "GPRMC,%s,A,5540.1234,N,03730.5678,E,0.5,54.7,191119,,,A", FALSE, 0, FALSE, FALSE },
+  { "GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1", TRUE, 2, FALSE, FALSE },
+  { "GPVTG,54.7,T,,M,0.5,N,0.9,K,A", TRUE, 3, TRUE, FALSE },
+  { "GPGST,%s,0.006,0.023,0.020,273.6,0.023,0.020,0.031", FALSE, 0, FALSE, FALSE },
+  { "GPGSV,3,1,10,04,15,270,40,05,40,060,42,09,22,125,38,12,65,190,45", FALSE, 0, FALSE, TRUE },
+  { "GPGSV,3,2,10,17,08,315,30,20,33,095,41,24,51,240,44,25,12,030,35", FALSE, 0, FALSE, TRUE },
+  { "GPGSV,3,3,10,28,19,160,39,32,05,280,28", FALSE, 0, FALSE, TRUE }
+};
+
+static const gchar *filter_patterns[] = { "GSA", "??VTG", NULL };
+
+static const gchar *urgent_patterns[] = { "VTG", NULL };
+
+static const gchar *no_patterns[] = { "ZDA", NULL };
+
+static const gchar *all_patterns[] = { "GGA", "RMC", "GSA", "VTG", "GST", "GSV", NULL };
+
+static const HyScanNmeaParserRate decimation_rates[] =
+{
+  { "GSA", 2, 0.0 },
+  { "??VTG", 3, 0.0 }
+};
+
+static const Setup setups[] =
+{
+  { "without epoch prediction", FALSE, NULL, NULL, 0, NULL, FALSE },
+  { "with epoch prediction", TRUE, NULL, NULL, 0, NULL, FALSE },
+  { "with sentence filter", TRUE, filter_patterns, NULL, 0, NULL, FALSE },
+  { "with sentence decimation", TRUE, NULL, decimation_rates, G_N_ELEMENTS (decimation_rates), NULL, FALSE },
+  { "with urgent sentences", FALSE, NULL, NULL, 0, urgent_patterns, FALSE },
+  { "with urgent sentences and epoch prediction", TRUE, NULL, NULL, 0, urgent_patterns, FALSE },
+  { "with multi-part GSV ending", FALSE, NULL, NULL, 0, NULL, TRUE },
+  { "with multi-part GSV ending and epoch prediction", TRUE, NULL, NULL, 0, NULL, TRUE }
+};
+
+/* Функция возвращает число строк в данных. */
+static guint
+count_lines (const gchar *data)
+{
+  guint n_lines = 0;
+
+  while ((data = strchr (data, '\n')) != NULL)
+    {
+      n_lines += 1;
+      data += 1;
+    }
+
+  return n_lines;
+}
+
+/* Функция проверяет, присутствует ли строка index среди строк lines эпохи
+ * с номером epoch. */
+static gboolean
+has_line (guint      epoch,
+          guint      index,
+          EpochLines lines,
+          gboolean   gsv)
+{
+  guint every = epoch_formats[index].every;
+
+  if (epoch_formats[index].gsv && !gsv)
+    return FALSE;
+
+  switch (lines)
+    {
+    case EPOCH_FILTERED:
+      return !epoch_formats[index].filtered;
+
+    case EPOCH_DECIMATED:
+      return (every <= 1) || (((epoch - 1) % every) == 0);
+
+    case EPOCH_REGULAR:
+      return !epoch_formats[index].urgent;
+
+    case EPOCH_URGENT:
+      return epoch_formats[index].urgent;
+
+    default:
+      return TRUE;
+    }
+}
+
+/* Функция формирует строки эпохи с номером epoch. Если gsv равен TRUE,
+ * эпоха завершается строками GSV. */
+static gchar *
+make_epoch (guint      epoch,
+            EpochLines lines,
+            gboolean   gsv)
+{
+  GString *text = g_string_new (NULL);
+  gchar time[16];
+  guint i;
+
+  g_snprintf (time, sizeof (time), "%02u%02u%02u.%02u",
+              (epoch / 360000) % 24, (epoch / 6000) % 60, (epoch / 100) % 60, epoch % 100);
+
+  for (i = 0; i < G_N_ELEMENTS (epoch_formats); i++)
+    {
+      gchar *body;
+
+      if (!has_line (epoch, i, lines, gsv))
+        continue;
+
+      body = g_strdup_printf (epoch_formats[i].format, time);
+
+      g_string_append_printf (text, "$%s*%02X\r\n", body,
+                              hyscan_nmea_sentence_xor (body, strlen (body)));
+      g_free (body);
+    }
+
+  return g_string_free (text, FALSE);
+}
+
+/* Функция проверяет блок NMEA данных. */
+static gboolean
+check_block (const HyScanNmeaParserBlock  *block,
+             gchar                       **epochs,
+             guint                        *n_blocks)
+{
+  const gchar *epoch = epochs[*n_blocks];
+  guint i;
+
+  *n_blocks += 1;
+
+  if ((block->size != strlen (epoch)) || (memcmp (block->data, epoch, block->size) != 0))
+    {
+      g_print ("block %u mismatch\n", *n_blocks - 1);
+      return FALSE;
+    }
+
+  if (block->n_lines != count_lines (epoch))
+    {
+      g_print ("block %u: %u lines\n", *n_blocks - 1, block->n_lines);
+      return FALSE;
+    }
+
+  for (i = 1; i < block->n_lines; i++)
+    {
+      if (block->line_times[i] < block->line_times[i - 1])
+        {
+          g_print ("block %u: line times decrease\n", *n_blocks - 1);
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+/* Функция разбирает поток data и проверяет полученные блоки. Обычные блоки
+ * сравниваются с эпохами epochs, срочные - со строками urgent. Срочная
+ * строка эпохи должна быть получена раньше блока этой эпохи. */
+static gboolean
+parse (const gchar  *data,
+       gchar       **epochs,
+       gchar       **urgent,
+       guint         n_epochs,
+       const Setup  *setup)
+{
+  HyScanNmeaParserFilter filter;
+  HyScanNmeaParserFilter urgent_filter;
+  HyScanNmeaParserDecimation decimation;
+  HyScanNmeaParser parser;
+  HyScanNmeaParserBlock block;
+  gchar buffer[HYSCAN_NMEA_PARSER_BUFFER_SIZE (MAX_BLOCK_SIZE)];
+  guint32 line_times[HYSCAN_NMEA_PARSER_MAX_LINES (MAX_BLOCK_SIZE)];
+  guint32 size = strlen (data);
+  guint n_lines = count_lines (data);
+  guint n_blocks = 0;
+  guint n_urgent = 0;
+  gint64 time = 0;
+
+  hyscan_nmea_parser_init (&parser, buffer, MAX_BLOCK_SIZE, line_times);
+  hyscan_nmea_parser_set_predict_epoch (&parser, setup->predict);
+
+  if (!hyscan_nmea_parser_filter_compile (&filter, setup->filter, FALSE) ||
+      !hyscan_nmea_parser_filter_compile (&urgent_filter, setup->urgent, TRUE))
+    {
+      g_print ("invalid filter\n");
+      return FALSE;
+    }
+  hyscan_nmea_parser_set_filter (&parser, &filter);
+  hyscan_nmea_parser_set_urgent (&parser, &urgent_filter);
+
+  if (!hyscan_nmea_parser_decimation_compile (&decimation, setup->rates, setup->n_rates))
+    {
+      g_print ("invalid decimation\n");
+      return FALSE;
+    }
+  hyscan_nmea_parser_set_decimation (&parser, &decimation);
+
+  while (size > 0)
+    {
+      guint32 chunk = g_random_int_range (1, MAX_CHUNK_SIZE + 1);
+
+      chunk = MIN (chunk, size);
+
+      time += 1000;
+
+      /* Участок данных обрабатывается, пока не будут забраны все блоки. */
+      while (TRUE)
+        {
+          guint32 n_chars;
+
+          if (hyscan_nmea_parser_pull (&parser, &block))
+            {
+              if (block.urgent)
+                {
+                  if ((urgent == NULL) || (n_urgent >= n_epochs) ||
+                      !check_block (&block, urgent, &n_urgent))
+                    {
+                      g_print ("unexpected urgent block\n");
+                      return FALSE;
+                    }
+                }
+              else
+                {
+                  if ((urgent != NULL) && (n_urgent <= n_blocks))
+                    {
+                      g_print ("block %u before its urgent sentence\n", n_blocks);
+                      return FALSE;
+                    }
+
+                  if (!check_block (&block, epochs, &n_blocks))
+                    return FALSE;
+                }
+
+              hyscan_nmea_parser_next (&parser, NULL);
+              continue;
+            }
+
+          if (chunk == 0)
+            break;
+
+          n_chars = hyscan_nmea_parser_push (&parser, time, 0, data, chunk);
+          data += n_chars;
+          size -= n_chars;
+          chunk -= n_chars;
+        }
+    }
+
+  /* Последняя эпоха. */
+  if (hyscan_nmea_parser_flush (&parser, &block))
+    {
+      if (!check_block (&block, epochs, &n_blocks))
+        return FALSE;
+
+      hyscan_nmea_parser_next (&parser, NULL);
+    }
+
+  if ((n_blocks != n_epochs) || ((urgent != NULL) && (n_urgent != n_epochs)) ||
+      (hyscan_nmea_parser_get_n_sentences (&parser) != n_lines))
+    {
+      g_print ("%u blocks, %u urgent blocks of %u epochs\n", n_blocks, n_urgent, n_epochs);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Функция формирует ожидаемые блоки и проверяет разбор потока data
+ * разборщиком с настройками setup. */
+static gboolean
+run (const gchar *data,
+     guint        n_epochs,
+     const Setup *setup)
+{
+  EpochLines lines = EPOCH_ALL;
+  gchar **epochs;
+  gchar **urgent = NULL;
+  gboolean status;
+  guint i;
+
+  if (setup->filter != NULL)
+    lines = EPOCH_FILTERED;
+  else if (setup->rates != NULL)
+    lines = EPOCH_DECIMATED;
+  else if (setup->urgent != NULL)
+    lines = EPOCH_REGULAR;
+
+  /* Первая эпоха начинается не с нулевого времени, так как нулевое
+   * время означает отсутствие времени в строке. */
+  epochs = g_new0 (gchar *, n_epochs + 1);
+  for (i = 0; i < n_epochs; i++)
+    epochs[i] = make_epoch (i + 1, lines, setup->gsv);
+
+  if (setup->urgent != NULL)
+    {
+      urgent = g_new0 (gchar *, n_epochs + 1);
+      for (i = 0; i < n_epochs; i++)
+        urgent[i] = make_epoch (i + 1, EPOCH_URGENT, setup->gsv);
+    }
+
+  status = parse (data, epochs, urgent, n_epochs, setup);
+
+  g_strfreev (urgent);
+  g_strfreev (epochs);
+
+  return status;
+}
+
+/* Функция проверяет группировку n_lines строк без времени, поступающих
+ * каждые UNTIMED_PERIOD мкс. Как и в транспортах, через IDLE_TIMEOUT мкс
+ * после каждой строки блок забирается, если это позволяет
+ * hyscan_nmea_parser_get_flush_time, но не раньше указанного ей времени.
+ * Каждый блок должен содержать block_lines строк. */
+static gboolean
+check_untimed (gint64 window,
+               guint  n_sentences,
+               guint  block_lines,
+               guint  n_lines)
+{
+  HyScanNmeaParser parser;
+  HyScanNmeaParserBlock block;
+  gchar buffer[HYSCAN_NMEA_PARSER_BUFFER_SIZE (MAX_BLOCK_SIZE)];
+  const gchar *body = "SDDBT,12.3,f,3.75,M,2.05,F";
+  gchar *line;
+  guint32 size;
+  guint n_received = 0;
+  guint i;
+
+  line = g_strdup_printf ("$%s*%02X\r\n", body, hyscan_nmea_sentence_xor (body, strlen (body)));
+  size = strlen (line);
+
+  hyscan_nmea_parser_init (&parser, buffer, MAX_BLOCK_SIZE, NULL);
+  hyscan_nmea_parser_group_untimed (&parser, window, n_sentences);
+
+  for (i = 0; i <= n_lines; i++)
+    {
+      gint64 time = (i + 1) * UNTIMED_PERIOD;
+      const gchar *data = line;
+      guint32 chunk = size;
+      gboolean flush = FALSE;
+
+      /* Отправка блока по отсутствию данных до приёма следующей строки. */
+      if (i > 0)
+        {
+          gint64 flush_time = hyscan_nmea_parser_get_flush_time (&parser);
+
+          flush = (flush_time >= 0) && (MAX (flush_time, time - UNTIMED_PERIOD + IDLE_TIMEOUT) < time);
+        }
+
+      while (TRUE)
+        {
+          if ((flush && hyscan_nmea_parser_flush (&parser, &block)) ||
+              hyscan_nmea_parser_pull (&parser, &block))
+            {
+              if (block.n_lines != block_lines)
+                {
+                  g_print ("untimed block %u: %u lines\n", n_received / block_lines, block.n_lines);
+                  g_free (line);
+                  return FALSE;
+                }
+
+              n_received += block.n_lines;
+              flush = FALSE;
+
+              hyscan_nmea_parser_next (&parser, NULL);
+              continue;
+            }
+
+          if ((chunk == 0) || (i == n_lines))
+            break;
+
+          chunk -= hyscan_nmea_parser_push (&parser, time, 0, data + size - chunk, chunk);
+        }
+    }
+
+  g_free (line);
+
+  if (n_received != n_lines)
+    {
+      g_print ("%u untimed lines of %u\n", n_received, n_lines);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Функция проверяет разбор потока data, все строки которого отбрасываются
+ * фильтром из шаблонов patterns. Блоков быть не должно, но все строки
+ * должны учитываться в числе принятых строк. */
+static gboolean
+check_filtered (const gchar         *data,
+                const gchar * const *patterns,
+                gboolean             allow)
+{
+  HyScanNmeaParserFilter filter;
+  HyScanNmeaParser parser;
+  HyScanNmeaParserBlock block;
+  gchar buffer[HYSCAN_NMEA_PARSER_BUFFER_SIZE (MAX_BLOCK_SIZE)];
+  guint32 size = strlen (data);
+  guint n_lines = count_lines (data);
+
+  hyscan_nmea_parser_init (&parser, buffer, MAX_BLOCK_SIZE, NULL);
+
+  if (!hyscan_nmea_parser_filter_compile (&filter, patterns, allow))
+    {
+      g_print ("invalid filter\n");
+      return FALSE;
+    }
+  hyscan_nmea_parser_set_filter (&parser, &filter);
+
+  while (size > 0)
+    {
+      guint32 n_chars;
+
+      if (hyscan_nmea_parser_pull (&parser, &block))
+        {
+          g_print ("unexpected block of filtered sentences\n");
+          return FALSE;
+        }
+
+      n_chars = hyscan_nmea_parser_push (&parser, 0, 0, data, MIN (size, MAX_CHUNK_SIZE));
+      data += n_chars;
+      size -= n_chars;
+    }
+
+  if (hyscan_nmea_parser_flush (&parser, &block))
+    {
+      g_print ("unexpected block of filtered sentences\n");
+      return FALSE;
+    }
+
+  if (hyscan_nmea_parser_get_n_sentences (&parser) != n_lines)
+    {
+      g_print ("%u filtered sentences of %u\n", hyscan_nmea_parser_get_n_sentences (&parser), n_lines);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gint n_epochs = 10000;
+  gint seed = 0;
+  gchar **epochs;
+  gchar *data[2];
+  gboolean status = TRUE;
+  guint j;
+  gint i;
+
+  /* Разбор командной строки. */
+  {
+    gchar **args;
+    GError *error = NULL;
+    GOptionContext *context;
+    GOptionEntry entries[] =
+      {
+        { "epochs", 'n', 0, G_OPTION_ARG_INT, &n_epochs, "Number of epochs", NULL },
+        { "seed", 's', 0, G_OPTION_ARG_INT, &seed, "Random seed", NULL },
+        { NULL }
+      };
+
+#ifdef G_OS_WIN32
+    args = g_win32_get_command_line ();
+#else
+    args = g_strdupv (argv);
+#endif
+
+    context = g_option_context_new ("");
+    g_option_context_set_help_enabled (context, TRUE);
+    g_option_context_add_main_entries (context, entries, NULL);
+    g_option_context_set_ignore_unknown_options (context, FALSE);
+    if (!g_option_context_parse_strv (context, &args, &error))
+      {
+        g_print ("%s\n", error->message);
+        return -1;
+      }
+
+    if (n_epochs <= 0)
+      {
+        g_print ("%s", g_option_context_get_help (context, FALSE, NULL));
+        return 0;
+      }
+
+    g_option_context_free (context);
+    g_strfreev (args);
+  }
+
+  if (seed != 0)
+    g_random_set_seed (seed);
+
+  /* Потоки данных без строк GSV и со строками GSV в конце эпохи. Первая
+   * эпоха начинается не с нулевого времени, так как нулевое время означает
+   * отсутствие времени в строке. */
+  for (j = 0; j < G_N_ELEMENTS (data); j++)
+    {
+      epochs = g_new0 (gchar *, n_epochs + 1);
+      for (i = 0; i < n_epochs; i++)
+        epochs[i] = make_epoch (i + 1, EPOCH_ALL, j);
+      data[j] = g_strjoinv (NULL, epochs);
+      g_strfreev (epochs);
+    }
+
+  for (j = 0; j < G_N_ELEMENTS (setups); j++)
+    {
+      if (!run (data[setups[j].gsv], n_epochs, &setups[j]))
+        {
+          g_print ("parser failed %s\n", setups[j].name);
+          status = FALSE;
+        }
+    }
+
+  /* Все строки отбрасываются списком разрешённых строк, которым не
+   * соответствует ни одна строка, и списком запрещённых строк. */
+  if (!check_filtered (data[1], no_patterns, TRUE) ||
+      !check_filtered (data[1], all_patterns, FALSE))
+    {
+      g_print ("parser failed with all sentences filtered\n");
+      status = FALSE;
+    }
+
+  g_free (data[0]);
+  g_free (data[1]);
+
+  /* Строки без времени, объединяемые по интервалу, по числу строк и по
+   * интервалу с ограничением числа строк. */
+  if (!check_untimed (5 * UNTIMED_PERIOD / 2, 0, 3, 30) ||
+      !check_untimed (0, 4, 4, 32) ||
+      !check_untimed (5 * UNTIMED_PERIOD / 2, 2, 2, 30))
+    {
+      g_print ("parser failed with untimed sentences\n");
+      status = FALSE;
+    }
+
+  return status ? 0 : -1;
+}
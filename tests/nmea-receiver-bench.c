@@ -0,0 +1,213 @@
+/* nmea-receiver-bench.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* Тест сравнивает скорость доставки блоков NMEA данных через сигнал
+ * "nmea-data", через функцию обработки hyscan_nmea_receiver_set_data_func,
+ * через функцию пакетной обработки hyscan_nmea_receiver_set_batch_func,
+ * а также синхронную отправку данных без потока отправки. */
+
+#include <hyscan-nmea-receiver.h>
+#include <string.h>
+#include <stdio.h>
+
+#define MAX_IN_FLIGHT 8
+
+enum
+{
+  MODE_SIGNAL,
+  MODE_DATA_FUNC,
+  MODE_BATCH,
+  MODE_INLINE
+};
+
+static gint n_received = 0;
+
+/* Блок NMEA данных. */
+static void
+data_cb (HyScanNmeaReceiver *receiver,
+         gint64              time,
+         const gchar        *data,
+         guint               size,
+         gpointer            user_data)
+{
+  g_atomic_int_inc (&n_received);
+}
+
+/* Пакет блоков NMEA данных. */
+static void
+batch_cb (HyScanNmeaReceiver            *receiver,
+          const HyScanNmeaReceiverBlock *blocks,
+          guint                          n_blocks,
+          gpointer                       user_data)
+{
+  g_atomic_int_add (&n_received, n_blocks);
+}
+
+/* Функция формирует NMEA строки, каждая из которых образует отдельный блок. */
+static gchar **
+make_sentences (guint n_blocks)
+{
+  gchar **sentences = g_new0 (gchar *, n_blocks + 1);
+  guint i;
+
+  for (i = 0; i < n_blocks; i++)
+    {
+      guint msec = i % 1000;
+      guint sec = (i / 1000) % 60;
+      guint min = (i / 60000) % 60;
+      guint hour = (i / 3600000) % 24;
+      guchar crc = 0;
+      gchar *body;
+      gchar *p;
+
+      body = g_strdup_printf ("GPGGA,%02u%02u%02u.%03u,5540.1234,N,03730.5678,E,1,08,0.9,150.0,M,14.0,M,,",
+                              hour, min, sec, msec);
+      for (p = body; *p != 0; p++)
+        crc ^= *p;
+
+      sentences[i] = g_strdup_printf ("$%s*%02X\r\n", body, crc);
+      g_free (body);
+    }
+
+  return sentences;
+}
+
+/* Функция измеряет время доставки блоков одним из способов. */
+static gdouble
+run (gchar    **sentences,
+     guint      n_blocks,
+     gint       mode)
+{
+  HyScanNmeaReceiver *receiver;
+  GTimer *timer;
+  gdouble elapsed;
+  guint i;
+
+  receiver = g_object_new (HYSCAN_TYPE_NMEA_RECEIVER, "inline", (mode == MODE_INLINE), NULL);
+  if (mode == MODE_SIGNAL)
+    g_signal_connect (receiver, "nmea-data", G_CALLBACK (data_cb), NULL);
+  else if (mode == MODE_BATCH)
+    hyscan_nmea_receiver_set_batch_func (receiver, batch_cb, MAX_IN_FLIGHT, NULL);
+  else
+    hyscan_nmea_receiver_set_data_func (receiver, data_cb, NULL);
+
+  g_atomic_int_set (&n_received, 0);
+  timer = g_timer_new ();
+
+  for (i = 0; i < n_blocks; i++)
+    {
+      hyscan_nmea_receiver_add_data (receiver, g_get_monotonic_time (),
+                                     sentences[i], strlen (sentences[i]));
+
+      /* Не допускаем переполнения буфера сообщений. */
+      while ((i - (guint)g_atomic_int_get (&n_received)) > MAX_IN_FLIGHT)
+        g_thread_yield ();
+    }
+
+  hyscan_nmea_receiver_flush (receiver, -1.0);
+  while ((guint)g_atomic_int_get (&n_received) < n_blocks)
+    g_thread_yield ();
+
+  elapsed = g_timer_elapsed (timer, NULL);
+
+  g_timer_destroy (timer);
+  g_object_unref (receiver);
+
+  return elapsed;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gint n_blocks = 1000000;
+  gchar **sentences;
+  gdouble signal_time;
+  gdouble direct_time;
+  gdouble batch_time;
+  gdouble inline_time;
+
+  /* Разбор командной строки. */
+  {
+    gchar **args;
+    GError *error = NULL;
+    GOptionContext *context;
+    GOptionEntry entries[] =
+      {
+        { "blocks", 'n', 0, G_OPTION_ARG_INT, &n_blocks, "Number of blocks", NULL },
+        { NULL }
+      };
+
+#ifdef G_OS_WIN32
+    args = g_win32_get_command_line ();
+#else
+    args = g_strdupv (argv);
+#endif
+
+    context = g_option_context_new ("");
+    g_option_context_set_help_enabled (context, TRUE);
+    g_option_context_add_main_entries (context, entries, NULL);
+    g_option_context_set_ignore_unknown_options (context, FALSE);
+    if (!g_option_context_parse_strv (context, &args, &error))
+      {
+        g_print ("%s\n", error->message);
+        return -1;
+      }
+
+    if (n_blocks <= 0)
+      {
+        g_print ("%s", g_option_context_get_help (context, FALSE, NULL));
+        return 0;
+      }
+
+    g_option_context_free (context);
+    g_strfreev (args);
+  }
+
+  sentences = make_sentences (n_blocks);
+
+  signal_time = run (sentences, n_blocks, MODE_SIGNAL);
+  direct_time = run (sentences, n_blocks, MODE_DATA_FUNC);
+  batch_time = run (sentences, n_blocks, MODE_BATCH);
+  inline_time = run (sentences, n_blocks, MODE_INLINE);
+
+  g_print ("signal:    %.1f ns/block\n", 1e9 * signal_time / n_blocks);
+  g_print ("data func: %.1f ns/block\n", 1e9 * direct_time / n_blocks);
+  g_print ("batch:     %.1f ns/block\n", 1e9 * batch_time / n_blocks);
+  g_print ("inline:    %.1f ns/block\n", 1e9 * inline_time / n_blocks);
+
+  g_strfreev (sentences);
+
+  return 0;
+}
@@ -0,0 +1,530 @@
+/* nmea-receiver-ring-test.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* Тест проверяет переполнение кольцевого буфера сообщений HyScanNmeaReceiver.
+ *
+ * Функция пакетной обработки останавливается на заданном блоке и не
+ * возвращается, пока тест не передаст все данные. Остановка на срочном
+ * блоке оставляет буфер свободным от отправляемых блоков, остановка на
+ * обычном блоке занимает его место в буфере. Буфер заполняется по числу
+ * сообщений ("n-buffers") или по размеру ("buffer-size" и "message-size").
+ * Перед остановкой передаются несколько эпох, чтобы блоки переходили через
+ * конец буфера.
+ *
+ * Эпохи состоят из одной, двух или трёх NMEA строк, поэтому блоки имеют
+ * разный размер. Для каждой политики обработки переполнения проверяются
+ * номера доставленных эпох и их порядок, содержимое, метки времени и время
+ * приёма строк блоков, а также точное число отброшенных блоков. Последняя
+ * эпоха отправляется функцией hyscan_nmea_receiver_flush после
+ * возобновления отправки и доставляется всегда. */
+
+#include <hyscan-nmea-receiver.h>
+#include <string.h>
+
+#define N_EPOCHS          64
+#define N_WARMUP          5
+#define START_TIME        1000000
+#define EPOCH_TIME        100000
+#define LINE_TIME         1000
+#define OVERFLOW_TIMEOUT  0.005
+#define WAIT_TIMEOUT      (5 * G_TIME_SPAN_SECOND)
+#define FLUSH_TIMEOUT     (10 * G_TIME_SPAN_MILLISECOND)
+
+/* Место остановки функции пакетной обработки. */
+enum
+{
+  STALL_URGENT,
+  STALL_BLOCK
+};
+
+/* Потребитель блоков данных. */
+typedef struct
+{
+  GMutex                       lock;           /* Блокировка. */
+  GCond                        cond;           /* Сигнализатор изменения состояния. */
+
+  gint                         stall;          /* Место остановки. */
+  gint64                       stall_time;     /* Метка времени блока остановки. */
+  gboolean                     stalled;        /* Признак остановки. */
+  gboolean                     released;       /* Признак возобновления работы. */
+
+  GArray                      *blocks;         /* Принятые обычные блоки. */
+} Consumer;
+
+/* Варианты переполнения буфера и номера доставленных эпох. */
+static const struct
+{
+  const gchar                 *name;
+  HyScanNmeaReceiverOverflow   overflow;
+  gint                         stall;
+  guint                        n_buffers;
+  guint                        message_size;
+  guint                        buffer_size;
+  gboolean                     line_times;
+  const gchar                 *epochs;
+} cases[] =
+{
+  /* Буфер из 4 сообщений вмещает 3 неотправленных блока. Число сообщений
+   * 3 округляется до 4. */
+  { "drop-newest, n-buffers",         HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST,
+    STALL_URGENT, 4, 256, 32768, TRUE, "0-7 63" },
+  { "drop-oldest, n-buffers",         HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_OLDEST,
+    STALL_URGENT, 4, 256, 32768, TRUE, "0-4 60-63" },
+  { "block, n-buffers",               HYSCAN_NMEA_RECEIVER_OVERFLOW_BLOCK,
+    STALL_URGENT, 4, 256, 32768, TRUE, "0-7 63" },
+  { "drop-newest, n-buffers 3",       HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST,
+    STALL_URGENT, 3, 256, 32768, TRUE, "0-7 63" },
+
+  /* Отправляемый блок занимает своё место в буфере, поэтому отбрасывание
+   * неотправленных блоков не освобождает место для нового блока. */
+  { "drop-newest, n-buffers, busy",   HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST,
+    STALL_BLOCK, 4, 256, 32768, TRUE, "0-7 63" },
+  { "drop-oldest, n-buffers, busy",   HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_OLDEST,
+    STALL_BLOCK, 4, 256, 32768, TRUE, "0-7 63" },
+
+  /* Буфер размером 4096 байт, место под собираемый блок - 616 байт. Блок
+   * эпохи 23 из трёх строк не помещается в буфер, а блок эпохи 24 из одной
+   * строки помещается. Без времени приёма строк место под собираемый блок
+   * сокращается до 528 байт. */
+  { "drop-newest, buffer-size",       HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST,
+    STALL_URGENT, 256, 256, 4096, TRUE, "0-22 24 63" },
+  { "drop-oldest, buffer-size",       HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_OLDEST,
+    STALL_URGENT, 256, 256, 4096, TRUE, "0-4 45-63" },
+  { "drop-oldest, buffer-size, busy", HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_OLDEST,
+    STALL_BLOCK, 256, 256, 4096, TRUE, "0-22 24 63" },
+  { "drop-newest, no line times",     HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST,
+    STALL_URGENT, 256, 256, 4096, FALSE, "0-24 63" },
+
+  /* Место под собираемый блок - 1640 байт, буфер увеличивается до трёх
+   * таких мест - 4920 байт. */
+  { "drop-newest, message-size",      HYSCAN_NMEA_RECEIVER_OVERFLOW_DROP_NEWEST,
+    STALL_URGENT, 256, 1024, 4096, TRUE, "0-19 21 63" }
+};
+
+/* Срочная NMEA строка. */
+static const gchar urgent[] = "$HEHDT,123.45,T*1E\r\n";
+
+/* Функция формирует NMEA строку с контрольной суммой. */
+static gchar *
+make_sentence (const gchar *body)
+{
+  guchar crc = 0;
+  const gchar *p;
+
+  for (p = body; *p != 0; p++)
+    crc ^= *p;
+
+  return g_strdup_printf ("$%s*%02X\r\n", body, crc);
+}
+
+/* Функция возвращает номера эпох из списка диапазонов вида "0-7 63". */
+static GArray *
+parse_epochs (const gchar *ranges)
+{
+  GArray *epochs = g_array_new (FALSE, FALSE, sizeof (guint));
+  gchar **items = g_strsplit (ranges, " ", -1);
+  guint i;
+
+  for (i = 0; items[i] != NULL; i++)
+    {
+      gchar *end;
+      guint first;
+      guint last;
+
+      first = (guint)g_ascii_strtoull (items[i], &end, 10);
+      last = (*end == '-') ? (guint)g_ascii_strtoull (end + 1, NULL, 10) : first;
+
+      for (; first <= last; first++)
+        g_array_append_val (epochs, first);
+    }
+
+  g_strfreev (items);
+
+  return epochs;
+}
+
+/* Функция возвращает число NMEA строк эпохи. */
+static guint
+epoch_n_lines (guint epoch)
+{
+  return 1 + epoch % 3;
+}
+
+/* Функция возвращает метку времени приёма строки эпохи. */
+static gint64
+epoch_time (guint epoch,
+            guint line)
+{
+  return START_TIME + (gint64)epoch * EPOCH_TIME + line * LINE_TIME;
+}
+
+/* Функция формирует NMEA строку эпохи. Строки GGA и RMC содержат время
+ * эпохи, строка VTG времени не содержит. */
+static gchar *
+epoch_sentence (guint epoch,
+                guint line)
+{
+  gchar *body;
+  gchar *sentence;
+
+  if (line == 0)
+    {
+      body = g_strdup_printf ("GPGGA,10%02u%02u.00,5540.1234,N,03730.5678,E,1,08,0.9,150.0,M,14.0,M,,",
+                              epoch / 60, epoch % 60);
+    }
+  else if (line == 1)
+    {
+      body = g_strdup_printf ("GPRMC,10%02u%02u.00,A,5540.1234,N,03730.5678,E,0.5,54.7,191119,,,A",
+                              epoch / 60, epoch % 60);
+    }
+  else
+    {
+      body = g_strdup_printf ("GPVTG,54.7,T,,M,0.%u,N,0.9,K,A", epoch % 10);
+    }
+
+  sentence = make_sentence (body);
+  g_free (body);
+
+  return sentence;
+}
+
+/* Функция передаёт NMEA строки эпохи. */
+static void
+add_epoch (HyScanNmeaReceiver *receiver,
+           guint               epoch)
+{
+  guint i;
+
+  for (i = 0; i < epoch_n_lines (epoch); i++)
+    {
+      gchar *sentence = epoch_sentence (epoch, i);
+
+      hyscan_nmea_receiver_add_data (receiver, epoch_time (epoch, i), sentence, strlen (sentence));
+      g_free (sentence);
+    }
+}
+
+/* Функция пакетной обработки блоков данных. */
+static void
+batch_cb (HyScanNmeaReceiver            *receiver,
+          const HyScanNmeaReceiverBlock *blocks,
+          guint                          n_blocks,
+          gpointer                       user_data)
+{
+  Consumer *consumer = user_data;
+  guint i;
+
+  g_mutex_lock (&consumer->lock);
+
+  for (i = 0; i < n_blocks; i++)
+    {
+      const HyScanNmeaReceiverBlock *block = &blocks[i];
+      gboolean stall;
+
+      if (block->urgent)
+        {
+          stall = (consumer->stall == STALL_URGENT);
+        }
+      else
+        {
+          HyScanNmeaReceiverBlock copy = *block;
+
+          copy.data = g_strndup (block->data, block->size);
+          copy.line_times = NULL;
+          if (block->line_times != NULL)
+            {
+              guint32 *line_times = g_new (guint32, block->n_lines);
+
+              memcpy (line_times, block->line_times, block->n_lines * sizeof (guint32));
+              copy.line_times = line_times;
+            }
+
+          g_array_append_val (consumer->blocks, copy);
+
+          stall = (consumer->stall == STALL_BLOCK) && (block->time == consumer->stall_time);
+        }
+
+      /* Останавливаемся, пока тест не разрешит продолжить работу. */
+      if (stall)
+        {
+          consumer->stalled = TRUE;
+          g_cond_broadcast (&consumer->cond);
+
+          while (!consumer->released)
+            g_cond_wait (&consumer->cond, &consumer->lock);
+        }
+    }
+
+  g_cond_broadcast (&consumer->cond);
+  g_mutex_unlock (&consumer->lock);
+}
+
+/* Функция ожидает остановки потребителя. */
+static gboolean
+wait_stalled (Consumer *consumer)
+{
+  gint64 deadline = g_get_monotonic_time () + WAIT_TIMEOUT;
+  gboolean status = TRUE;
+
+  g_mutex_lock (&consumer->lock);
+  while (status && !consumer->stalled)
+    status = g_cond_wait_until (&consumer->cond, &consumer->lock, deadline);
+  status = consumer->stalled;
+  g_mutex_unlock (&consumer->lock);
+
+  return status;
+}
+
+/* Функция ожидает приёма n_blocks обычных блоков не дольше timeout мкс. */
+static gboolean
+wait_blocks (Consumer *consumer,
+             guint     n_blocks,
+             gint64    timeout)
+{
+  gint64 deadline = g_get_monotonic_time () + timeout;
+  gboolean status = TRUE;
+
+  g_mutex_lock (&consumer->lock);
+  while (status && (consumer->blocks->len < n_blocks))
+    status = g_cond_wait_until (&consumer->cond, &consumer->lock, deadline);
+  status = (consumer->blocks->len >= n_blocks);
+  g_mutex_unlock (&consumer->lock);
+
+  return status;
+}
+
+/* Функция сравнивает блок с ожидаемой эпохой. */
+static gboolean
+check_block (const HyScanNmeaReceiverBlock *block,
+             guint                          epoch,
+             gboolean                       line_times)
+{
+  GString *data = g_string_new (NULL);
+  gboolean status;
+  guint i;
+
+  for (i = 0; i < epoch_n_lines (epoch); i++)
+    {
+      gchar *sentence = epoch_sentence (epoch, i);
+
+      g_string_append (data, sentence);
+      g_free (sentence);
+    }
+
+  status = (block->time == epoch_time (epoch, 0)) &&
+           (block->size == data->len + 1) &&
+           (memcmp (block->data, data->str, data->len + 1) == 0);
+
+  if (line_times)
+    {
+      status = status && (block->line_times != NULL) && (block->n_lines == epoch_n_lines (epoch));
+      for (i = 0; status && (i < block->n_lines); i++)
+        status = (block->line_times[i] == (guint32)(epoch_time (epoch, i) - block->time));
+    }
+  else
+    {
+      status = status && (block->line_times == NULL) && (block->n_lines == 0);
+    }
+
+  g_string_free (data, TRUE);
+
+  return status;
+}
+
+/* Функция проверяет один вариант переполнения буфера. */
+static gboolean
+check (guint index)
+{
+  HyScanNmeaReceiver *receiver;
+  Consumer consumer;
+  const gchar *patterns[] = { "HDT", NULL };
+  GArray *epochs = parse_epochs (cases[index].epochs);
+  guint n_expected = epochs->len;
+  guint n_dropped = N_EPOCHS - n_expected;
+  gboolean status = TRUE;
+  gint64 elapsed;
+  gint64 deadline;
+  guint epoch;
+  guint i;
+
+  g_mutex_init (&consumer.lock);
+  g_cond_init (&consumer.cond);
+  consumer.stall = cases[index].stall;
+  consumer.stall_time = epoch_time (N_WARMUP, 0);
+  consumer.stalled = FALSE;
+  consumer.released = FALSE;
+  consumer.blocks = g_array_new (FALSE, FALSE, sizeof (HyScanNmeaReceiverBlock));
+
+  receiver = g_object_new (HYSCAN_TYPE_NMEA_RECEIVER,
+                           "n-buffers", cases[index].n_buffers,
+                           "message-size", cases[index].message_size,
+                           "buffer-size", cases[index].buffer_size,
+                           "line-times", cases[index].line_times,
+                           NULL);
+
+  hyscan_nmea_receiver_set_batch_func (receiver, batch_cb, 8, &consumer);
+  hyscan_nmea_receiver_set_overflow (receiver, cases[index].overflow, OVERFLOW_TIMEOUT);
+  hyscan_nmea_receiver_set_urgent (receiver, patterns);
+
+  /* Блок эпохи отправляется при приёме первой строки следующей эпохи.
+   * Каждый блок дожидается отправки, чтобы буфер не переполнялся. */
+  for (epoch = 0; epoch <= N_WARMUP; epoch++)
+    {
+      add_epoch (receiver, epoch);
+
+      if ((epoch > 0) && !wait_blocks (&consumer, epoch, WAIT_TIMEOUT))
+        {
+          g_print ("%s: block %u is not received\n", cases[index].name, epoch - 1);
+          status = FALSE;
+        }
+    }
+
+  /* Останавливаем потребителя. */
+  if (consumer.stall == STALL_URGENT)
+    {
+      hyscan_nmea_receiver_add_data (receiver, epoch_time (N_WARMUP, 0), urgent, strlen (urgent));
+    }
+  else
+    {
+      add_epoch (receiver, epoch);
+      epoch += 1;
+    }
+
+  if (!wait_stalled (&consumer))
+    {
+      g_print ("%s: consumer is not stalled\n", cases[index].name);
+      status = FALSE;
+    }
+
+  /* Переполняем буфер. */
+  elapsed = g_get_monotonic_time ();
+
+  for (; epoch < N_EPOCHS; epoch++)
+    add_epoch (receiver, epoch);
+
+  elapsed = g_get_monotonic_time () - elapsed;
+
+  if (hyscan_nmea_receiver_get_dropped (receiver) != n_dropped)
+    {
+      g_print ("%s: %u blocks dropped, expected %u\n",
+               cases[index].name, hyscan_nmea_receiver_get_dropped (receiver), n_dropped);
+      status = FALSE;
+    }
+
+  /* Политика ожидания места ждёт перед отбрасыванием каждого блока. */
+  if ((cases[index].overflow == HYSCAN_NMEA_RECEIVER_OVERFLOW_BLOCK) &&
+      (elapsed < n_dropped * OVERFLOW_TIMEOUT * G_USEC_PER_SEC))
+    {
+      g_print ("%s: overflow wait %" G_GINT64_FORMAT " us is too short\n", cases[index].name, elapsed);
+      status = FALSE;
+    }
+
+  /* Возобновляем отправку и отправляем последнюю эпоху. */
+  g_mutex_lock (&consumer.lock);
+  consumer.released = TRUE;
+  g_cond_broadcast (&consumer.cond);
+  g_mutex_unlock (&consumer.lock);
+
+  wait_blocks (&consumer, n_expected - 1, WAIT_TIMEOUT);
+
+  /* Блок последней эпохи помещается в буфер, когда поток отправки
+   * освободит место последнего отправленного блока. До этого блок
+   * продолжает собираться и отправляется следующим вызовом. */
+  deadline = g_get_monotonic_time () + WAIT_TIMEOUT;
+  do
+    hyscan_nmea_receiver_flush (receiver, -1.0);
+  while (!wait_blocks (&consumer, n_expected, FLUSH_TIMEOUT) && (g_get_monotonic_time () < deadline));
+
+  /* Завершаем поток отправки, после этого блоков больше не будет. */
+  g_object_unref (receiver);
+
+  if (consumer.blocks->len != n_expected)
+    {
+      g_print ("%s: %u blocks received, expected %u\n", cases[index].name, consumer.blocks->len, n_expected);
+      status = FALSE;
+    }
+
+  /* Доставленные эпохи в исходном порядке. */
+  for (i = 0; status && (i < n_expected); i++)
+    {
+      const HyScanNmeaReceiverBlock *block;
+
+      block = &g_array_index (consumer.blocks, HyScanNmeaReceiverBlock, i);
+      epoch = g_array_index (epochs, guint, i);
+
+      if (!check_block (block, epoch, cases[index].line_times))
+        {
+          g_print ("%s: block %u differs from epoch %u:\n%s\n",
+                   cases[index].name, i, epoch, block->data);
+          status = FALSE;
+        }
+    }
+
+  for (i = 0; i < consumer.blocks->len; i++)
+    {
+      HyScanNmeaReceiverBlock *block = &g_array_index (consumer.blocks, HyScanNmeaReceiverBlock, i);
+
+      g_free ((gchar *) block->data);
+      g_free ((guint32 *) block->line_times);
+    }
+
+  g_array_unref (consumer.blocks);
+  g_array_unref (epochs);
+  g_cond_clear (&consumer.cond);
+  g_mutex_clear (&consumer.lock);
+
+  return status;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  guint n_errors = 0;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (cases); i++)
+    {
+      if (!check (i))
+        n_errors += 1;
+    }
+
+  if (n_errors > 0)
+    {
+      g_print ("%u errors\n", n_errors);
+      return -1;
+    }
+
+  return 0;
+}
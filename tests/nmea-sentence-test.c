@@ -0,0 +1,347 @@
+/* nmea-sentence-test.c
+ *
+ * Copyright 2019 Screen LLC, Andrei Fadeev <andrei@webcontrol.ru>
+ *
+ * This file is part of HyScanNMEADrv.
+ *
+ * HyScanNMEADrv is dual-licensed: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * HyScanNMEADrv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, you can license this code under a commercial license.
+ * Contact the Screen LLC in this case - <info@screen-co.ru>.
+ */
+
+/* HyScanNMEADrv имеет двойную лицензию.
+ *
+ * Во-первых, вы можете распространять HyScanNMEADrv на условиях Стандартной
+ * Общественной Лицензии GNU версии 3, либо по любой более поздней версии
+ * лицензии (по вашему выбору). Полные положения лицензии GNU приведены в
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Во-вторых, этот программный код можно использовать по коммерческой
+ * лицензии. Для этого свяжитесь с ООО Экран - <info@screen-co.ru>.
+ */
+
+/* Тест сравнивает результаты разбора числовых полей и поля времени
+ * функциями hyscan_nmea_sentence_parse_int и hyscan_nmea_sentence_parse_time
+ * с результатами sscanf на случайных строках, а разбор десятичных чисел
+ * функцией hyscan_nmea_sentence_parse_decimal - с результатами
+ * g_ascii_strtod. Также проверяется контрольная сумма, вычисляемая функцией
+ * hyscan_nmea_sentence_check, разбор координат и определение времени NMEA
+ * строк разных типов. */
+
+#include <hyscan-nmea-sentence.h>
+#include <string.h>
+#include <stdio.h>
+
+#define MAX_FIELD_SIZE 15
+#define MAX_INT_SIZE 9
+#define MAX_DECIMAL_DIGITS 12
+
+/* NMEA строки и ожидаемое время. */
+static const struct
+{
+  const gchar *sentence;
+  gint         time;
+} sentence_times[] =
+{
+  { "$GPGGA,123519.50,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47", 45319050 },
+  { "$GNRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A", 45319000 },
+  { "$GPZDA,,19,11,2019,00,00*48", 0 },
+  { "$GPGLL,4916.45,N,12311.12,W,225444,A,*1D", 82484000 },
+  { "$GPGLL,4916.45,N,12311.12,W*31", -1 },
+  { "$GNGNS,014035.00,4332.69262,S,17235.48549,E,RR,13,0.9,25.63,11.24,,*70", 6035000 },
+  { "$GPGST,172814.0,0.006,0.023,0.020,273.6,0.023,0.020,0.031*6A", 62894000 },
+  { "$GPGBS,235458.00,1.4,1.3,3.1,03,,-21.4,3.8,1,0*5B", 86098000 },
+  { "$GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48", -1 },
+  { "$HYPTF,1500,1.5,2.5*00", 1500 },
+  { "$PSRMC,123519,A*00", -1 },
+  { "$PGRMZ,246,f,3*1B", -1 },
+  { "$GPGGA", -1 }
+};
+
+/* Координаты и ожидаемые значения в градусах. */
+static const struct
+{
+  const gchar *field;
+  gdouble      value;
+} coords[] =
+{
+  { "4807.038", 48.0 + 7.038 / 60.0 },
+  { "01131.000", 11.0 + 31.0 / 60.0 },
+  { "4332.69262", 43.0 + 32.69262 / 60.0 },
+  { "17235.48549", 172.0 + 35.48549 / 60.0 },
+  { "5959.9999999999", 59.0 + 59.999999999 / 60.0 },
+  { "0000.0001", 0.0001 / 60.0 },
+  { "4916", 49.0 + 16.0 / 60.0 },
+  { "4916.", 49.0 + 16.0 / 60.0 }
+};
+
+static const gchar field_chars[] = "0123456789012345678901234567890123456789 \t\n+-.,*A";
+
+/* Функция формирует случайную строку длиной до max_size символов. */
+static gchar *
+make_field (guint max_size)
+{
+  guint size = g_random_int_range (0, max_size + 1);
+  gchar *field = g_malloc (size + 1);
+  guint i;
+
+  for (i = 0; i < size; i++)
+    field[i] = field_chars[g_random_int_range (0, sizeof (field_chars) - 1)];
+  field[size] = 0;
+
+  return field;
+}
+
+/* Разбор времени через sscanf, как это делалось в HyScanNmeaReceiver. */
+static gint
+scanf_time (const gchar *field)
+{
+  gint hour, min, sec, msec;
+  gint n_fields;
+
+  n_fields = sscanf (field, "%2d%2d%2d.%d", &hour, &min, &sec, &msec);
+  if (n_fields == 3)
+    return 1000 * (3600 * hour + 60 * min + sec);
+  else if (n_fields == 4)
+    return 1000 * (3600 * hour + 60 * min + sec) + msec;
+
+  return 0;
+}
+
+/* Функция формирует случайное десятичное число. */
+static gchar *
+make_decimal (void)
+{
+  GString *number = g_string_new (NULL);
+  guint i, n;
+
+  if (g_random_boolean ())
+    g_string_append_c (number, g_random_boolean () ? '-' : '+');
+
+  n = g_random_int_range (0, MAX_DECIMAL_DIGITS + 1);
+  for (i = 0; i < n; i++)
+    g_string_append_c (number, g_random_int_range ('0', '9' + 1));
+
+  if (g_random_boolean ())
+    {
+      g_string_append_c (number, '.');
+
+      n = g_random_int_range (0, MAX_DECIMAL_DIGITS + 1);
+      for (i = 0; i < n; i++)
+        g_string_append_c (number, g_random_int_range ('0', '9' + 1));
+    }
+
+  g_string_append_c (number, ',');
+
+  return g_string_free (number, FALSE);
+}
+
+/* Функция сравнивает разбор десятичного числа с g_ascii_strtod. */
+static gboolean
+check_decimal (const gchar *field)
+{
+  const gchar *end1;
+  gchar *end2;
+  gdouble value1 = 0.0;
+  gdouble value2;
+
+  end1 = hyscan_nmea_sentence_parse_decimal (field, &value1);
+  value2 = g_ascii_strtod (field, &end2);
+
+  if (end2 == field)
+    return (end1 == NULL);
+
+  return (end1 == end2) && (ABS (value1 - value2) <= 1e-15 * ABS (value2));
+}
+
+/* Функция сравнивает разбор целого числа с sscanf. */
+static gboolean
+check_int (const gchar *field,
+           guint        width)
+{
+  const gchar *end;
+  gchar format[16];
+  gint value1 = 0;
+  gint value2 = 0;
+  gint size = -1;
+
+  if (width > 0)
+    g_snprintf (format, sizeof (format), "%%%ud%%n", width);
+  else
+    g_snprintf (format, sizeof (format), "%%d%%n");
+
+  end = hyscan_nmea_sentence_parse_int (field, width, &value1);
+
+  if (sscanf (field, format, &value2, &size) != 1)
+    return (end == NULL);
+
+  return (end != NULL) && (end - field == size) && (value1 == value2);
+}
+
+/* Функция проверяет контрольную сумму случайной NMEA строки. */
+static gboolean
+check_crc (void)
+{
+  gchar sentence[256];
+  gboolean valid;
+  guint size;
+  guint crc1 = 0;
+  guint crc2 = 0;
+  guint i;
+
+  size = g_random_int_range (4, sizeof (sentence));
+  for (i = 0; i < size; i++)
+    sentence[i] = g_random_int_range (1, 256);
+  sentence[size] = 0;
+
+  sentence[0] = '$';
+  for (i = 1; i < size - 3; i++)
+    crc1 ^= (guchar)sentence[i];
+
+  /* Правильная контрольная сумма в половине случаев. */
+  if (g_random_boolean ())
+    {
+      g_snprintf (sentence + size - 3, 4, "*%02X", crc1);
+      valid = TRUE;
+    }
+  else
+    {
+      valid = (sentence[size - 3] == '*') &&
+              g_ascii_isxdigit (sentence[size - 2]) &&
+              g_ascii_isxdigit (sentence[size - 1]) &&
+              (sscanf (sentence + size - 2, "%02X", &crc2) == 1) &&
+              (crc1 == crc2);
+    }
+
+  return hyscan_nmea_sentence_check (sentence, size) == valid;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gint n_tests = 1000000;
+  gint seed = 0;
+  guint n_errors = 0;
+  gint i;
+
+  /* Разбор командной строки. */
+  {
+    gchar **args;
+    GError *error = NULL;
+    GOptionContext *context;
+    GOptionEntry entries[] =
+      {
+        { "tests", 'n', 0, G_OPTION_ARG_INT, &n_tests, "Number of random tests", NULL },
+        { "seed", 's', 0, G_OPTION_ARG_INT, &seed, "Random seed", NULL },
+        { NULL }
+      };
+
+#ifdef G_OS_WIN32
+    args = g_win32_get_command_line ();
+#else
+    args = g_strdupv (argv);
+#endif
+
+    context = g_option_context_new ("");
+    g_option_context_set_help_enabled (context, TRUE);
+    g_option_context_add_main_entries (context, entries, NULL);
+    g_option_context_set_ignore_unknown_options (context, FALSE);
+    if (!g_option_context_parse_strv (context, &args, &error))
+      {
+        g_print ("%s\n", error->message);
+        return -1;
+      }
+
+    if (n_tests <= 0)
+      {
+        g_print ("%s", g_option_context_get_help (context, FALSE, NULL));
+        return 0;
+      }
+
+    g_option_context_free (context);
+    g_strfreev (args);
+  }
+
+  if (seed != 0)
+    g_random_set_seed (seed);
+
+  for (i = 0; i < (gint)G_N_ELEMENTS (sentence_times); i++)
+    {
+      gint time = hyscan_nmea_sentence_get_time (sentence_times[i].sentence);
+
+      if (time != sentence_times[i].time)
+        {
+          g_print ("time mismatch: '%s' %d != %d\n", sentence_times[i].sentence, time, sentence_times[i].time);
+          n_errors += 1;
+        }
+    }
+
+  for (i = 0; i < (gint)G_N_ELEMENTS (coords); i++)
+    {
+      gdouble value = -1.0;
+
+      if ((hyscan_nmea_sentence_parse_coord (coords[i].field, &value) == NULL) ||
+          (ABS (value - coords[i].value) > 1e-12))
+        {
+          g_print ("coord mismatch: '%s' %.12f != %.12f\n", coords[i].field, value, coords[i].value);
+          n_errors += 1;
+        }
+    }
+
+  for (i = 0; i < n_tests; i++)
+    {
+      gchar *decimal = make_decimal ();
+      gchar *field = make_field (MAX_FIELD_SIZE);
+      gchar *number = g_strndup (field, MAX_INT_SIZE);
+      guint width;
+
+      if (hyscan_nmea_sentence_parse_time (field) != scanf_time (field))
+        {
+          g_print ("time mismatch: '%s'\n", field);
+          n_errors += 1;
+        }
+
+      for (width = 0; width <= 3; width++)
+        {
+          if (!check_int (number, width))
+            {
+              g_print ("int mismatch: '%s', width %u\n", number, width);
+              n_errors += 1;
+            }
+        }
+
+      if (!check_decimal (decimal))
+        {
+          g_print ("decimal mismatch: '%s'\n", decimal);
+          n_errors += 1;
+        }
+
+      if (!check_crc ())
+        n_errors += 1;
+
+      g_free (decimal);
+      g_free (number);
+      g_free (field);
+    }
+
+  if (n_errors > 0)
+    {
+      g_print ("%u errors\n", n_errors);
+      return -1;
+    }
+
+  return 0;
+}
@@ -35,6 +35,32 @@
 #include <hyscan-nmea-uart.h>
 #include <stdio.h>
 
+static gboolean terminate = FALSE;
+
+/* Поток вывода частоты пробуждений потоков приёма данных. */
+static gpointer
+wakeup_stats (gpointer data)
+{
+  GList *uarts = data;
+
+  while (!g_atomic_int_get (&terminate))
+    {
+      GList *link;
+
+      g_usleep (1000000);
+
+      for (link = uarts; link != NULL; link = g_list_next (link))
+        {
+          HyScanNmeaUART *uart = link->data;
+          const gchar *name = g_object_get_data (G_OBJECT (uart), "name");
+
+          g_print ("%s: %.1f wakeups/s\n", name, hyscan_nmea_uart_get_wakeup_rate (uart));
+        }
+    }
+
+  return NULL;
+}
+
 void
 data_cb (HyScanNmeaUART *uart,
          gint64          time,
@@ -51,6 +77,8 @@ main (int    argc,
       char **argv)
 {
   gboolean list = FALSE;
+  gboolean stats = FALSE;
+  GThread *stats_thread = NULL;
   GList *devices = NULL;
   GList *uarts = NULL;
   GList *link;
@@ -63,6 +91,7 @@ main (int    argc,
     GOptionEntry entries[] =
       {
         { "list", 'l', 0, G_OPTION_ARG_NONE, &list, "List available UART ports", NULL },
+        { "stats", 's', 0, G_OPTION_ARG_NONE, &stats, "Print receiver wakeups per second", NULL },
         { NULL }
       };
 
@@ -108,7 +137,9 @@ main (int    argc,
         }
       else
         {
-          g_signal_connect (uart, "nmea-data", G_CALLBACK (data_cb), (gpointer)device->name);
+          g_object_set_data (G_OBJECT (uart), "name", (gpointer)device->name);
+          if (!stats)
+            g_signal_connect (uart, "nmea-data", G_CALLBACK (data_cb), (gpointer)device->name);
           hyscan_nmea_uart_set_device (uart, device->path, HYSCAN_NMEA_UART_MODE_AUTO);
         }
 
@@ -116,12 +147,18 @@ main (int    argc,
       link = g_list_next (link);
     }
 
+  if (!list && stats)
+    stats_thread = g_thread_new ("wakeup-stats", wakeup_stats, uarts);
+
   if (!list)
     {
       g_print ("Press [Enter] to terminate test...\n");
       getchar ();
     }
 
+  g_atomic_int_set (&terminate, TRUE);
+  g_clear_pointer (&stats_thread, g_thread_join);
+
   g_list_free_full (uarts, g_object_unref);
   g_list_free_full (devices, (GDestroyNotify)hyscan_nmea_uart_device_free);
 
@@ -54,6 +54,8 @@ main (int    argc,
   gboolean list = FALSE;
   gchar *host = NULL;
   gint port = 0;
+  gboolean datagram = FALSE;
+  gdouble timeout = 0.0;
 
   /* Разбор командной строки. */
   {
@@ -65,6 +67,8 @@ main (int    argc,
         { "list", 'l', 0, G_OPTION_ARG_NONE, &list, "List available ip addresses", NULL },
         { "host", 'h', 0, G_OPTION_ARG_STRING, &host, "Bind ip address", NULL },
         { "port", 'p', 0, G_OPTION_ARG_INT, &port, "Bind udp port", NULL },
+        { "datagram", 'd', 0, G_OPTION_ARG_NONE, &datagram, "Deliver block at the end of datagram", NULL },
+        { "timeout", 't', 0, G_OPTION_ARG_DOUBLE, &timeout, "Deliver block after timeout, s", NULL },
         { NULL }
       };
 
@@ -111,6 +115,7 @@ main (int    argc,
     }
 
   udp = hyscan_nmea_udp_new ();
+  hyscan_nmea_udp_set_flush (udp, datagram, timeout);
   hyscan_nmea_udp_set_address (udp, host, port);
   g_signal_connect (udp, "nmea-data", G_CALLBACK (data_cb), host);
 